@@ -0,0 +1,55 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_CHECKPOINT_H
+#define XENLIB_XRUN_CHECKPOINT_H
+
+#include <sys/types.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Save memory and vCPU context of the paused domain to storage
+ *
+ * Guest RAM is stored as a stream of records. Runs of zero pages are
+ * stored as a single record without payload. Only the first RAM bank is
+ * saved, -E2BIG is returned if mem_kb doesn't fit in it.
+ *
+ * @param domid - domain id, domain should be paused
+ * @param mem_kb - size of the domain memory in KB
+ * @param nr_vcpus - number of domain vCPUs
+ * @param fpath - absolute path to the checkpoint file
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_checkpoint_save(uint32_t domid, uint64_t mem_kb, uint32_t nr_vcpus,
+			 const char *fpath);
+
+/**
+ * @brief Restore memory and vCPU context of the paused domain from storage
+ *
+ * Domain should be created with the same memory size and number of
+ * vCPUs as the domain the checkpoint was saved from. Only the first RAM
+ * bank is restored, hypervisor state of the domain (event channels,
+ * grants, xenstore) is left as it was created.
+ *
+ * @param domid - domain id, domain should be paused
+ * @param mem_kb - size of the domain memory in KB
+ * @param nr_vcpus - number of domain vCPUs
+ * @param fpath - absolute path to the checkpoint file
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_checkpoint_load(uint32_t domid, uint64_t mem_kb, uint32_t nr_vcpus,
+			 const char *fpath);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_CHECKPOINT_H */
@@ -0,0 +1,45 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_CONSOLE_H
+#define XENLIB_XRUN_CONSOLE_H
+
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Start forwarding of the domain console output to fd
+ *
+ * Console ring of the domain is drained by the console pump thread when
+ * domain notifies its console event channel. Output is written to fd
+ * straight from the ring in batches of CONFIG_XRUN_CONSOLE_BATCH bytes.
+ * fd is switched to O_NONBLOCK, output which doesn't fit is dropped.
+ *
+ * @param domid - domain id
+ * @param fd - socket or file descriptor to write console output to
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_console_start(uint32_t domid, int fd);
+
+/**
+ * @brief Stop forwarding of the domain console
+ *
+ * Output left in the ring is written to fd before console is released.
+ *
+ * @param domid - domain id
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_console_stop(uint32_t domid);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_CONSOLE_H */
@@ -0,0 +1,244 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_HYPERVISOR_H
+#define XENLIB_XRUN_HYPERVISOR_H
+
+#include <sys/types.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XRUN_PAGE_SIZE 4096
+
+/**
+ * @brief Get first guest frame of the domain RAM
+ *
+ * @param mem_kb - size of the domain memory in KB
+ * @param gfn - pointer to store first guest frame number
+ *
+ * @return - 0 on success and errno if memory doesn't fit in one bank
+ */
+int xrun_hyp_guest_ram_gfn(uint64_t mem_kb, uint64_t *gfn);
+
+/**
+ * @brief Map guest domain pages to Dom0 address space
+ *
+ * @param domid - domain id
+ * @param gfn - first guest frame number to map
+ * @param nr_pages - number of pages to map
+ * @param addr - pointer to store mapped address
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_map_guest_pages(uint32_t domid, uint64_t gfn, size_t nr_pages,
+			     void **addr);
+
+/**
+ * @brief Unmap guest domain pages mapped by xrun_hyp_map_guest_pages
+ *
+ * @param addr - mapped address
+ * @param nr_pages - number of mapped pages
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_unmap_guest_pages(void *addr, size_t nr_pages);
+
+/**
+ * @brief Get size of the vCPU context used by the hypervisor
+ *
+ * @return - size of the vCPU context in bytes
+ */
+size_t xrun_hyp_vcpu_context_size(void);
+
+/**
+ * @brief Get vCPU context of the paused domain
+ *
+ * @param domid - domain id
+ * @param vcpu - vCPU number
+ * @param ctx - buffer of xrun_hyp_vcpu_context_size() bytes
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_get_vcpu_context(uint32_t domid, uint32_t vcpu, void *ctx);
+
+/**
+ * @brief Set vCPU context of the paused domain
+ *
+ * @param domid - domain id
+ * @param vcpu - vCPU number
+ * @param ctx - buffer of xrun_hyp_vcpu_context_size() bytes
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_set_vcpu_context(uint32_t domid, uint32_t vcpu, void *ctx);
+
+/**
+ * @brief Set maximum amount of memory the domain may allocate
+ *
+ * @param domid - domain id
+ * @param max_kb - memory limit in KB
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_set_max_mem(uint32_t domid, uint64_t max_kb);
+
+/**
+ * @brief Set memory target for the domain balloon driver
+ *
+ * Target is published in the domain xenstore memory/target node. Guest
+ * balloon driver releases or claims memory to reach it.
+ *
+ * @param domid - domain id
+ * @param target_kb - memory target in KB
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_set_mem_target(uint32_t domid, uint64_t target_kb);
+
+/**
+ * @brief Get amount of memory currently allocated by the domain
+ *
+ * @param domid - domain id
+ * @param mem_kb - pointer to store allocated memory in KB
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_get_mem(uint32_t domid, uint64_t *mem_kb);
+
+/**
+ * @brief Set hard affinity of the domain vCPU
+ *
+ * @param domid - domain id
+ * @param vcpu - vCPU number
+ * @param cpumask - mask of physical CPUs the vCPU may run on
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_set_vcpu_affinity(uint32_t domid, uint32_t vcpu,
+			       uint32_t cpumask);
+
+/**
+ * @brief Set credit scheduler parameters of the domain
+ *
+ * Parameters are applied for credit2 or credit scheduler, whichever
+ * runs the domain.
+ *
+ * @param domid - domain id
+ * @param weight - relative scheduler weight
+ * @param cap - maximum CPU time in percents of one pCPU, 0 for no cap
+ *
+ * @return - 0 on success, -ENOTSUP if the domain is run by another
+ *         scheduler and errno on other errors
+ */
+int xrun_hyp_set_sched(uint32_t domid, uint32_t weight, uint32_t cap);
+
+/**
+ * @brief Get console ring of the domain
+ *
+ * Ring frame and event channel are taken from the domain console
+ * xenstore nodes published on domain creation.
+ *
+ * @param domid - domain id
+ * @param gfn - pointer to store guest frame number of the console ring
+ * @param port - pointer to store domain event channel of the console
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_get_console(uint32_t domid, uint64_t *gfn, uint32_t *port);
+
+/**
+ * @brief Read xenstore node of the domain
+ *
+ * Errors are not logged, so the node may be polled until it appears.
+ *
+ * @param domid - domain id
+ * @param node - node path relative to the domain home path
+ * @param buf - buffer to store node value
+ * @param size - size of the buffer
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_read_node(uint32_t domid, const char *node, char *buf,
+		       size_t size);
+
+/**
+ * @brief Get free memory and number of physical CPUs of the host
+ *
+ * @param free_kb - pointer to store memory not allocated to any domain
+ * @param nr_cpus - pointer to store number of physical CPUs
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_get_physinfo(uint64_t *free_kb, uint32_t *nr_cpus);
+
+/**
+ * @brief Ask the domain to power off
+ *
+ * Writes "poweroff" to the control/shutdown xenstore node of the domain,
+ * which is watched by the guest.
+ *
+ * @param domid - domain id
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_request_shutdown(uint32_t domid);
+
+/* Reason of the domain exit reported by xrun_hyp_get_exit */
+enum xrun_hyp_exit {
+	/* Domain is running */
+	XRUN_HYP_EXIT_NONE = 0,
+	XRUN_HYP_EXIT_POWEROFF,
+	XRUN_HYP_EXIT_REBOOT,
+	/* Domain crashed, was killed by watchdog or has disappeared */
+	XRUN_HYP_EXIT_CRASH,
+};
+
+/**
+ * @brief Get exit state of the domain
+ *
+ * Suspended domain is reported as running.
+ *
+ * @param domid - domain id
+ * @param exit - pointer to store exit reason
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_get_exit(uint32_t domid, enum xrun_hyp_exit *exit);
+
+/**
+ * @brief Wait until the destroyed domain disappears
+ *
+ * Domain is released by Xen after domain_destroy() returns, its id can't
+ * be reused until then.
+ *
+ * @param domid - domain id
+ * @param timeout_ms - time to wait in ms
+ *
+ * @return - 0 on success, -ETIMEDOUT if the domain is still there and
+ *         errno on other errors
+ */
+int xrun_hyp_wait_destroyed(uint32_t domid, uint32_t timeout_ms);
+
+/**
+ * @brief Bind handler to the domain exception virtual IRQ
+ *
+ * Hypervisor raises VIRQ_DOM_EXC when some domain shuts down or is
+ * destroyed. Handler is called from the interrupt context.
+ *
+ * @param cb - handler
+ * @param priv - handler argument
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_hyp_bind_dom_exc(void (*cb)(void *priv), void *priv);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_HYPERVISOR_H */
@@ -7,12 +7,23 @@
 #define XENLIB_XRUN_STORAGE_H
 
 #include <sys/types.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
 #include <zephyr/types.h>
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Handles and sizes of the files read by xrun_read_file and
+ * xrun_get_file_size are cached if CONFIG_XRUN_STORAGE_FILE_CACHE is set.
+ * Files rewritten by xrun_stream_create are invalidated automatically,
+ * files changed by other means should be passed to
+ * xrun_storage_invalidate, otherwise stale size and data may be
+ * returned. Streams don't use the cache and always see the current file.
+ */
+
 /**
  * @brief Read buffer fron file on storage
  *
@@ -35,6 +46,350 @@ ssize_t xrun_read_file(const char *fpath, char *buf,
  */
 ssize_t xrun_get_file_size(const char *fpath);
 
+struct xrun_storage_cache_stats {
+	uint32_t hits;
+	uint32_t misses;
+	uint32_t evictions;
+};
+
+/**
+ * @brief Drop cached handle and size of the file
+ *
+ * Should be called when file is changed or removed not by xrun, see
+ * the cache description above.
+ *
+ * @param fpath - absolute path to the file, NULL to drop all files
+ */
+void xrun_storage_invalidate(const char *fpath);
+
+/**
+ * @brief Get file handle cache statistics
+ *
+ * @param stats - pointer to store statistics
+ */
+void xrun_storage_get_cache_stats(struct xrun_storage_cache_stats *stats);
+
+struct xrun_io_budget_stats {
+	/* Number of bytes charged to the budget */
+	uint64_t bytes;
+	/* Time spent waiting for the budget in us */
+	uint64_t throttled_us;
+};
+
+/*
+ * Token bucket which paces reads from storage. Bucket is refilled with
+ * rate bytes per second up to burst bytes. Reads bigger than the
+ * available tokens put the bucket into debt, so the next read waits
+ * until it is paid off.
+ */
+struct xrun_io_budget {
+	struct k_spinlock lock;
+	/* Refill rate in bytes per second, 0 disables throttling */
+	uint32_t rate;
+	/* Bucket capacity in bytes */
+	uint32_t burst;
+	int64_t tokens;
+	int64_t last_refill;
+	struct xrun_io_budget_stats stats;
+};
+
+/**
+ * @brief Initialize I/O budget
+ *
+ * @param budget - budget to initialize
+ * @param rate - refill rate in bytes per second, 0 for unlimited
+ * @param burst - bucket capacity in bytes
+ */
+void xrun_io_budget_init(struct xrun_io_budget *budget, uint32_t rate,
+			 uint32_t burst);
+
+/**
+ * @brief Charge bytes to the budget
+ *
+ * Blocks the caller until the budget allows the read to proceed.
+ *
+ * @param budget - initialized budget, NULL is ignored
+ * @param size - number of bytes about to be read
+ */
+void xrun_io_budget_charge(struct xrun_io_budget *budget, size_t size);
+
+/**
+ * @brief Get I/O budget statistics
+ *
+ * @param budget - initialized budget, NULL for the global budget
+ * @param stats - pointer to store statistics
+ */
+void xrun_io_budget_get_stats(struct xrun_io_budget *budget,
+			      struct xrun_io_budget_stats *stats);
+
+/**
+ * @brief Set rate of the global I/O budget
+ *
+ * Global budget paces all file, stream and I/O scheduler reads in addition
+ * to the budgets set for the particular streams and requests.
+ *
+ * @param rate - refill rate in bytes per second, 0 for unlimited
+ * @param burst - bucket capacity in bytes
+ */
+void xrun_storage_set_io_rate(uint32_t rate, uint32_t burst);
+
+struct xrun_stream;
+
+struct xrun_stream_stats {
+	/* Read chunk size currently selected for the stream */
+	size_t chunk_size;
+	/* Number of requests served by the stream */
+	uint32_t requests;
+	/* Number of reads issued to the storage */
+	uint32_t reads;
+	/* Number of bytes transferred by the stream */
+	uint64_t bytes;
+	/* Time spent in storage I/O in us */
+	uint64_t io_time_us;
+	/* Time spent waiting for I/O budget in us */
+	uint64_t throttled_us;
+	/* Time from the first till the last request in us */
+	uint64_t active_us;
+};
+
+/**
+ * @brief Open file on storage for the positional reads
+ *
+ * Stream keeps file opened between reads, serves small sequential
+ * requests from the read-ahead chunk and reads large requests
+ * directly. Chunk size is adapted to the measured storage throughput.
+ *
+ * @param fpath - absolute path to the file
+ * @param stream - pointer to store opened stream
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_stream_open(const char *fpath, struct xrun_stream **stream);
+
+/**
+ * @brief Read data from the stream
+ *
+ * @param stream - opened stream
+ * @param buf - pointer to buffer
+ * @param size - number of bytes to read
+ * @param offset - offset from the start of the file
+ *
+ * @return - number of bytes read or -errno on error
+ */
+ssize_t xrun_stream_read(struct xrun_stream *stream, uint8_t *buf,
+			 size_t size, uint64_t offset);
+
+/**
+ * @brief Get size of the file opened by the stream
+ *
+ * @param stream - opened stream
+ *
+ * @return - file size or -errno on error
+ */
+ssize_t xrun_stream_size(struct xrun_stream *stream);
+
+/**
+ * @brief Get stream read statistics
+ *
+ * @param stream - opened stream
+ * @param stats - pointer to store statistics
+ */
+void xrun_stream_get_stats(struct xrun_stream *stream,
+			   struct xrun_stream_stats *stats);
+
+/**
+ * @brief Set I/O budget which paces the stream reads
+ *
+ * @param stream - opened stream
+ * @param budget - initialized budget, NULL to disable throttling
+ */
+void xrun_stream_set_budget(struct xrun_stream *stream,
+			    struct xrun_io_budget *budget);
+
+/**
+ * @brief Create file on storage for the sequential writes
+ *
+ * Existing file is truncated. Data is written through the DMA debounce
+ * buffer, so buffers which are not DMA capable can be passed to
+ * xrun_stream_write.
+ *
+ * @param fpath - absolute path to the file
+ * @param stream - pointer to store created stream
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_stream_create(const char *fpath, struct xrun_stream **stream);
+
+/**
+ * @brief Append data to the stream created by xrun_stream_create
+ *
+ * @param stream - created stream
+ * @param buf - pointer to buffer
+ * @param size - number of bytes to write
+ *
+ * @return - number of bytes written or -errno on error
+ */
+ssize_t xrun_stream_write(struct xrun_stream *stream, const uint8_t *buf,
+			  size_t size);
+
+/**
+ * @brief Close the stream and free its resources
+ *
+ * @param stream - opened stream, NULL is ignored
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_stream_close(struct xrun_stream *stream);
+
+struct xrun_io_req;
+
+/**
+ * Function cb, called from the I/O scheduler thread on request completion
+ * @param req completed request
+ * @param result number of bytes read or negative errno on error
+ */
+typedef void (*xrun_io_cb_t)(struct xrun_io_req *req, ssize_t result);
+
+struct xrun_io_req {
+	/* Scheduler private fields */
+	sys_snode_t node;
+	struct k_sem done;
+	ssize_t result;
+
+	/* Read parameters, same as for xrun_read_file */
+	const char *fpath;
+	char *buf;
+	size_t size;
+	int skip;
+
+	/* Optional completion callback */
+	xrun_io_cb_t cb;
+	void *user_data;
+
+	/* Optional budget the read is charged to */
+	struct xrun_io_budget *budget;
+};
+
+/**
+ * @brief Submit set of read requests to the I/O scheduler
+ *
+ * Requests are ordered by file and offset and served by the scheduler
+ * threads. Call blocks while the scheduler queue is full. Requests
+ * should stay valid until they are completed.
+ *
+ * @param reqs - array of requests
+ * @param count - number of requests
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_io_submit(struct xrun_io_req *reqs, size_t count);
+
+/**
+ * @brief Wait for the submitted request completion
+ *
+ * @param req - submitted request
+ * @param timeout - waiting period
+ *
+ * @return - request result or -errno on error or timeout
+ */
+ssize_t xrun_io_wait(struct xrun_io_req *req, k_timeout_t timeout);
+
+/*
+ * Bundle archive layout:
+ *   struct xrun_archive_header at offset 0
+ *   entries payload, each entry starts at XRUN_ARCHIVE_ALIGN boundary
+ * All fields are little-endian.
+ */
+#define XRUN_ARCHIVE_MAGIC 0x52415258 /* "XRAR" */
+#define XRUN_ARCHIVE_VERSION 1
+#define XRUN_ARCHIVE_ALIGN 4096
+#define XRUN_ARCHIVE_ENTRIES_MAX 16
+#define XRUN_ARCHIVE_NAME_MAX 32
+#define XRUN_ARCHIVE_DIGEST_SIZE 32
+
+struct xrun_archive_entry {
+	/* Null terminated entry name, e.g. "config.json" */
+	char name[XRUN_ARCHIVE_NAME_MAX];
+	/* Offset of the entry from the start of the archive */
+	uint64_t offset;
+	uint64_t size;
+	/* SHA-256 of the entry payload, all zeroes if not set */
+	uint8_t digest[XRUN_ARCHIVE_DIGEST_SIZE];
+} __packed;
+
+struct xrun_archive_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t nr_entries;
+	struct xrun_archive_entry entries[XRUN_ARCHIVE_ENTRIES_MAX];
+} __packed;
+
+struct xrun_archive;
+
+/**
+ * @brief Open bundle archive
+ *
+ * Archive is kept opened until xrun_archive_close is called, so all
+ * entries are read with positional reads without additional lookups
+ * on storage. Entries with digest are verified on open if
+ * CONFIG_XRUN_ARCHIVE_VERIFY is enabled, otherwise such archive is
+ * rejected with -ENOTSUP.
+ *
+ * @param fpath - absolute path to the archive file or flash path
+ * @param archive - pointer to store opened archive
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_archive_open(const char *fpath, struct xrun_archive **archive);
+
+/**
+ * @brief Read buffer from the archive entry
+ *
+ * @param archive - opened archive
+ * @param name - entry name
+ * @param buf - pointer to buffer
+ * @param size - size of the buffer
+ * @param skip - skip first n bytes before start reading
+ *
+ * @return - number of bytes read or -errno on error
+ */
+ssize_t xrun_archive_read_file(struct xrun_archive *archive, const char *name,
+			       char *buf, size_t size, int skip);
+
+/**
+ * @brief Get size of the archive entry
+ *
+ * @param archive - opened archive
+ * @param name - entry name
+ *
+ * @return - entry size or -errno on error
+ */
+ssize_t xrun_archive_get_file_size(struct xrun_archive *archive,
+				   const char *name);
+
+/**
+ * @brief Open stream for the archive entry
+ *
+ * Stream should be closed by xrun_stream_close.
+ *
+ * @param archive - opened archive
+ * @param name - entry name
+ * @param stream - pointer to store opened stream
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_archive_stream_open(struct xrun_archive *archive, const char *name,
+			     struct xrun_stream **stream);
+
+/**
+ * @brief Close the archive
+ *
+ * @param archive - opened archive, NULL is ignored
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_archive_close(struct xrun_archive *archive);
+
 #ifdef __cplusplus
 }
 #endif
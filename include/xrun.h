@@ -6,6 +6,13 @@
 #ifndef XRUN_H_
 #define XRUN_H_
 
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+#include <domain.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -14,20 +21,126 @@ enum container_status {
 	RUNNING = 0,
 	PAUSED,
 	DESTROYED,
+	/* Domain is asked to shut down by xrun_stop */
+	STOPPING,
+};
+
+/* Snapshot of the single container state returned by xrun_list */
+struct xrun_container_info {
+	char container_id[CONTAINER_NAME_SIZE];
+	uint64_t domid;
+	enum container_status status;
+	/* Time since the domain was started in ms */
+	int64_t uptime_ms;
+	uint64_t mem_kb;
+	/* Memory target requested by xrun_set_memory in KB */
+	uint64_t target_mem_kb;
+	uint32_t vcpus;
+	/* Scheduler weight and cap in percents of one pCPU, 0 - no cap */
+	uint32_t sched_weight;
+	uint32_t sched_cap;
+	/* Size of the loaded kernel image in bytes */
+	uint64_t image_size;
+	/* Time spent to create the domain and load its image in ms */
+	uint32_t load_time_ms;
+	/* Kernel image load throughput in KB/s */
+	uint32_t load_rate;
+	/* Number of successful restarts */
+	uint32_t restarts;
+	/* Number of domain exits other than power off */
+	uint32_t crashes;
+	/* Supervisor restarts since the domain last ran stable */
+	uint32_t retries;
+	/* Memory reserved by the admission control in KB */
+	uint64_t reserved_mem_kb;
+};
+
+/* Resources reserved by admitted containers, see xrun_get_admission */
+struct xrun_admission_info {
+	uint64_t reserved_mem_kb;
+	uint32_t reserved_vcpus;
+	/* Memory currently allocated to the container domains */
+	uint64_t used_mem_kb;
+	/* Memory not allocated to any domain by the hypervisor */
+	uint64_t free_mem_kb;
+	/* Group limits or host vCPU limit, 0 - no limit */
+	uint64_t mem_limit_kb;
+	uint32_t vcpus_limit;
+};
+
+/* Time-to-stop statistics of xrun_stop */
+struct xrun_stop_stats {
+	uint32_t stops;
+	/* Stops which ended with the domain destroyed at the timeout */
+	uint32_t forced;
+	/* Time of the last and the longest stop in ms */
+	uint32_t last_ms;
+	uint32_t max_ms;
+	uint64_t total_ms;
+};
+
+/* Teardown result of the single container reported by xrun_kill_all */
+struct xrun_kill_result {
+	char container_id[CONTAINER_NAME_SIZE];
+	/* 0 or -errno of the domain destroy */
+	int result;
+	/* Domain didn't shut down in time and was destroyed */
+	bool forced;
+	/* Time from the teardown start till the domain is destroyed in ms */
+	uint32_t time_ms;
 };
 
 /**
  * @brief Start runx container
  *
  * @param bundle - path to the container bundle
- * @param console -_socket sochet fd to access to
- *        the Domain console
+ * @param console_socket - socket or fd the Domain console output is
+ *        forwarded to when CONFIG_XRUN_CONSOLE is enabled, 0 or
+ *        negative value disables forwarding
  * @param container_id - unique container id string
  *
  * @return - 0 on success and errno on error
  */
 int xrun_run(const char *bundle, int console_socket, const char *container_id);
 
+/**
+ * @brief Start runx container from the checkpoint
+ *
+ * Experimental, available with CONFIG_XRUN_CHECKPOINT, see its help for
+ * the state which is not restored. Domain is created from the bundle as
+ * by xrun_run, so kernel image is still loaded and the guest starts
+ * booting. The domain is paused right
+ * after creation and its RAM and vCPU context are replaced by the ones
+ * saved by xrun_checkpoint. Event channels, grant tables and xenstore
+ * entries are not saved, so -ENOTSUP is returned for specs with PV
+ * backends, passthrough devices or balloon range. Domain gets a new
+ * domid.
+ *
+ * @param bundle - path to the container bundle
+ * @param checkpoint - path to the checkpoint file
+ * @param console_socket - socket fd to access to the Domain console
+ * @param container_id - unique container id string
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_restore(const char *bundle, const char *checkpoint,
+		 int console_socket, const char *container_id);
+
+/**
+ * @brief Save runx container memory and vCPU context to storage
+ *
+ * Experimental, available with CONFIG_XRUN_CHECKPOINT. Running container
+ * is paused while checkpoint is saved and resumed afterwards. Paused
+ * container stays paused. Only memKB of guest RAM is saved, see
+ * xrun_restore for the unsupported specs.
+ *
+ * @param container_id - unique container id string
+ * @param checkpoint - path to the checkpoint file
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_checkpoint(const char *container_id, const char *checkpoint);
+
 /**
  * @brief Pause runx container
  *
@@ -47,14 +160,77 @@ int xrun_pause(const char *container_id);
 int xrun_resume(const char *container_id);
 
 /**
- * @brief Kill runx container
+ * @brief Restart runx container
+ *
+ * Domain of the container is destroyed and created again with the same
+ * domid from the spec parsed on container start, so bundle config and
+ * device-tree are not read again. Kernel image is reopened, unless it is
+ * kept in memory (see CONFIG_XRUN_IMAGE_CACHE_SIZE).
  *
  * @param container_id - unique container id string
  *
  * @return - 0 on success and errno on error
  */
+int xrun_restart(const char *container_id);
+
+/**
+ * @brief Kill runx container
+ *
+ * Container which is still starting can't be killed.
+ *
+ * @param container_id - unique container id string
+ *
+ * @return - 0 on success, -EBUSY if the container is starting and errno
+ *         on other errors
+ */
 int xrun_kill(const char *container_id);
 
+/**
+ * @brief Stop runx container gracefully
+ *
+ * Domain is asked to power off through the control/shutdown xenstore
+ * node and container is in STOPPING state until the domain shuts down.
+ * Domain which doesn't shut down in timeout_ms is destroyed. Container is
+ * removed once its domain is gone, as by xrun_kill.
+ *
+ * @param container_id - unique container id string
+ * @param timeout_ms - time given to the domain to shut down, 0 - destroy
+ *        domain at once
+ *
+ * @return - 0 on success, -EBUSY if the container is starting and errno
+ *         on other errors
+ */
+int xrun_stop(const char *container_id, uint32_t timeout_ms);
+
+/**
+ * @brief Get time-to-stop statistics of xrun_stop
+ *
+ * @param stats - pointer to store the statistics
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_get_stop_stats(struct xrun_stop_stats *stats);
+
+/**
+ * @brief Kill all runx containers
+ *
+ * Every container is removed from the registry at once, containers which
+ * are still starting are skipped. Running domains
+ * are asked to power off, then the kill workers wait for each domain to
+ * shut down till the deadline and destroy it. Domains are destroyed in
+ * parallel by CONFIG_XRUN_KILL_THREADS workers.
+ *
+ * @param timeout_ms - time given to the domains to shut down, 0 - destroy
+ *        domains at once
+ * @param results - array to store per container results, may be NULL if
+ *        count is 0
+ * @param count - number of entries in the results array
+ *
+ * @return - number of killed containers or -errno on error
+ */
+ssize_t xrun_kill_all(uint32_t timeout_ms, struct xrun_kill_result *results,
+		      size_t count);
+
 /**
  * @brief Kill runx container
  *
@@ -65,6 +241,141 @@ int xrun_kill(const char *container_id);
  */
 int xrun_state(const char *container_id, enum container_status *state);
 
+/**
+ * @brief Set memory target of the running container
+ *
+ * Domain balloon driver is requested to release or claim memory to
+ * reach the target. Target should be in the range set by hwConfig
+ * minMemKB and maxMemKB fields of the spec.
+ *
+ * @param container_id - unique container id string
+ * @param mem_kb - memory target in KB
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_set_memory(const char *container_id, uint64_t mem_kb);
+
+/**
+ * @brief Pin vCPUs of the running container to physical CPUs
+ *
+ * @param container_id - unique container id string
+ * @param vcpu - vCPU number, negative value to pin all vCPUs
+ * @param cpumask - mask of physical CPUs the vCPU may run on
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_set_affinity(const char *container_id, int vcpu, uint32_t cpumask);
+
+/**
+ * @brief Set scheduler parameters of the running container
+ *
+ * @param container_id - unique container id string
+ * @param weight - relative scheduler weight, 1..65535 (default is 256)
+ * @param cap - maximum CPU time in percents of one pCPU, 0 for no cap.
+ *        Should not exceed 100 multiplied by number of vCPUs.
+ *
+ * Parameters are kept and applied again on restart. Only credit and
+ * credit2 schedulers support them, -ENOTSUP is returned for others.
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_set_sched(const char *container_id, uint32_t weight, uint32_t cap);
+
+/**
+ * @brief Get memory of the container
+ *
+ * @param container_id - unique container id string
+ * @param cur_kb - value to store memory currently allocated by domain
+ * @param target_kb - value to store memory target
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_get_memory(const char *container_id, uint64_t *cur_kb,
+		    uint64_t *target_kb);
+
+/**
+ * @brief Get domain id of the container
+ *
+ * @param container_id - unique container id string
+ * @param domid - value to store domain id
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_get_domid(const char *container_id, uint64_t *domid);
+
+/**
+ * @brief Set resource limits of the admission group
+ *
+ * Containers with the "group" spec field are admitted only while the sum
+ * of their maxMemKB and vcpus fits the group limits. Running containers
+ * are not affected when the limit is lowered.
+ *
+ * @param group - group name
+ * @param mem_kb - memory limit in KB, 0 - no limit
+ * @param vcpus - vCPUs limit, 0 - no limit
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_set_group_limit(const char *group, uint64_t mem_kb, uint32_t vcpus);
+
+/**
+ * @brief Get resources reserved and used by the containers
+ *
+ * @param group - group name, NULL for all containers
+ * @param info - pointer to store the resources information
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_get_admission(const char *group, struct xrun_admission_info *info);
+
+/**
+ * @brief Start containers listed in the boot manifest
+ *
+ * Manifest is a json file with the list of containers to start:
+ * {"containers": [{"id": "drv", "bundle": "/lfs/drv"},
+ *  {"id": "app", "bundle": "/lfs/app", "dependsOn": ["drv"],
+ *   "readyPath": "data/ready", "readyTimeoutMs": 5000}]}
+ *
+ * Containers are started in parallel, each one as soon as all its
+ * dependencies are ready. Container is ready once it is started, or once
+ * its domain writes readyPath xenstore node if one is set. Dependents of
+ * the failed container are not started.
+ *
+ * @param manifest - path to the manifest file
+ *
+ * @return - 0 if all containers are started and errno on error
+ */
+int xrun_autostart(const char *manifest);
+
+/**
+ * @brief Start container defined with XRUN_CONTAINER_DEFINE
+ *
+ * Spec of the container is taken from the build time definition, so
+ * config.json is not read and parsed. Embedded kernel and device-tree are
+ * not read from storage as well. Container id is the definition name.
+ *
+ * @param name - name of the container definition
+ * @param console_socket - socket to forward domain console output to
+ *
+ * @return - 0 on success and errno on error
+ */
+int xrun_run_static(const char *name, int console_socket);
+
+/**
+ * @brief Get state of all registered containers
+ *
+ * Fills the provided array in a single pass over the container
+ * registry. If there are more containers than entries in the array
+ * then only first count entries are filled.
+ *
+ * @param info - array to store containers information, may be NULL
+ *        if count is 0
+ * @param count - number of entries in the info array
+ *
+ * @return - total number of registered containers or -errno on error
+ */
+ssize_t xrun_list(struct xrun_container_info *info, size_t count);
+
 #ifdef __cplusplus
 }
 #endif
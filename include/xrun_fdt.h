@@ -0,0 +1,115 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_FDT_H
+#define XENLIB_XRUN_FDT_H
+
+#include <sys/types.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define XRUN_FDT_STRINGS_MAX 256
+
+/*
+ * Sequential flattened device-tree writer. Nodes and properties are
+ * appended in the tree order. Errors are sticky and reported by
+ * xrun_fdt_finish, so calls don't need to be checked one by one.
+ */
+struct xrun_fdt {
+	uint8_t *buf;
+	size_t size;
+	/* End of the structure block */
+	size_t off;
+	char strings[XRUN_FDT_STRINGS_MAX];
+	size_t strings_len;
+	int depth;
+	int err;
+};
+
+/**
+ * @brief Start device-tree in the buffer
+ *
+ * @param fdt - writer state
+ * @param buf - buffer for the device-tree, 4 bytes aligned
+ * @param size - size of the buffer
+ */
+void xrun_fdt_init(struct xrun_fdt *fdt, void *buf, size_t size);
+
+/**
+ * @brief Open node, root node has an empty name
+ *
+ * @param fdt - writer state
+ * @param name - node name
+ */
+void xrun_fdt_begin_node(struct xrun_fdt *fdt, const char *name);
+
+/**
+ * @brief Close the last opened node
+ *
+ * @param fdt - writer state
+ */
+void xrun_fdt_end_node(struct xrun_fdt *fdt);
+
+/**
+ * @brief Add property with raw value to the opened node
+ *
+ * @param fdt - writer state
+ * @param name - property name
+ * @param val - property value, may be NULL if len is 0
+ * @param len - length of the value
+ */
+void xrun_fdt_prop(struct xrun_fdt *fdt, const char *name, const void *val,
+		   size_t len);
+
+/**
+ * @brief Add property with cells converted to big-endian
+ *
+ * @param fdt - writer state
+ * @param name - property name
+ * @param cells - property cells
+ * @param count - number of cells
+ */
+void xrun_fdt_prop_cells(struct xrun_fdt *fdt, const char *name,
+			 const uint32_t *cells, size_t count);
+
+/**
+ * @brief Add single cell property
+ *
+ * @param fdt - writer state
+ * @param name - property name
+ * @param val - cell value
+ */
+void xrun_fdt_prop_u32(struct xrun_fdt *fdt, const char *name, uint32_t val);
+
+/**
+ * @brief Add string property
+ *
+ * @param fdt - writer state
+ * @param name - property name
+ * @param str - property value
+ */
+void xrun_fdt_prop_string(struct xrun_fdt *fdt, const char *name,
+			  const char *str);
+
+/**
+ * @brief Finish device-tree
+ *
+ * All opened nodes should be closed. Strings block is appended and the
+ * header is filled.
+ *
+ * @param fdt - writer state
+ *
+ * @return - size of the device-tree or -errno on error
+ */
+ssize_t xrun_fdt_finish(struct xrun_fdt *fdt);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_FDT_H */
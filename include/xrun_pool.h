@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_POOL_H
+#define XENLIB_XRUN_POOL_H
+
+#include <zephyr/kernel.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Worker threads running the same function in parallel with the caller.
+ * Pool is used by one caller at a time, the others wait for it.
+ */
+struct xrun_pool {
+	struct k_mutex lock;
+	struct k_thread *threads;
+	k_thread_stack_t *stacks;
+	/* Distance between the stacks of the array */
+	size_t stack_len;
+	size_t stack_size;
+	size_t count;
+};
+
+/* Defines pool of nr workers, one of them is the calling thread */
+#define XRUN_POOL_DEFINE(name, nr, size) \
+	static struct k_thread name##_threads[(nr) - 1]; \
+	static K_THREAD_STACK_ARRAY_DEFINE(name##_stacks, (nr) - 1, size); \
+	static struct xrun_pool name = { \
+		.lock = Z_MUTEX_INITIALIZER(name.lock), \
+		.threads = name##_threads, \
+		.stacks = (k_thread_stack_t *)name##_stacks, \
+		.stack_len = K_THREAD_STACK_LEN(size), \
+		.stack_size = K_THREAD_STACK_SIZEOF(name##_stacks[0]), \
+		.count = (nr) - 1, \
+	}
+
+/**
+ * @brief Runs worker in the pool threads and the calling thread
+ *
+ * Pool threads have the priority of the caller. Returns once all
+ * workers have returned.
+ *
+ * @param pool - pool defined with XRUN_POOL_DEFINE
+ * @param worker - function run by each worker
+ * @param ctx - first argument of the worker
+ */
+static inline void xrun_pool_run(struct xrun_pool *pool,
+				 k_thread_entry_t worker, void *ctx)
+{
+	size_t i;
+
+	k_mutex_lock(&pool->lock, K_FOREVER);
+	for (i = 0; i < pool->count; i++) {
+		k_thread_create(&pool->threads[i],
+				pool->stacks + i * pool->stack_len,
+				pool->stack_size, worker, ctx, NULL, NULL,
+				k_thread_priority_get(k_current_get()), 0,
+				K_NO_WAIT);
+	}
+
+	worker(ctx, NULL, NULL);
+
+	for (i = 0; i < pool->count; i++) {
+		k_thread_join(&pool->threads[i], K_FOREVER);
+	}
+	k_mutex_unlock(&pool->lock);
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_POOL_H */
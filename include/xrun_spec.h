@@ -0,0 +1,177 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_SPEC_H
+#define XENLIB_XRUN_SPEC_H
+
+#include <zephyr/sys/iterable_sections.h>
+#include <zephyr/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Container spec decoded from the bundle config.json. Field names follow
+ * the json fields, so the spec may be declared at build time as well.
+ */
+#define XRUN_JSON_PARAMETERS_MAX 24
+#define XRUN_VCPUS_MAX 24
+#define XRUN_DT_NODES_MAX 8
+#define XRUN_DT_NODE_REGS_MAX 4
+#define XRUN_DT_NODE_IRQS_MAX 4
+#define XRUN_DT_NODE_PROPS_MAX 8
+
+struct xrun_hypervisor_spec {
+	const char *path;
+	const char *parameters[XRUN_JSON_PARAMETERS_MAX];
+	size_t params_len;
+};
+
+struct xrun_kernel_spec {
+	const char *path;
+	const char *parameters[XRUN_JSON_PARAMETERS_MAX];
+	size_t params_len;
+};
+
+struct xrun_iomem_spec {
+	const uint64_t firstGFN;
+	const uint64_t firstMFN;
+	const uint64_t nrMFNs;
+};
+
+/* Passthrough node of the generated partial device-tree */
+struct xrun_dt_node_spec {
+	const char *name;
+	const char *compatible;
+	/* Host device-tree path of the assigned device, one of dtdevs */
+	const char *path;
+	/* Indexes of the hwConfig iomems, which make node reg */
+	const uint32_t reg[XRUN_DT_NODE_REGS_MAX];
+	/* Interrupts of the node, should be listed in hwConfig irqs */
+	const uint32_t interrupts[XRUN_DT_NODE_IRQS_MAX];
+	/* Extra string properties as "name=value", or "name" if empty */
+	const char *props[XRUN_DT_NODE_PROPS_MAX];
+	size_t reg_len;
+	size_t interrupts_len;
+	size_t props_len;
+};
+
+struct xrun_hwconfig_spec {
+	const char *deviceTree;
+	const uint32_t vcpus;
+	const uint64_t memKB;
+	/* Limits for the runtime memory resize, default to memKB */
+	const uint64_t minMemKB;
+	const uint64_t maxMemKB;
+	const char *dtdevs[CONFIG_XRUN_DTDEVS_MAX];
+	const struct xrun_iomem_spec iomems[CONFIG_XRUN_IOMEMS_MAX];
+	const uint32_t irqs[CONFIG_XRUN_IRQS_MAX];
+	/* Mask of physical CPUs all vCPUs may run on, 0 - no affinity */
+	const uint32_t cpuAffinity;
+	/* Masks of physical CPUs per vCPU, override cpuAffinity */
+	const uint32_t vcpuPinning[XRUN_VCPUS_MAX];
+	/*
+	 * Scheduler weight and cap in percents of one pCPU, 0 - default.
+	 * If both are default, the domain is left to the scheduler as is,
+	 * otherwise credit or credit2 scheduler is required.
+	 */
+	const uint32_t schedWeight;
+	const uint32_t schedCap;
+	/* Nodes of the partial device-tree generated if deviceTree is empty */
+	const struct xrun_dt_node_spec dtNodes[XRUN_DT_NODES_MAX];
+	size_t iomems_len;
+	size_t dtdevs_len;
+	size_t irqs_len;
+	size_t vcpuPinning_len;
+	size_t dtNodes_len;
+};
+
+struct xrun_restart_policy_spec {
+	/* "no", "on-failure" or "always", default is "no" */
+	const char *name;
+	/* Limit of consecutive restarts, 0 - no limit */
+	const uint32_t maxRetries;
+};
+
+struct xrun_vm_spec {
+	struct xrun_hypervisor_spec hypervisor;
+	struct xrun_kernel_spec kernel;
+	struct xrun_hwconfig_spec hwConfig;
+	/*
+	 * Pending starts with higher priority are started first, default
+	 * is 0. Start in progress is not preempted.
+	 */
+	int32_t priority;
+	/* Limit of the bundle read rate, 0 - global limit only */
+	uint32_t ioRateKBps;
+	struct xrun_restart_policy_spec restartPolicy;
+	/* Admission group the container resources are accounted to */
+	const char *group;
+};
+
+struct xrun_domain_spec {
+	const char *ociVersion;
+	struct xrun_vm_spec vm;
+};
+
+/* Container defined at build time, see XRUN_CONTAINER_DEFINE */
+struct xrun_static_container {
+	const char *name;
+	struct xrun_domain_spec spec;
+	/* Embedded images, vm.kernel.path and deviceTree are read if NULL */
+	const uint8_t *kernel;
+	size_t kernel_size;
+	const uint8_t *dtb;
+	size_t dtb_size;
+};
+
+/**
+ * @brief Define container with the spec known at build time
+ *
+ * Container is started by xrun_run_static(name) without reading and
+ * parsing of the bundle config. Spec is given as struct xrun_domain_spec
+ * initializer, e.g.:
+ *
+ * XRUN_CONTAINER_DEFINE(uni,
+ *	.vm.kernel.path = "/lfs/unikernel.bin",
+ *	.vm.hwConfig.memKB = 4096,
+ *	.vm.hwConfig.vcpus = 1);
+ *
+ * scripts/xrun_static_gen.py generates the definition from config.json.
+ *
+ * @param _name - container name, also used as container id
+ * @param ... - struct xrun_domain_spec initializer
+ */
+#define XRUN_CONTAINER_DEFINE(_name, ...) \
+	XRUN_CONTAINER_DEFINE_IMAGES(_name, NULL, 0, NULL, 0, __VA_ARGS__)
+
+/**
+ * @brief Define container with the spec and images embedded at build time
+ *
+ * @param _name - container name, also used as container id
+ * @param _kernel - kernel image bytes or NULL to read vm.kernel.path
+ * @param _kernel_size - size of the kernel image
+ * @param _dtb - partial device-tree bytes or NULL to read deviceTree
+ * @param _dtb_size - size of the device-tree
+ * @param ... - struct xrun_domain_spec initializer
+ */
+#define XRUN_CONTAINER_DEFINE_IMAGES(_name, _kernel, _kernel_size, _dtb, \
+				     _dtb_size, ...) \
+	static const STRUCT_SECTION_ITERABLE(xrun_static_container, \
+					     xrun_static_##_name) = { \
+		.name = #_name, \
+		.spec = { __VA_ARGS__ }, \
+		.kernel = (_kernel), \
+		.kernel_size = (_kernel_size), \
+		.dtb = (_dtb), \
+		.dtb_size = (_dtb_size), \
+	}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_SPEC_H */
@@ -0,0 +1,80 @@
+/* SPDX-License-Identifier: Apache-2.0
+ *
+ * Copyright (c) 2024 EPAM Systems
+ */
+
+#ifndef XENLIB_XRUN_TRACE_H
+#define XENLIB_XRUN_TRACE_H
+
+#ifdef CONFIG_XRUN_TRACING
+#include <zephyr/tracing/tracing.h>
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Trace events emitted by xrun as named events. Event name is the
+ * enumerator name, first argument is the event id and second argument
+ * is the event payload described below.
+ */
+enum xrun_trace_event {
+	/* Container start, payload is domid */
+	XRUN_TRACE_RUN_BEGIN = 0x58520000,
+	XRUN_TRACE_RUN_END,
+	/* Reading of config.json, payload is domid */
+	XRUN_TRACE_CONFIG_BEGIN,
+	XRUN_TRACE_CONFIG_END,
+	/* Parsing of the spec, payload is domid */
+	XRUN_TRACE_PARSE_BEGIN,
+	XRUN_TRACE_PARSE_END,
+	/* Opening of the bundle files, payload is domid */
+	XRUN_TRACE_OPEN_BEGIN,
+	XRUN_TRACE_OPEN_END,
+	/* Domain creation with image loading, payload is domid */
+	XRUN_TRACE_CREATE_BEGIN,
+	XRUN_TRACE_CREATE_END,
+	/* Domain post creation, payload is domid */
+	XRUN_TRACE_POST_CREATE_BEGIN,
+	XRUN_TRACE_POST_CREATE_END,
+	/* Kernel image chunk load, payload is chunk size */
+	XRUN_TRACE_IMAGE_CHUNK_BEGIN,
+	XRUN_TRACE_IMAGE_CHUNK_END,
+	/* Read through the debounce buffer, payload is read size */
+	XRUN_TRACE_DEBOUNCE_READ_BEGIN,
+	XRUN_TRACE_DEBOUNCE_READ_END,
+	/* Lock acquisition, payload is enum xrun_trace_lock */
+	XRUN_TRACE_LOCK_WAIT,
+	XRUN_TRACE_LOCK_ACQUIRED,
+};
+
+enum xrun_trace_lock {
+	XRUN_TRACE_LOCK_CONTAINERS,
+	XRUN_TRACE_LOCK_START_GATE,
+	XRUN_TRACE_LOCK_CHUNK,
+	XRUN_TRACE_LOCK_DEBOUNCE,
+};
+
+#ifdef CONFIG_XRUN_TRACING
+#define xrun_trace(event, arg) \
+	sys_trace_named_event(#event, (uint32_t)(event), (uint32_t)(arg))
+#else
+#define xrun_trace(event, arg) \
+	do { \
+	} while (0)
+#endif /* CONFIG_XRUN_TRACING */
+
+/* Trace time spent waiting for the lock taken by the lock statement */
+#define xrun_trace_lock(lock, statement) \
+	do { \
+		xrun_trace(XRUN_TRACE_LOCK_WAIT, lock); \
+		statement; \
+		xrun_trace(XRUN_TRACE_LOCK_ACQUIRED, lock); \
+	} while (0)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* XENLIB_XRUN_TRACE_H */
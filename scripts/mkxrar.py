@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+#
+# Copyright (c) 2024 EPAM Systems
+#
+"""Pack xrun bundle files into a single bundle archive (.xrar)."""
+
+import argparse
+import hashlib
+import os
+import struct
+
+MAGIC = 0x52415258
+VERSION = 1
+ALIGN = 4096
+ENTRIES_MAX = 16
+NAME_MAX = 32
+
+HEADER_FMT = '<IHH'
+ENTRY_FMT = '<%dsQQ32s' % NAME_MAX
+
+
+def align(value):
+    return (value + ALIGN - 1) // ALIGN * ALIGN
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('-o', '--output', required=True,
+                        help='output archive path')
+    parser.add_argument('--digest', action='store_true',
+                        help='store SHA-256 of the entries, xrun should '
+                        'be built with CONFIG_XRUN_ARCHIVE_VERIFY')
+    parser.add_argument('files', nargs='+',
+                        help='files to pack, use NAME=PATH to rename entry')
+    args = parser.parse_args()
+
+    if len(args.files) > ENTRIES_MAX:
+        parser.error('at most %d entries are supported' % ENTRIES_MAX)
+
+    entries = []
+    for spec in args.files:
+        name, _, path = spec.partition('=')
+        if not path:
+            name, path = os.path.basename(spec), spec
+        if len(name.encode()) >= NAME_MAX:
+            parser.error('entry name %s is too long' % name)
+        with open(path, 'rb') as f:
+            entries.append((name, f.read()))
+
+    header_size = struct.calcsize(HEADER_FMT) + \
+        ENTRIES_MAX * struct.calcsize(ENTRY_FMT)
+    offset = align(header_size)
+    index = b''
+    for name, data in entries:
+        digest = hashlib.sha256(data).digest() if args.digest else b''
+        index += struct.pack(ENTRY_FMT, name.encode(), offset, len(data),
+                             digest)
+        offset = align(offset + len(data))
+    index += b'\0' * ((ENTRIES_MAX - len(entries)) *
+                      struct.calcsize(ENTRY_FMT))
+
+    with open(args.output, 'wb') as out:
+        out.write(struct.pack(HEADER_FMT, MAGIC, VERSION, len(entries)))
+        out.write(index)
+        for _, data in entries:
+            out.write(b'\0' * (align(out.tell()) - out.tell()))
+            out.write(data)
+
+
+if __name__ == '__main__':
+    main()
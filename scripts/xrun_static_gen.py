@@ -0,0 +1,95 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: Apache-2.0
+#
+# Copyright (c) 2024 EPAM Systems
+#
+"""Generate XRUN_CONTAINER_DEFINE from the bundle config.json."""
+
+import argparse
+import json
+import re
+
+# Array fields with length member not named <field>_len
+LEN_FIELDS = {
+    'parameters': 'params_len',
+}
+
+
+def c_value(value):
+    if isinstance(value, str):
+        return json.dumps(value)
+    if isinstance(value, bool):
+        return '1' if value else '0'
+    if isinstance(value, int):
+        return '%dULL' % value if value > 0xffffffff else str(value)
+    if isinstance(value, dict):
+        return '{ %s }' % ', '.join('.%s = %s' % (k, c_value(v))
+                                    for k, v in value.items())
+    raise ValueError('unsupported value %r' % (value,))
+
+
+def initializers(obj, prefix=''):
+    for key, value in obj.items():
+        path = prefix + '.' + key
+        if isinstance(value, dict):
+            yield from initializers(value, path)
+        elif isinstance(value, list):
+            yield '%s = { %s }' % (path, ', '.join(c_value(v) for v in value))
+            yield '%s%s = %d' % (prefix + '.',
+                                 LEN_FIELDS.get(key, key + '_len'),
+                                 len(value))
+        else:
+            yield '%s = %s' % (path, c_value(value))
+
+
+def blob(out, name, path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    out.write('static const uint8_t %s[] __aligned(8) = {' % name)
+    for i in range(0, len(data), 12):
+        out.write('\n\t' + ' '.join('0x%02x,' % b for b in data[i:i + 12]))
+    out.write('\n};\n\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__)
+    parser.add_argument('-n', '--name', required=True,
+                        help='container name, C identifier')
+    parser.add_argument('-o', '--output', required=True,
+                        help='output C file path')
+    parser.add_argument('--kernel', help='kernel image to embed')
+    parser.add_argument('--dtb', help='partial device-tree to embed')
+    parser.add_argument('config', help='path to the bundle config.json')
+    args = parser.parse_args()
+
+    if not re.fullmatch(r'[A-Za-z_]\w*', args.name):
+        parser.error('name %s is not a C identifier' % args.name)
+
+    with open(args.config) as f:
+        spec = json.load(f)
+
+    with open(args.output, 'w') as out:
+        out.write('/* Generated by xrun_static_gen.py from %s */\n\n' %
+                  args.config)
+        out.write('#include <xrun_spec.h>\n\n')
+
+        kernel = dtb = ('NULL', '0')
+        if args.kernel:
+            blob_name = 'xrun_%s_kernel' % args.name
+            blob(out, blob_name, args.kernel)
+            kernel = (blob_name, 'sizeof(%s)' % blob_name)
+        if args.dtb:
+            blob_name = 'xrun_%s_dtb' % args.name
+            blob(out, blob_name, args.dtb)
+            dtb = (blob_name, 'sizeof(%s)' % blob_name)
+
+        out.write('XRUN_CONTAINER_DEFINE_IMAGES(%s, %s, %s, %s, %s' %
+                  ((args.name,) + kernel + dtb))
+        for init in initializers(spec):
+            out.write(',\n\t%s' % init)
+        out.write(');\n')
+
+
+if __name__ == '__main__':
+    main()
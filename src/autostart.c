@@ -0,0 +1,388 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (c) 2024 EPAM Systems
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/data/json.h>
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <hypervisor.h>
+#include <storage.h>
+#include <xrun.h>
+#include <xrun_pool.h>
+
+LOG_MODULE_REGISTER(xrun_autostart);
+
+#define AUTOSTART_DEPS_MAX 8
+#define AUTOSTART_READY_POLL_MS 10
+
+struct autostart_entry_spec {
+	const char *id;
+	const char *bundle;
+	const char *dependsOn[AUTOSTART_DEPS_MAX];
+	size_t dependsOn_len;
+	/* Xenstore node written by the domain when it is ready */
+	const char *readyPath;
+	uint32_t readyTimeoutMs;
+};
+
+struct autostart_spec {
+	struct autostart_entry_spec containers[CONFIG_XRUN_AUTOSTART_MAX];
+	size_t containers_len;
+};
+
+static const struct json_obj_descr autostart_entry_spec_descr[] = {
+	JSON_OBJ_DESCR_PRIM(struct autostart_entry_spec, id, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct autostart_entry_spec, bundle,
+			    JSON_TOK_STRING),
+	JSON_OBJ_DESCR_ARRAY(struct autostart_entry_spec, dependsOn,
+			     AUTOSTART_DEPS_MAX, dependsOn_len,
+			     JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct autostart_entry_spec, readyPath,
+			    JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct autostart_entry_spec, readyTimeoutMs,
+			    JSON_TOK_NUMBER),
+};
+
+static const struct json_obj_descr autostart_spec_descr[] = {
+	JSON_OBJ_DESCR_OBJ_ARRAY(struct autostart_spec, containers,
+				 CONFIG_XRUN_AUTOSTART_MAX, containers_len,
+				 autostart_entry_spec_descr,
+				 ARRAY_SIZE(autostart_entry_spec_descr)),
+};
+
+enum node_state {
+	NODE_WAITING = 0,
+	NODE_STARTING,
+	NODE_READY,
+	NODE_FAILED,
+};
+
+struct autostart_node {
+	const struct autostart_entry_spec *spec;
+	/* Indexes of the manifest dependencies */
+	uint8_t deps[AUTOSTART_DEPS_MAX];
+	size_t deps_len;
+	/* Dependencies which are not ready yet */
+	size_t pending;
+	/* Longest chain of dependents, critical path is started first */
+	uint32_t height;
+	enum node_state state;
+};
+
+struct autostart_graph {
+	struct autostart_spec spec;
+	struct autostart_node nodes[CONFIG_XRUN_AUTOSTART_MAX];
+	size_t count;
+	size_t done;
+	int result;
+	struct k_mutex lock;
+	struct k_condvar cond;
+};
+
+/* Only one manifest is started at a time, workers are shared */
+XRUN_POOL_DEFINE(autostart_pool, CONFIG_XRUN_AUTOSTART_THREADS,
+		 CONFIG_XRUN_AUTOSTART_STACK_SIZE);
+
+static int find_node(struct autostart_graph *graph, const char *id)
+{
+	size_t i;
+
+	for (i = 0; i < graph->count; i++) {
+		if (!strcmp(graph->nodes[i].spec->id, id)) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+
+static int build_graph(struct autostart_graph *graph)
+{
+	struct autostart_node *node;
+	enum container_status state;
+	bool changed = true;
+	size_t i, j, round;
+	int dep;
+
+	graph->count = graph->spec.containers_len;
+	for (i = 0; i < graph->count; i++) {
+		graph->nodes[i].spec = &graph->spec.containers[i];
+		if (!graph->nodes[i].spec->id || !graph->nodes[i].spec->bundle) {
+			LOG_ERR("Container %zu has no id or bundle", i);
+			return -EINVAL;
+		}
+	}
+
+	for (i = 0; i < graph->count; i++) {
+		node = &graph->nodes[i];
+		for (j = 0; j < node->spec->dependsOn_len; j++) {
+			dep = find_node(graph, node->spec->dependsOn[j]);
+			if (dep >= 0) {
+				node->deps[node->deps_len++] = dep;
+				continue;
+			}
+
+			if (xrun_state(node->spec->dependsOn[j], &state)) {
+				LOG_ERR("Unknown dependency %s of %s",
+					node->spec->dependsOn[j],
+					node->spec->id);
+				return -ENOENT;
+			}
+
+			/*
+			 * Dependency started before is ready only if it
+			 * runs, it may be still starting, stopped or paused.
+			 */
+			if (state != RUNNING) {
+				LOG_ERR("Dependency %s of %s is not running (%d)",
+					node->spec->dependsOn[j],
+					node->spec->id, state);
+				return -ESRCH;
+			}
+		}
+		node->pending = node->deps_len;
+	}
+
+	/*
+	 * Each round raises dependencies above their dependents. Heights
+	 * can't change after count rounds unless there is a cycle.
+	 */
+	for (round = 0; changed; round++) {
+		if (round > graph->count) {
+			LOG_ERR("Dependency cycle in the manifest");
+			return -ELOOP;
+		}
+
+		changed = false;
+		for (i = 0; i < graph->count; i++) {
+			node = &graph->nodes[i];
+			for (j = 0; j < node->deps_len; j++) {
+				if (graph->nodes[node->deps[j]].height <=
+				    node->height) {
+					graph->nodes[node->deps[j]].height =
+						node->height + 1;
+					changed = true;
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+static int wait_ready(const struct autostart_entry_spec *spec)
+{
+	uint32_t timeout_ms = spec->readyTimeoutMs ?
+		spec->readyTimeoutMs : CONFIG_XRUN_AUTOSTART_READY_TIMEOUT_MS;
+	int64_t deadline = k_uptime_get() + timeout_ms;
+	uint64_t domid;
+	char value[16];
+	int ret;
+
+	ret = xrun_get_domid(spec->id, &domid);
+	if (ret) {
+		return ret;
+	}
+
+	while (xrun_hyp_read_node(domid, spec->readyPath, value,
+				  sizeof(value))) {
+		if (k_uptime_get() >= deadline) {
+			LOG_ERR("Container %s isn't ready in %u ms", spec->id,
+				timeout_ms);
+			return -ETIMEDOUT;
+		}
+		k_msleep(AUTOSTART_READY_POLL_MS);
+	}
+
+	return 0;
+}
+
+/* Called with graph lock held */
+static void fail_dependents(struct autostart_graph *graph, size_t failed)
+{
+	struct autostart_node *node;
+	size_t i, j;
+
+	for (i = 0; i < graph->count; i++) {
+		node = &graph->nodes[i];
+		if (node->state != NODE_WAITING) {
+			continue;
+		}
+
+		for (j = 0; j < node->deps_len; j++) {
+			if (node->deps[j] == failed) {
+				LOG_ERR("Container %s isn't started, %s failed",
+					node->spec->id,
+					graph->nodes[failed].spec->id);
+				node->state = NODE_FAILED;
+				graph->done++;
+				fail_dependents(graph, i);
+				break;
+			}
+		}
+	}
+}
+
+/* Called with graph lock held */
+static void complete_node(struct autostart_graph *graph, size_t idx, int ret)
+{
+	struct autostart_node *node;
+	size_t i, j;
+
+	graph->done++;
+	if (ret) {
+		graph->nodes[idx].state = NODE_FAILED;
+		if (!graph->result) {
+			graph->result = ret;
+		}
+		fail_dependents(graph, idx);
+		return;
+	}
+
+	graph->nodes[idx].state = NODE_READY;
+	for (i = 0; i < graph->count; i++) {
+		node = &graph->nodes[i];
+		for (j = 0; j < node->deps_len; j++) {
+			if (node->deps[j] == idx) {
+				node->pending--;
+			}
+		}
+	}
+}
+
+/* Called with graph lock held, returns -ENOENT if nothing can start */
+static int pick_node(struct autostart_graph *graph)
+{
+	struct autostart_node *node;
+	int best = -ENOENT;
+	size_t i;
+
+	for (i = 0; i < graph->count; i++) {
+		node = &graph->nodes[i];
+		if (node->state != NODE_WAITING || node->pending) {
+			continue;
+		}
+
+		if (best < 0 || node->height > graph->nodes[best].height) {
+			best = i;
+		}
+	}
+
+	return best;
+}
+
+static void autostart_worker(void *p1, void *p2, void *p3)
+{
+	struct autostart_graph *graph = p1;
+	const struct autostart_entry_spec *spec;
+	int idx, ret;
+
+	k_mutex_lock(&graph->lock, K_FOREVER);
+	while (graph->done < graph->count) {
+		idx = pick_node(graph);
+		if (idx < 0) {
+			/* Wait for dependencies started by other workers */
+			k_condvar_wait(&graph->cond, &graph->lock, K_FOREVER);
+			continue;
+		}
+
+		graph->nodes[idx].state = NODE_STARTING;
+		spec = graph->nodes[idx].spec;
+		k_mutex_unlock(&graph->lock);
+
+		ret = xrun_run(spec->bundle, 0, spec->id);
+		if (ret) {
+			LOG_ERR("Failed to start %s (%d)", spec->id, ret);
+		} else if (spec->readyPath) {
+			ret = wait_ready(spec);
+		}
+
+		k_mutex_lock(&graph->lock, K_FOREVER);
+		complete_node(graph, idx, ret);
+		k_condvar_broadcast(&graph->cond);
+	}
+	k_mutex_unlock(&graph->lock);
+}
+
+int xrun_autostart(const char *manifest)
+{
+	struct autostart_graph *graph;
+	int64_t start = k_uptime_get();
+	ssize_t size;
+	char *json;
+	int ret;
+
+	if (!manifest) {
+		return -EINVAL;
+	}
+
+	json = k_malloc(CONFIG_XRUN_AUTOSTART_MANIFEST_SIZE);
+	graph = k_calloc(1, sizeof(*graph));
+	if (!json || !graph) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	size = xrun_read_file(manifest, json,
+			      CONFIG_XRUN_AUTOSTART_MANIFEST_SIZE, 0);
+	if (size < 0) {
+		LOG_ERR("Can't read manifest %s (%ld)", manifest, size);
+		ret = size;
+		goto out;
+	}
+
+	ret = json_obj_parse(json, size, autostart_spec_descr,
+			     ARRAY_SIZE(autostart_spec_descr), &graph->spec);
+	if (ret < 0) {
+		LOG_ERR("Manifest parse error: %d", ret);
+		goto out;
+	}
+
+	ret = build_graph(graph);
+	if (ret) {
+		goto out;
+	}
+
+	k_mutex_init(&graph->lock);
+	k_condvar_init(&graph->cond);
+
+	xrun_pool_run(&autostart_pool, autostart_worker, graph);
+
+	ret = graph->result;
+	LOG_INF("Manifest %s started in %lld ms (%d)", manifest,
+		k_uptime_get() - start, ret);
+out:
+	k_free(graph);
+	k_free(json);
+	return ret;
+}
+
+#ifdef CONFIG_XRUN_AUTOSTART_BOOT
+static struct k_thread autostart_boot_thread;
+static K_THREAD_STACK_DEFINE(autostart_boot_stack,
+			     CONFIG_XRUN_AUTOSTART_STACK_SIZE);
+
+static void autostart_boot(void *p1, void *p2, void *p3)
+{
+	xrun_autostart(CONFIG_XRUN_AUTOSTART_MANIFEST);
+}
+
+static int autostart_init(void)
+{
+	k_thread_create(&autostart_boot_thread, autostart_boot_stack,
+			K_THREAD_STACK_SIZEOF(autostart_boot_stack),
+			autostart_boot, NULL, NULL, NULL,
+			K_PRIO_PREEMPT(CONFIG_XRUN_AUTOSTART_THREAD_PRIO), 0,
+			K_NO_WAIT);
+	k_thread_name_set(&autostart_boot_thread, "xrun_autostart");
+
+	return 0;
+}
+
+SYS_INIT(autostart_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+#endif /* CONFIG_XRUN_AUTOSTART_BOOT */
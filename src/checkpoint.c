@@ -0,0 +1,363 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (c) 2024 EPAM Systems
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <checkpoint.h>
+#include <hypervisor.h>
+#include <storage.h>
+
+LOG_MODULE_REGISTER(xrun_checkpoint);
+
+/* "XRCP" */
+#define CKPT_MAGIC 0x50435258
+#define CKPT_VERSION 1
+
+/* Number of guest pages mapped at once */
+#define CKPT_MAP_PAGES 16
+
+enum ckpt_record_type {
+	CKPT_REC_DATA = 1,
+	CKPT_REC_ZERO,
+	CKPT_REC_END,
+};
+
+/*
+ * Checkpoint file layout:
+ *   struct ckpt_header
+ *   nr_vcpus vCPU contexts of ctx_size bytes
+ *   struct ckpt_record [+ nr_pages pages for CKPT_REC_DATA] ...
+ *   struct ckpt_record with CKPT_REC_END type
+ */
+struct ckpt_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t nr_vcpus;
+	uint32_t ctx_size;
+	uint32_t page_size;
+	uint64_t mem_kb;
+} __packed;
+
+struct ckpt_record {
+	uint32_t type;
+	uint32_t nr_pages;
+	/* Page index from the start of the guest RAM */
+	uint64_t first_page;
+} __packed;
+
+static bool page_is_zero(const uint8_t *page)
+{
+	const uint64_t *data = (const uint64_t *)page;
+	int i;
+
+	for (i = 0; i < XRUN_PAGE_SIZE / sizeof(*data); i++) {
+		if (data[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+static int write_record(struct xrun_stream *stream, uint32_t type,
+			uint64_t first_page, uint32_t nr_pages,
+			const uint8_t *data)
+{
+	struct ckpt_record rec = {
+		.type = type,
+		.nr_pages = nr_pages,
+		.first_page = first_page,
+	};
+	ssize_t rc;
+
+	rc = xrun_stream_write(stream, (const uint8_t *)&rec, sizeof(rec));
+	if (rc < 0) {
+		return rc;
+	}
+
+	if (data) {
+		rc = xrun_stream_write(stream, data, nr_pages * XRUN_PAGE_SIZE);
+		if (rc < 0) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+static int save_memory(struct xrun_stream *stream, uint32_t domid,
+		       uint64_t gfn, uint64_t nr_pages)
+{
+	uint64_t page, zero_pages = 0;
+	size_t batch, run_start, i;
+	bool run_zero, zero;
+	uint8_t *addr;
+	int rc = 0;
+
+	for (page = 0; page < nr_pages; page += batch) {
+		batch = MIN(CKPT_MAP_PAGES, nr_pages - page);
+
+		rc = xrun_hyp_map_guest_pages(domid, gfn + page, batch,
+					      (void **)&addr);
+		if (rc) {
+			return rc;
+		}
+
+		/* Split mapped pages to the runs of zero and data pages */
+		run_start = 0;
+		run_zero = page_is_zero(addr);
+		for (i = 1; i <= batch; i++) {
+			zero = (i < batch) ?
+				page_is_zero(addr + i * XRUN_PAGE_SIZE) : false;
+			if (i < batch && zero == run_zero) {
+				continue;
+			}
+
+			rc = write_record(stream,
+					  run_zero ? CKPT_REC_ZERO : CKPT_REC_DATA,
+					  page + run_start, i - run_start,
+					  run_zero ? NULL :
+					  addr + run_start * XRUN_PAGE_SIZE);
+			if (rc) {
+				break;
+			}
+
+			if (run_zero) {
+				zero_pages += i - run_start;
+			}
+
+			run_start = i;
+			run_zero = zero;
+		}
+
+		xrun_hyp_unmap_guest_pages(addr, batch);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	LOG_INF("Saved %llu pages, %llu zero pages elided", nr_pages - zero_pages,
+		zero_pages);
+	return 0;
+}
+
+int xrun_checkpoint_save(uint32_t domid, uint64_t mem_kb, uint32_t nr_vcpus,
+			 const char *fpath)
+{
+	struct ckpt_header hdr = {
+		.magic = CKPT_MAGIC,
+		.version = CKPT_VERSION,
+		.nr_vcpus = nr_vcpus,
+		.ctx_size = xrun_hyp_vcpu_context_size(),
+		.page_size = XRUN_PAGE_SIZE,
+		.mem_kb = mem_kb,
+	};
+	struct xrun_stream *stream;
+	uint64_t gfn;
+	uint8_t *ctx;
+	uint32_t vcpu;
+	ssize_t rc;
+
+	rc = xrun_hyp_guest_ram_gfn(mem_kb, &gfn);
+	if (rc) {
+		return rc;
+	}
+
+	ctx = k_malloc(hdr.ctx_size);
+	if (!ctx) {
+		LOG_ERR("Unable to allocate vCPU context");
+		return -ENOMEM;
+	}
+
+	rc = xrun_stream_create(fpath, &stream);
+	if (rc) {
+		goto out_free;
+	}
+
+	rc = xrun_stream_write(stream, (const uint8_t *)&hdr, sizeof(hdr));
+	if (rc < 0) {
+		goto out_close;
+	}
+
+	for (vcpu = 0; vcpu < nr_vcpus; vcpu++) {
+		rc = xrun_hyp_get_vcpu_context(domid, vcpu, ctx);
+		if (rc) {
+			LOG_ERR("Failed to get vCPU%u context (%zd)", vcpu, rc);
+			goto out_close;
+		}
+
+		rc = xrun_stream_write(stream, ctx, hdr.ctx_size);
+		if (rc < 0) {
+			goto out_close;
+		}
+	}
+
+	rc = save_memory(stream, domid, gfn, mem_kb * 1024 / XRUN_PAGE_SIZE);
+	if (rc) {
+		goto out_close;
+	}
+
+	rc = write_record(stream, CKPT_REC_END, 0, 0, NULL);
+
+out_close:
+	xrun_stream_close(stream);
+out_free:
+	k_free(ctx);
+	if (rc < 0) {
+		LOG_ERR("Failed to save checkpoint %s (%zd)", fpath, rc);
+		return rc;
+	}
+
+	return 0;
+}
+
+static int load_pages(struct xrun_stream *stream, uint32_t domid,
+		      uint64_t gfn, const struct ckpt_record *rec,
+		      uint64_t *offset)
+{
+	uint64_t page = rec->first_page;
+	uint64_t end = rec->first_page + rec->nr_pages;
+	size_t batch;
+	uint8_t *addr;
+	ssize_t rc;
+
+	for (; page < end; page += batch) {
+		batch = MIN(CKPT_MAP_PAGES, end - page);
+
+		rc = xrun_hyp_map_guest_pages(domid, gfn + page, batch,
+					      (void **)&addr);
+		if (rc) {
+			return rc;
+		}
+
+		if (rec->type == CKPT_REC_ZERO) {
+			memset(addr, 0, batch * XRUN_PAGE_SIZE);
+			rc = 0;
+		} else {
+			rc = xrun_stream_read(stream, addr, batch * XRUN_PAGE_SIZE,
+					      *offset);
+			if (rc >= 0 && rc != batch * XRUN_PAGE_SIZE) {
+				rc = -EIO;
+			}
+			*offset += batch * XRUN_PAGE_SIZE;
+		}
+
+		xrun_hyp_unmap_guest_pages(addr, batch);
+		if (rc < 0) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+int xrun_checkpoint_load(uint32_t domid, uint64_t mem_kb, uint32_t nr_vcpus,
+			 const char *fpath)
+{
+	struct xrun_stream *stream;
+	struct ckpt_header hdr;
+	struct ckpt_record rec;
+	uint64_t offset = 0, gfn, nr_pages;
+	uint8_t *ctx = NULL;
+	uint32_t vcpu;
+	ssize_t rc;
+
+	rc = xrun_hyp_guest_ram_gfn(mem_kb, &gfn);
+	if (rc) {
+		return rc;
+	}
+
+	rc = xrun_stream_open(fpath, &stream);
+	if (rc) {
+		return rc;
+	}
+
+	rc = xrun_stream_read(stream, (uint8_t *)&hdr, sizeof(hdr), offset);
+	if (rc != sizeof(hdr)) {
+		rc = (rc < 0) ? rc : -EIO;
+		goto out;
+	}
+	offset += sizeof(hdr);
+
+	if (hdr.magic != CKPT_MAGIC || hdr.version != CKPT_VERSION ||
+	    hdr.page_size != XRUN_PAGE_SIZE ||
+	    hdr.ctx_size != xrun_hyp_vcpu_context_size()) {
+		LOG_ERR("Checkpoint %s has unsupported format", fpath);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	if (hdr.mem_kb != mem_kb || hdr.nr_vcpus != nr_vcpus) {
+		LOG_ERR("Checkpoint %s doesn't match domain configuration", fpath);
+		rc = -EINVAL;
+		goto out;
+	}
+
+	ctx = k_malloc(hdr.ctx_size);
+	if (!ctx) {
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	nr_pages = mem_kb * 1024 / XRUN_PAGE_SIZE;
+	offset += nr_vcpus * hdr.ctx_size;
+
+	for (;;) {
+		rc = xrun_stream_read(stream, (uint8_t *)&rec, sizeof(rec),
+				      offset);
+		if (rc != sizeof(rec)) {
+			rc = (rc < 0) ? rc : -EIO;
+			goto out;
+		}
+		offset += sizeof(rec);
+
+		if (rec.type == CKPT_REC_END) {
+			break;
+		}
+
+		if ((rec.type != CKPT_REC_DATA && rec.type != CKPT_REC_ZERO) ||
+		    rec.first_page + rec.nr_pages > nr_pages) {
+			LOG_ERR("Checkpoint %s is corrupted", fpath);
+			rc = -EINVAL;
+			goto out;
+		}
+
+		rc = load_pages(stream, domid, gfn, &rec, &offset);
+		if (rc) {
+			goto out;
+		}
+	}
+
+	/* vCPU contexts are set once memory is restored */
+	offset = sizeof(hdr);
+	for (vcpu = 0; vcpu < nr_vcpus; vcpu++) {
+		rc = xrun_stream_read(stream, ctx, hdr.ctx_size, offset);
+		if (rc != hdr.ctx_size) {
+			rc = (rc < 0) ? rc : -EIO;
+			goto out;
+		}
+		offset += hdr.ctx_size;
+
+		rc = xrun_hyp_set_vcpu_context(domid, vcpu, ctx);
+		if (rc) {
+			LOG_ERR("Failed to set vCPU%u context (%zd)", vcpu, rc);
+			goto out;
+		}
+	}
+
+	rc = 0;
+out:
+	k_free(ctx);
+	xrun_stream_close(stream);
+	if (rc < 0) {
+		LOG_ERR("Failed to load checkpoint %s (%zd)", fpath, rc);
+		return rc;
+	}
+
+	return 0;
+}
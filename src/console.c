@@ -0,0 +1,286 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (c) 2024 EPAM Systems
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/init.h>
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/posix/fcntl.h>
+#include <zephyr/posix/unistd.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/xen/events.h>
+#include <zephyr/xen/public/io/console.h>
+
+#include <console.h>
+#include <hypervisor.h>
+
+LOG_MODULE_REGISTER(xrun_console);
+
+struct console_port {
+	bool used;
+	uint32_t domid;
+	int fd;
+	struct xencons_interface *intf;
+	evtchn_port_t local_port;
+	/* Set from event channel callback, cleared by the pump */
+	atomic_t pending;
+	uint64_t bytes;
+	uint32_t writes;
+	uint64_t dropped;
+	/* fd failed, output is consumed but not forwarded anymore */
+	bool broken;
+};
+
+static struct console_port console_ports[CONFIG_XRUN_CONSOLE_MAX];
+static K_MUTEX_DEFINE(console_lock);
+static K_SEM_DEFINE(console_wake, 0, 1);
+
+static struct k_thread console_thread;
+static K_THREAD_STACK_DEFINE(console_stack, CONFIG_XRUN_CONSOLE_STACK_SIZE);
+
+static void console_evtchn_cb(void *priv)
+{
+	struct console_port *port = priv;
+
+	atomic_set(&port->pending, 1);
+	k_sem_give(&console_wake);
+}
+
+/*
+ * Forwards len bytes to fd and returns the number of bytes consumed from
+ * the ring. Output is dropped, so the domain doesn't stall, if the reader
+ * is slow or fd has failed. Failed fd is not written anymore.
+ */
+static ssize_t console_write(struct console_port *port, const char *buf,
+			     size_t len)
+{
+	ssize_t rc;
+
+	if (port->broken) {
+		port->dropped += len;
+		return len;
+	}
+
+	/* fd is non-blocking, full socket doesn't stall the pump */
+	do {
+		rc = write(port->fd, buf, len);
+	} while (rc < 0 && errno == EINTR);
+
+	if (rc > 0) {
+		port->bytes += rc;
+		port->writes++;
+		return rc;
+	}
+
+	if (rc == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+		LOG_ERR("Console of domain %u is not forwarded anymore (%d)",
+			port->domid, rc ? -errno : -EPIPE);
+		port->broken = true;
+	}
+
+	port->dropped += len;
+	return len;
+}
+
+/*
+ * Writes up to budget bytes from the ring straight to fd. Returns true
+ * if output is left in the ring.
+ */
+static bool console_drain(struct console_port *port, size_t budget)
+{
+	struct xencons_interface *intf = port->intf;
+	XENCONS_RING_IDX start, cons, prod;
+	size_t done = 0, len, off;
+	ssize_t rc;
+
+	start = cons = intf->out_cons;
+	prod = intf->out_prod;
+	/* Read ring data only after producer index */
+	barrier_dmem_fence_full();
+
+	if (prod - cons > sizeof(intf->out)) {
+		LOG_ERR("Console ring of domain %u is corrupted", port->domid);
+		cons = prod;
+	}
+
+	while (cons != prod && done < budget) {
+		/* Contiguous part of the ring till the producer or wrap */
+		off = MASK_XENCONS_IDX(cons, intf->out);
+		len = MIN(prod - cons, sizeof(intf->out) - off);
+		len = MIN(len, budget - done);
+
+		rc = console_write(port, &intf->out[off], len);
+		cons += rc;
+		done += rc;
+	}
+
+	/* Nothing consumed, domain has no free space to be told about */
+	if (cons == start) {
+		return false;
+	}
+
+	barrier_dmem_fence_full();
+	intf->out_cons = cons;
+	notify_evtchn(port->local_port);
+
+	return cons != prod;
+}
+
+static void console_pump(void *p1, void *p2, void *p3)
+{
+	struct console_port *port;
+	bool more;
+	int i;
+
+	for (;;) {
+		k_sem_take(&console_wake, K_FOREVER);
+
+		more = false;
+		k_mutex_lock(&console_lock, K_FOREVER);
+		for (i = 0; i < ARRAY_SIZE(console_ports); i++) {
+			port = &console_ports[i];
+			if (!port->used || !atomic_cas(&port->pending, 1, 0)) {
+				continue;
+			}
+
+			/* Each console gets one batch per round */
+			if (console_drain(port, CONFIG_XRUN_CONSOLE_BATCH)) {
+				atomic_set(&port->pending, 1);
+				more = true;
+			}
+		}
+		k_mutex_unlock(&console_lock);
+
+		if (more) {
+			/* Let others run before the next round */
+			k_yield();
+			k_sem_give(&console_wake);
+		}
+	}
+}
+
+/*
+ * Console is drained with console_lock held, so writes shouldn't wait for
+ * the reader. Files which don't support O_NONBLOCK are written as is.
+ */
+static void console_set_nonblock(int fd)
+{
+	int flags = fcntl(fd, F_GETFL, 0);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+		LOG_WRN("Unable to make console fd %d non-blocking (%d)", fd,
+			errno);
+	}
+}
+
+int xrun_console_start(uint32_t domid, int fd)
+{
+	struct console_port *port = NULL;
+	uint64_t gfn;
+	uint32_t remote_port;
+	void *ring;
+	int i, rc;
+
+	if (fd < 0) {
+		return -EINVAL;
+	}
+
+	console_set_nonblock(fd);
+
+	rc = xrun_hyp_get_console(domid, &gfn, &remote_port);
+	if (rc) {
+		return rc;
+	}
+
+	k_mutex_lock(&console_lock, K_FOREVER);
+	for (i = 0; i < ARRAY_SIZE(console_ports); i++) {
+		if (!console_ports[i].used) {
+			port = &console_ports[i];
+			break;
+		}
+	}
+
+	if (!port) {
+		LOG_ERR("No free console for domain %u", domid);
+		rc = -ENOMEM;
+		goto out;
+	}
+
+	rc = xrun_hyp_map_guest_pages(domid, gfn, 1, &ring);
+	if (rc) {
+		goto out;
+	}
+
+	memset(port, 0, sizeof(*port));
+	port->domid = domid;
+	port->fd = fd;
+	port->intf = ring;
+
+	rc = bind_interdomain_event_channel(domid, remote_port,
+					    console_evtchn_cb, port);
+	if (rc < 0) {
+		LOG_ERR("Failed to bind console evtchn of domain %u (%d)",
+			domid, rc);
+		xrun_hyp_unmap_guest_pages(ring, 1);
+		goto out;
+	}
+
+	port->local_port = rc;
+	port->used = true;
+	rc = 0;
+
+	/* Pick up output produced before the console was bound */
+	atomic_set(&port->pending, 1);
+	k_sem_give(&console_wake);
+out:
+	k_mutex_unlock(&console_lock);
+	return rc;
+}
+
+int xrun_console_stop(uint32_t domid)
+{
+	struct console_port *port;
+	int i, rc = -ENOENT;
+
+	k_mutex_lock(&console_lock, K_FOREVER);
+	for (i = 0; i < ARRAY_SIZE(console_ports); i++) {
+		port = &console_ports[i];
+		if (!port->used || port->domid != domid) {
+			continue;
+		}
+
+		/* Flush the rest of the output, ring can't hold more */
+		console_drain(port, sizeof(port->intf->out));
+
+		unbind_event_channel(port->local_port);
+		evtchn_close(port->local_port);
+
+		rc = xrun_hyp_unmap_guest_pages(port->intf, 1);
+		port->used = false;
+
+		LOG_DBG("Domain %u console: %llu bytes in %u writes, %llu dropped",
+			domid, port->bytes, port->writes, port->dropped);
+		break;
+	}
+	k_mutex_unlock(&console_lock);
+
+	return rc;
+}
+
+static int console_init(void)
+{
+	k_thread_create(&console_thread, console_stack,
+			K_THREAD_STACK_SIZEOF(console_stack), console_pump,
+			NULL, NULL, NULL,
+			K_PRIO_PREEMPT(CONFIG_XRUN_CONSOLE_THREAD_PRIO), 0,
+			K_NO_WAIT);
+	k_thread_name_set(&console_thread, "xrun_console");
+
+	return 0;
+}
+
+SYS_INIT(console_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
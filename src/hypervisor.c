@@ -0,0 +1,385 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (c) 2024 EPAM Systems
+ */
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/arch/arm64/hypercall.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/xen/dom0/domctl.h>
+#include <zephyr/xen/dom0/sysctl.h>
+#include <zephyr/xen/events.h>
+#include <zephyr/xen/public/arch-arm.h>
+#include <zephyr/xen/public/domctl.h>
+#include <zephyr/xen/public/event_channel.h>
+#include <zephyr/xen/public/sched.h>
+#include <zephyr/xen/public/xen.h>
+
+#include <mem-mgmt.h>
+#include <xss.h>
+#include <hypervisor.h>
+
+LOG_MODULE_REGISTER(xrun_hyp);
+
+int xrun_hyp_guest_ram_gfn(uint64_t mem_kb, uint64_t *gfn)
+{
+	if (!gfn) {
+		return -EINVAL;
+	}
+
+	/* Only the first RAM bank is supported */
+	if (mem_kb > GUEST_RAM0_SIZE / 1024) {
+		LOG_ERR("Domain memory %llu KB doesn't fit in RAM0", mem_kb);
+		return -E2BIG;
+	}
+
+	*gfn = GUEST_RAM0_BASE / XRUN_PAGE_SIZE;
+	return 0;
+}
+
+int xrun_hyp_map_guest_pages(uint32_t domid, uint64_t gfn, size_t nr_pages,
+			     void **addr)
+{
+	int rc;
+
+	rc = xenmem_map_region(domid, nr_pages, gfn, addr);
+	if (rc) {
+		LOG_ERR("Failed to map %zu pages at gfn %llx of domain %u (%d)",
+			nr_pages, gfn, domid, rc);
+	}
+
+	return rc;
+}
+
+int xrun_hyp_unmap_guest_pages(void *addr, size_t nr_pages)
+{
+	return xenmem_unmap_region(nr_pages, addr);
+}
+
+size_t xrun_hyp_vcpu_context_size(void)
+{
+	return sizeof(vcpu_guest_context_t);
+}
+
+int xrun_hyp_get_vcpu_context(uint32_t domid, uint32_t vcpu, void *ctx)
+{
+	return xen_domctl_getvcpucontext(domid, vcpu, ctx);
+}
+
+int xrun_hyp_set_vcpu_context(uint32_t domid, uint32_t vcpu, void *ctx)
+{
+	return xen_domctl_setvcpucontext(domid, vcpu, ctx);
+}
+
+int xrun_hyp_set_max_mem(uint32_t domid, uint64_t max_kb)
+{
+	int rc;
+
+	rc = xen_domctl_max_mem(domid, max_kb);
+	if (rc) {
+		LOG_ERR("Failed to set max memory %llu KB of domain %u (%d)",
+			max_kb, domid, rc);
+	}
+
+	return rc;
+}
+
+int xrun_hyp_set_mem_target(uint32_t domid, uint64_t target_kb)
+{
+	char path[64];
+	char value[24];
+	int rc;
+
+	snprintf(path, sizeof(path), "/local/domain/%u/memory/target", domid);
+	snprintf(value, sizeof(value), "%llu", target_kb);
+
+	rc = xss_write(path, value);
+	if (rc) {
+		LOG_ERR("Failed to write %s (%d)", path, rc);
+	}
+
+	return rc;
+}
+
+int xrun_hyp_get_mem(uint32_t domid, uint64_t *mem_kb)
+{
+	xen_domctl_getdomaininfo_t info;
+	int rc;
+
+	if (!mem_kb) {
+		return -EINVAL;
+	}
+
+	rc = xen_domctl_getdomaininfo(domid, &info);
+	if (rc) {
+		LOG_ERR("Failed to get info of domain %u (%d)", domid, rc);
+		return rc;
+	}
+
+	*mem_kb = info.tot_pages * (XRUN_PAGE_SIZE / 1024);
+	return 0;
+}
+
+int xrun_hyp_set_vcpu_affinity(uint32_t domid, uint32_t vcpu,
+			       uint32_t cpumask)
+{
+	xen_domctl_t domctl = {
+		.cmd = XEN_DOMCTL_setvcpuaffinity,
+		.interface_version = XEN_DOMCTL_INTERFACE_VERSION,
+		.domain = domid,
+	};
+	uint8_t bitmap[sizeof(cpumask)];
+	int rc;
+
+	/* Xen expects CPU bitmap as a little-endian byte array */
+	sys_put_le32(cpumask, bitmap);
+
+	domctl.u.vcpuaffinity.vcpu = vcpu;
+	domctl.u.vcpuaffinity.flags = XEN_VCPUAFFINITY_HARD;
+	set_xen_guest_handle(domctl.u.vcpuaffinity.cpumap_hard.bitmap, bitmap);
+	domctl.u.vcpuaffinity.cpumap_hard.nr_bits = sizeof(cpumask) * 8;
+
+	rc = HYPERVISOR_domctl(&domctl);
+	if (rc) {
+		LOG_ERR("Failed to set affinity %x of vcpu %u of domain %u (%d)",
+			cpumask, vcpu, domid, rc);
+	}
+
+	return rc;
+}
+
+int xrun_hyp_set_sched(uint32_t domid, uint32_t weight, uint32_t cap)
+{
+	struct xen_domctl_scheduler_op op = {
+		.sched_id = XEN_SCHEDULER_CREDIT2,
+		.cmd = XEN_DOMCTL_SCHEDOP_putinfo,
+	};
+	int rc;
+
+	op.u.credit2.weight = weight;
+	op.u.credit2.cap = cap;
+	rc = xen_domctl_scheduler_op(domid, &op);
+	if (rc == -EINVAL) {
+		/* Domain is not run by credit2, try credit scheduler */
+		op.sched_id = XEN_SCHEDULER_CREDIT;
+		op.u.credit.weight = weight;
+		op.u.credit.cap = cap;
+		rc = xen_domctl_scheduler_op(domid, &op);
+	}
+
+	if (rc == -EINVAL) {
+		/* Neither of them runs the domain, e.g. null or RTDS */
+		LOG_ERR("Scheduler of domain %u has no weight and cap", domid);
+		return -ENOTSUP;
+	}
+
+	if (rc) {
+		LOG_ERR("Failed to set weight %u cap %u of domain %u (%d)",
+			weight, cap, domid, rc);
+	}
+
+	return rc;
+}
+
+static int read_console_node(uint32_t domid, const char *node,
+			     unsigned long long *value)
+{
+	char path[64];
+	char buf[24];
+	char *end;
+	int rc;
+
+	snprintf(path, sizeof(path), "/local/domain/%u/console/%s", domid,
+		 node);
+
+	rc = xss_read(path, buf, sizeof(buf));
+	if (rc) {
+		LOG_ERR("Failed to read %s (%d)", path, rc);
+		return rc;
+	}
+
+	*value = strtoull(buf, &end, 10);
+	if (end == buf) {
+		LOG_ERR("Invalid %s value: %s", path, buf);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+int xrun_hyp_get_console(uint32_t domid, uint64_t *gfn, uint32_t *port)
+{
+	unsigned long long value;
+	int rc;
+
+	if (!gfn || !port) {
+		return -EINVAL;
+	}
+
+	rc = read_console_node(domid, "ring-ref", &value);
+	if (rc) {
+		return rc;
+	}
+	*gfn = value;
+
+	rc = read_console_node(domid, "port", &value);
+	if (rc) {
+		return rc;
+	}
+	*port = value;
+
+	return 0;
+}
+
+int xrun_hyp_read_node(uint32_t domid, const char *node, char *buf,
+		       size_t size)
+{
+	char path[128];
+	int rc;
+
+	rc = snprintf(path, sizeof(path), "/local/domain/%u/%s", domid, node);
+	if (rc >= sizeof(path)) {
+		return -ENAMETOOLONG;
+	}
+
+	return xss_read(path, buf, size);
+}
+
+int xrun_hyp_get_physinfo(uint64_t *free_kb, uint32_t *nr_cpus)
+{
+	struct xen_sysctl_physinfo info;
+	int rc;
+
+	if (!free_kb || !nr_cpus) {
+		return -EINVAL;
+	}
+
+	rc = xen_sysctl_physinfo(&info);
+	if (rc) {
+		LOG_ERR("Failed to get host physinfo (%d)", rc);
+		return rc;
+	}
+
+	*free_kb = info.free_pages * (XRUN_PAGE_SIZE / 1024);
+	*nr_cpus = info.nr_cpus;
+	return 0;
+}
+
+int xrun_hyp_request_shutdown(uint32_t domid)
+{
+	char path[64];
+	int rc;
+
+	snprintf(path, sizeof(path), "/local/domain/%u/control/shutdown",
+		 domid);
+
+	rc = xss_write(path, "poweroff");
+	if (rc) {
+		LOG_ERR("Failed to write %s (%d)", path, rc);
+	}
+
+	return rc;
+}
+
+int xrun_hyp_get_exit(uint32_t domid, enum xrun_hyp_exit *exit)
+{
+	xen_domctl_getdomaininfo_t info;
+	uint32_t reason;
+	int rc;
+
+	if (!exit) {
+		return -EINVAL;
+	}
+
+	rc = xen_domctl_getdomaininfo(domid, &info);
+	if (rc == -ESRCH) {
+		/* Domain was destroyed behind our back */
+		*exit = XRUN_HYP_EXIT_CRASH;
+		return 0;
+	} else if (rc) {
+		LOG_ERR("Failed to get info of domain %u (%d)", domid, rc);
+		return rc;
+	}
+
+	if (info.flags & XEN_DOMINF_dying) {
+		*exit = XRUN_HYP_EXIT_CRASH;
+		return 0;
+	}
+
+	if (!(info.flags & XEN_DOMINF_shutdown)) {
+		*exit = XRUN_HYP_EXIT_NONE;
+		return 0;
+	}
+
+	reason = (info.flags >> XEN_DOMINF_shutdownshift) &
+		 XEN_DOMINF_shutdownmask;
+	switch (reason) {
+	case SHUTDOWN_poweroff:
+		*exit = XRUN_HYP_EXIT_POWEROFF;
+		break;
+	case SHUTDOWN_reboot:
+		*exit = XRUN_HYP_EXIT_REBOOT;
+		break;
+	case SHUTDOWN_suspend:
+		/* Domain is suspended to be resumed later */
+		*exit = XRUN_HYP_EXIT_NONE;
+		break;
+	default:
+		*exit = XRUN_HYP_EXIT_CRASH;
+		break;
+	}
+
+	return 0;
+}
+
+int xrun_hyp_wait_destroyed(uint32_t domid, uint32_t timeout_ms)
+{
+	xen_domctl_getdomaininfo_t info;
+	int64_t deadline = k_uptime_get() + timeout_ms;
+	int rc;
+
+	for (;;) {
+		rc = xen_domctl_getdomaininfo(domid, &info);
+		/* Older Xen reports the next domain instead of -ESRCH */
+		if (rc == -ESRCH || (!rc && info.domain != domid)) {
+			return 0;
+		} else if (rc) {
+			LOG_ERR("Failed to get info of domain %u (%d)", domid, rc);
+			return rc;
+		}
+
+		if (k_uptime_get() >= deadline) {
+			LOG_ERR("Domain %u is still dying", domid);
+			return -ETIMEDOUT;
+		}
+
+		k_msleep(1);
+	}
+}
+
+int xrun_hyp_bind_dom_exc(void (*cb)(void *priv), void *priv)
+{
+	struct evtchn_bind_virq bind = {
+		.virq = VIRQ_DOM_EXC,
+		.vcpu = 0,
+	};
+	int rc;
+
+	rc = HYPERVISOR_event_channel_op(EVTCHNOP_bind_virq, &bind);
+	if (rc) {
+		LOG_ERR("Failed to bind VIRQ_DOM_EXC (%d)", rc);
+		return rc;
+	}
+
+	rc = bind_event_channel(bind.port, cb, priv);
+	if (rc) {
+		LOG_ERR("Failed to bind handler to port %u (%d)", bind.port, rc);
+		evtchn_close(bind.port);
+	}
+
+	return rc;
+}
@@ -3,74 +3,430 @@
  * Copyright (c) 2024 EPAM Systems
  */
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #include <zephyr/device.h>
 #include <zephyr/fs/fs.h>
+#include <zephyr/init.h>
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
+#include <zephyr/sys/slist.h>
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+#include <zephyr/storage/flash_map.h>
+#include <zephyr/sys/device_mmio.h>
+#endif
+#ifdef CONFIG_XRUN_ARCHIVE_VERIFY
+#include <mbedtls/sha256.h>
+#endif
 
 #include <storage.h>
+#include <xrun_trace.h>
 
 LOG_MODULE_REGISTER(storage);
 
+#define STREAM_CHUNK_MIN KB(4)
+#define STREAM_CHUNK_MAX KB(CONFIG_XRUN_STORAGE_CHUNK_MAX)
+
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+#define FLASH_PATH_PREFIX "flash:"
+
+/* Region of the flash area addressed by the flash path */
+struct flash_file {
+	const struct flash_area *fa;
+	off_t offset;
+	size_t size;
+};
+#endif /* CONFIG_XRUN_STORAGE_FLASH */
+
+struct xrun_stream {
+	struct fs_file_t file;
+	/* Offset of the stream data in the file */
+	off_t base;
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	/* Stream reads from flash area if fa is set */
+	struct flash_file flash;
+#endif
+	/* Current position of the opened file */
+	off_t pos;
+	size_t size;
+	size_t chunk;
+	/* Throughput of the last chunk read in KB/s */
+	uint32_t last_rate;
+	/* Read-ahead buffer, window is valid while stream owns it */
+	struct chunk_slot *slot;
+	off_t ra_off;
+	size_t ra_len;
+	struct xrun_io_budget *budget;
+	int64_t first_request;
+	struct xrun_stream_stats stats;
+	/* Serializes reads of the stream and protects stats */
+	struct k_mutex lock;
+};
+
+/*
+ * Read-ahead buffers are shared by streams. Stream keeps its buffer until
+ * other stream takes over the least recently used one, so up to
+ * CONFIG_XRUN_STORAGE_CHUNK_BUFS streams read in parallel without
+ * evicting each other's read-ahead. Owner is changed with both slot lock
+ * and chunk_lock held.
+ */
+struct chunk_slot {
+	struct k_mutex lock;
+	struct xrun_stream *owner;
+	uint32_t last_used;
+	uint8_t *buf;
+};
+
+#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+static uint8_t chunk_bufs[CONFIG_XRUN_STORAGE_CHUNK_BUFS][STREAM_CHUNK_MAX]
+			 __aligned(CONFIG_SDHC_BUFFER_ALIGNMENT) __nocache;
+#else
+static uint8_t chunk_bufs[CONFIG_XRUN_STORAGE_CHUNK_BUFS][STREAM_CHUNK_MAX]
+			 __aligned(8);
+#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+static struct chunk_slot chunk_slots[CONFIG_XRUN_STORAGE_CHUNK_BUFS];
+static uint32_t chunk_tick;
+static K_MUTEX_DEFINE(chunk_lock);
+
 #if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
 
 static uint8_t debounce_buf[KB(CONFIG_XRUN_STORAGE_DMA_DEBOUNCE)]
 			    __aligned(CONFIG_SDHC_BUFFER_ALIGNMENT) __nocache;
 static K_MUTEX_DEFINE(debounce_lock);
 
-static ssize_t xrun_file_read_debounce(struct fs_file_t *file, uint8_t *buf, size_t read_size)
+static ssize_t file_read_bounce(struct fs_file_t *file, uint8_t *buf,
+				size_t read_size, uint8_t *bounce,
+				size_t bounce_size)
 {
 	ssize_t read;
 	size_t count;
 	ssize_t ret = 0;
 
-	k_mutex_lock(&debounce_lock, K_FOREVER);
-
 	count = read_size;
 
 	while (count) {
-		read = MIN(count, sizeof(debounce_buf));
+		read = MIN(count, bounce_size);
 
-		read = fs_read(file, debounce_buf, read);
+		read = fs_read(file, bounce, read);
 		if (read < 0) {
 			LOG_ERR("read failed (%zd)", read);
 			ret = read;
 			break;
 		}
 
-		memcpy(buf, debounce_buf, read);
+		memcpy(buf, bounce, read);
 		LOG_DBG("file count %zd read %zd", count, read);
 		count -= read;
 		buf += read;
-		if (count && read < sizeof(debounce_buf)) {
+		if (count && read < bounce_size) {
 			ret = read_size - count;
 			break;
 		}
 	}
 
-	k_mutex_unlock(&debounce_lock);
 	return count ? ret : read_size;
 }
+
+static ssize_t xrun_file_read_debounce(struct fs_file_t *file, uint8_t *buf,
+				       size_t read_size)
+{
+	ssize_t ret;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_DEBOUNCE,
+			k_mutex_lock(&debounce_lock, K_FOREVER));
+	xrun_trace(XRUN_TRACE_DEBOUNCE_READ_BEGIN, read_size);
+	ret = file_read_bounce(file, buf, read_size, debounce_buf,
+			       sizeof(debounce_buf));
+	xrun_trace(XRUN_TRACE_DEBOUNCE_READ_END, read_size);
+	k_mutex_unlock(&debounce_lock);
+
+	return ret;
+}
+
+static ssize_t xrun_file_write_debounce(struct fs_file_t *file,
+					const uint8_t *buf, size_t write_size)
+{
+	ssize_t written;
+	size_t count;
+	ssize_t ret = 0;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_DEBOUNCE,
+			k_mutex_lock(&debounce_lock, K_FOREVER));
+
+	count = write_size;
+
+	while (count) {
+		written = MIN(count, sizeof(debounce_buf));
+
+		memcpy(debounce_buf, buf, written);
+		written = fs_write(file, debounce_buf, written);
+		if (written < 0) {
+			LOG_ERR("write failed (%zd)", written);
+			ret = written;
+			break;
+		}
+
+		LOG_DBG("file count %zd written %zd", count, written);
+		count -= written;
+		buf += written;
+		if (count && written == 0) {
+			ret = write_size - count;
+			break;
+		}
+	}
+
+	k_mutex_unlock(&debounce_lock);
+	return count ? ret : write_size;
+}
 #endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
 
-ssize_t xrun_read_file(const char *fpath, char *buf,
-		       size_t size, int skip)
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+static bool is_flash_path(const char *fpath)
 {
-	struct fs_file_t file;
-	ssize_t rc;
-	int ret;
+	return strncmp(fpath, FLASH_PATH_PREFIX,
+		       sizeof(FLASH_PATH_PREFIX) - 1) == 0;
+}
 
-	if (!buf || size == 0) {
-		LOG_ERR("FAIL: Invalid input parameters");
+/*
+ * Flash path has "flash:<area id>[:<offset>[:<size>]]" format. Region
+ * spans till the end of the flash area if size is not provided.
+ */
+static int flash_file_open(const char *fpath, struct flash_file *file)
+{
+	const char *start = fpath + sizeof(FLASH_PATH_PREFIX) - 1;
+	unsigned long id, offset = 0, size = 0;
+	char *end;
+	int rc;
+
+	id = strtoul(start, &end, 0);
+	if (end == start) {
+		goto err_path;
+	}
+
+	if (*end == ':') {
+		offset = strtoul(end + 1, &end, 0);
+		if (*end == ':') {
+			size = strtoul(end + 1, &end, 0);
+		}
+	}
+
+	if (*end) {
+		goto err_path;
+	}
+
+	rc = flash_area_open(id, &file->fa);
+	if (rc < 0) {
+		LOG_ERR("FAIL: open flash area %lu: %d", id, rc);
+		return rc;
+	}
+
+	if (!size && offset < file->fa->fa_size) {
+		size = file->fa->fa_size - offset;
+	}
+
+	if (!size || offset + size > file->fa->fa_size) {
+		LOG_ERR("FAIL: %s is out of flash area", fpath);
+		flash_area_close(file->fa);
 		return -EINVAL;
 	}
 
-	if (!fpath || strlen(fpath) == 0) {
-		LOG_ERR("FAIL: Invalid file path");
+	file->offset = offset;
+	file->size = size;
+	return 0;
+
+err_path:
+	LOG_ERR("FAIL: Invalid flash path %s", fpath);
+	return -EINVAL;
+}
+
+static void flash_file_close(struct flash_file *file)
+{
+	flash_area_close(file->fa);
+	file->fa = NULL;
+}
+
+#if CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE > 0
+static mm_reg_t flash_mmap;
+static K_MUTEX_DEFINE(flash_mmap_lock);
+
+/* Maps size bytes at offset of the flash file, all of them should be mapped */
+static int flash_file_mmap(struct flash_file *file, uint64_t offset,
+			   size_t size, const uint8_t **addr)
+{
+	uint64_t start = file->fa->fa_off + file->offset + offset;
+
+	if (start > CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE ||
+	    size > CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE - start) {
+		LOG_ERR("FAIL: flash read at %llu is out of mapped window",
+			start);
 		return -EINVAL;
 	}
 
+	k_mutex_lock(&flash_mmap_lock, K_FOREVER);
+	if (!flash_mmap) {
+		device_map(&flash_mmap, CONFIG_XRUN_STORAGE_FLASH_MMAP_BASE,
+			   CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE, K_MEM_CACHE_WB);
+	}
+	k_mutex_unlock(&flash_mmap_lock);
+
+	if (!flash_mmap) {
+		LOG_ERR("FAIL: map flash at %#x",
+			CONFIG_XRUN_STORAGE_FLASH_MMAP_BASE);
+		return -EFAULT;
+	}
+
+	*addr = (const uint8_t *)flash_mmap + start;
+	return 0;
+}
+#elif CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+/* Flash driver may use DMA, so it reads through the debounce buffer */
+static int flash_area_read_debounce(const struct flash_area *fa, off_t off,
+				    uint8_t *buf, size_t size)
+{
+	size_t done, count;
+	int rc = 0;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_DEBOUNCE,
+			k_mutex_lock(&debounce_lock, K_FOREVER));
+	xrun_trace(XRUN_TRACE_DEBOUNCE_READ_BEGIN, size);
+
+	for (done = 0; done < size; done += count) {
+		count = MIN(size - done, sizeof(debounce_buf));
+
+		rc = flash_area_read(fa, off + done, debounce_buf, count);
+		if (rc < 0) {
+			break;
+		}
+
+		memcpy(buf + done, debounce_buf, count);
+	}
+
+	xrun_trace(XRUN_TRACE_DEBOUNCE_READ_END, size);
+	k_mutex_unlock(&debounce_lock);
+	return rc;
+}
+#endif /* CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE */
+
+static ssize_t flash_file_read(struct flash_file *file, uint8_t *buf,
+			       size_t size, uint64_t offset)
+{
+#if CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE > 0
+	const uint8_t *addr;
+#endif
+	int rc;
+
+	if (offset >= file->size) {
+		return 0;
+	}
+
+	size = MIN(size, file->size - offset);
+
+#if CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE > 0
+	/* Flash is mapped to the address space, copy it straight away */
+	rc = flash_file_mmap(file, offset, size, &addr);
+	if (!rc) {
+		memcpy(buf, addr, size);
+	}
+#elif CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+	rc = flash_area_read_debounce(file->fa, file->offset + offset, buf,
+				      size);
+#else
+	rc = flash_area_read(file->fa, file->offset + offset, buf, size);
+#endif /* CONFIG_XRUN_STORAGE_FLASH_MMAP_SIZE */
+	if (rc < 0) {
+		LOG_ERR("FAIL: flash read at %llu: %d", offset, rc);
+		return rc;
+	}
+
+	return size;
+}
+
+static ssize_t flash_read_file(const char *fpath, char *buf, size_t size,
+			       int skip)
+{
+	struct flash_file file;
+	ssize_t rc;
+
+	rc = flash_file_open(fpath, &file);
+	if (rc < 0) {
+		return rc;
+	}
+
+	rc = flash_file_read(&file, buf, size, skip);
+	flash_file_close(&file);
+
+	return rc;
+}
+
+static ssize_t flash_get_file_size(const char *fpath)
+{
+	struct flash_file file;
+	int rc;
+
+	rc = flash_file_open(fpath, &file);
+	if (rc < 0) {
+		return rc;
+	}
+
+	flash_file_close(&file);
+	return file.size;
+}
+#endif /* CONFIG_XRUN_STORAGE_FLASH */
+
+/*
+ * Reads through the bounce buffer of the caller, which should be of
+ * CONFIG_XRUN_STORAGE_DMA_DEBOUNCE size, or through the shared debounce
+ * buffer if bounce is NULL.
+ */
+static ssize_t file_read(struct fs_file_t *file, char *buf, size_t size,
+			 uint8_t *bounce)
+{
+#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+	ssize_t rc;
+
+	if (!bounce) {
+		return xrun_file_read_debounce(file, buf, size);
+	}
+
+	xrun_trace(XRUN_TRACE_DEBOUNCE_READ_BEGIN, size);
+	rc = file_read_bounce(file, buf, size, bounce,
+			      KB(CONFIG_XRUN_STORAGE_DMA_DEBOUNCE));
+	xrun_trace(XRUN_TRACE_DEBOUNCE_READ_END, size);
+
+	return rc;
+#else
+	return fs_read(file, buf, size);
+#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+}
+
+static ssize_t file_stat_size(const char *fpath)
+{
+	int rc;
+	struct fs_dirent dirent;
+
+	rc = fs_stat(fpath, &dirent);
+	if (rc < 0) {
+		LOG_ERR("FAIL: stat %s: %d", fpath, rc);
+		return rc;
+	}
+
+	/* Check if it's a file */
+	if (dirent.type != FS_DIR_ENTRY_FILE) {
+		LOG_ERR("File: %s not found", fpath);
+		return -ENOENT;
+	}
+
+	return dirent.size;
+}
+
+static ssize_t file_read_once(const char *fpath, char *buf, size_t size,
+			      int skip, uint8_t *bounce)
+{
+	struct fs_file_t file;
+	ssize_t rc;
+	int ret;
+
 	fs_file_t_init(&file);
 	rc = fs_open(&file, fpath, FS_O_READ);
 	if (rc < 0) {
@@ -86,11 +442,7 @@ ssize_t xrun_read_file(const char *fpath, char *buf,
 		}
 	}
 
-#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
-	rc = xrun_file_read_debounce(&file, buf, size);
-#else
-	rc = fs_read(&file, buf, size);
-#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+	rc = file_read(&file, buf, size, bounce);
 	if (rc < 0) {
 		LOG_ERR("FAIL: read %s: [rc:%ld]", fpath, rc);
 		goto out;
@@ -106,27 +458,1350 @@ ssize_t xrun_read_file(const char *fpath, char *buf,
 	return rc;
 }
 
-ssize_t xrun_get_file_size(const char *fpath)
+#if CONFIG_XRUN_STORAGE_FILE_CACHE > 0
+struct file_cache_entry {
+	char fpath[CONFIG_XRUN_MAX_PATH_SIZE];
+	bool used;
+	/* Cached handle, valid if opened is set */
+	struct fs_file_t file;
+	bool opened;
+	off_t pos;
+	/* Handle is being read without file_cache_lock held */
+	bool busy;
+	/* Entry was invalidated while busy and is dropped after the read */
+	bool stale;
+	/* Cached stat result, valid if not negative */
+	ssize_t size;
+	uint32_t last_used;
+};
+
+static struct file_cache_entry file_cache[CONFIG_XRUN_STORAGE_FILE_CACHE];
+static struct xrun_storage_cache_stats file_cache_stats;
+static uint32_t file_cache_tick;
+static K_MUTEX_DEFINE(file_cache_lock);
+
+static void file_cache_drop(struct file_cache_entry *entry)
 {
 	int rc;
-	struct fs_dirent dirent;
 
-	if (!fpath || strlen(fpath) == 0) {
-		LOG_ERR("FAIL: Invalid file path");
-		return -EINVAL;
+	if (entry->opened) {
+		rc = fs_close(&entry->file);
+		if (rc < 0) {
+			LOG_ERR("FAIL: close %s: %d", entry->fpath, rc);
+		}
+	}
+
+	entry->opened = false;
+	entry->used = false;
+	entry->stale = false;
+}
+
+/*
+ * Find entry for the path or reuse the least recently used one which
+ * isn't busy. Returns NULL if all entries are busy.
+ */
+static struct file_cache_entry *file_cache_get(const char *fpath)
+{
+	struct file_cache_entry *lru = NULL;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(file_cache); i++) {
+		if (file_cache[i].used && !file_cache[i].stale &&
+		    !strncmp(file_cache[i].fpath, fpath, CONFIG_XRUN_MAX_PATH_SIZE)) {
+			file_cache[i].last_used = ++file_cache_tick;
+			return &file_cache[i];
+		}
+
+		if (file_cache[i].busy) {
+			continue;
+		}
+
+		if (!lru || (lru->used && (!file_cache[i].used ||
+		    file_cache[i].last_used < lru->last_used))) {
+			lru = &file_cache[i];
+		}
+	}
+
+	if (!lru) {
+		return NULL;
+	}
+
+	if (lru->used) {
+		file_cache_stats.evictions++;
+		file_cache_drop(lru);
+	}
+
+	strncpy(lru->fpath, fpath, CONFIG_XRUN_MAX_PATH_SIZE - 1);
+	lru->fpath[CONFIG_XRUN_MAX_PATH_SIZE - 1] = '\0';
+	lru->used = true;
+	lru->opened = false;
+	lru->size = -ENOENT;
+	lru->last_used = ++file_cache_tick;
+
+	return lru;
+}
+
+/*
+ * Cached handle is owned by one reader at a time, so reads of different
+ * files don't wait for each other. Concurrent readers of the same file
+ * use their own handles.
+ */
+static ssize_t file_cache_read(const char *fpath, char *buf, size_t size,
+			       int skip, uint8_t *bounce)
+{
+	struct file_cache_entry *entry;
+	ssize_t rc;
+
+	k_mutex_lock(&file_cache_lock, K_FOREVER);
+
+	entry = file_cache_get(fpath);
+	if (!entry || entry->busy) {
+		file_cache_stats.misses++;
+		k_mutex_unlock(&file_cache_lock);
+		return file_read_once(fpath, buf, size, skip, bounce);
+	}
+
+	if (entry->opened) {
+		file_cache_stats.hits++;
+	} else {
+		file_cache_stats.misses++;
+		fs_file_t_init(&entry->file);
+		rc = fs_open(&entry->file, fpath, FS_O_READ);
+		if (rc < 0) {
+			LOG_ERR("FAIL: open %s: %ld", fpath, rc);
+			entry->used = false;
+			k_mutex_unlock(&file_cache_lock);
+			return rc;
+		}
+		entry->opened = true;
+		entry->pos = 0;
+	}
+
+	entry->busy = true;
+	k_mutex_unlock(&file_cache_lock);
+
+	rc = 0;
+	if (entry->pos != skip) {
+		rc = fs_seek(&entry->file, skip, FS_SEEK_SET);
+		if (rc < 0) {
+			LOG_ERR("FAIL: seek %s: %ld", fpath, rc);
+		} else {
+			entry->pos = skip;
+		}
+	}
+
+	if (rc >= 0) {
+		rc = file_read(&entry->file, buf, size, bounce);
+		if (rc < 0) {
+			LOG_ERR("FAIL: read %s: [rc:%ld]", fpath, rc);
+		} else {
+			entry->pos += rc;
+		}
+	}
+
+	k_mutex_lock(&file_cache_lock, K_FOREVER);
+	entry->busy = false;
+	if (rc < 0 || entry->stale) {
+		file_cache_drop(entry);
+	}
+	k_mutex_unlock(&file_cache_lock);
+
+	return rc;
+}
+
+static ssize_t file_cache_size(const char *fpath)
+{
+	struct file_cache_entry *entry;
+	ssize_t rc;
+
+	k_mutex_lock(&file_cache_lock, K_FOREVER);
+
+	entry = file_cache_get(fpath);
+	if (entry && entry->size >= 0) {
+		file_cache_stats.hits++;
+		rc = entry->size;
+		goto out;
+	}
+
+	file_cache_stats.misses++;
+	rc = file_stat_size(fpath);
+	if (!entry) {
+		goto out;
 	}
 
-	rc = fs_stat(fpath, &dirent);
 	if (rc < 0) {
-		LOG_ERR("FAIL: stat %s: %d", fpath, rc);
-		return rc;
+		/* Don't keep entries for missing files */
+		if (!entry->opened) {
+			entry->used = false;
+		}
+		goto out;
 	}
 
-	/* Check if it's a file */
-	if (dirent.type != FS_DIR_ENTRY_FILE) {
-		LOG_ERR("File: %s not found", fpath);
-		return -ENOENT;
+	entry->size = rc;
+out:
+	k_mutex_unlock(&file_cache_lock);
+	return rc;
+}
+
+void xrun_storage_invalidate(const char *fpath)
+{
+	int i;
+
+	k_mutex_lock(&file_cache_lock, K_FOREVER);
+
+	for (i = 0; i < ARRAY_SIZE(file_cache); i++) {
+		if (!file_cache[i].used ||
+		    (fpath && strncmp(file_cache[i].fpath, fpath,
+				      CONFIG_XRUN_MAX_PATH_SIZE))) {
+			continue;
+		}
+
+		/* Handle in use is closed by its reader */
+		if (file_cache[i].busy) {
+			file_cache[i].stale = true;
+		} else {
+			file_cache_drop(&file_cache[i]);
+		}
 	}
 
-	return dirent.size;
+	k_mutex_unlock(&file_cache_lock);
+}
+
+void xrun_storage_get_cache_stats(struct xrun_storage_cache_stats *stats)
+{
+	if (!stats) {
+		return;
+	}
+
+	k_mutex_lock(&file_cache_lock, K_FOREVER);
+	*stats = file_cache_stats;
+	k_mutex_unlock(&file_cache_lock);
+}
+#else
+void xrun_storage_invalidate(const char *fpath)
+{
+}
+
+void xrun_storage_get_cache_stats(struct xrun_storage_cache_stats *stats)
+{
+	if (stats) {
+		memset(stats, 0, sizeof(*stats));
+	}
+}
+#endif /* CONFIG_XRUN_STORAGE_FILE_CACHE */
+
+/* Reads flash or file through the handle cache, see file_read for bounce */
+static ssize_t read_path(const char *fpath, char *buf, size_t size, int skip,
+			 uint8_t *bounce)
+{
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	if (is_flash_path(fpath)) {
+		return flash_read_file(fpath, buf, size, skip);
+	}
+#endif
+
+#if CONFIG_XRUN_STORAGE_FILE_CACHE > 0
+	return file_cache_read(fpath, buf, size, skip, bounce);
+#else
+	return file_read_once(fpath, buf, size, skip, bounce);
+#endif
+}
+
+static uint64_t io_budget_charge(struct xrun_io_budget *budget, size_t size);
+
+ssize_t xrun_read_file(const char *fpath, char *buf,
+		       size_t size, int skip)
+{
+	ssize_t rc;
+
+	if (!buf || size == 0) {
+		LOG_ERR("FAIL: Invalid input parameters");
+		return -EINVAL;
+	}
+
+	if (!fpath || strlen(fpath) == 0) {
+		LOG_ERR("FAIL: Invalid file path");
+		return -EINVAL;
+	}
+
+	rc = read_path(fpath, buf, size, skip, NULL);
+	if (rc > 0) {
+		io_budget_charge(NULL, rc);
+	}
+
+	return rc;
+}
+
+ssize_t xrun_get_file_size(const char *fpath)
+{
+	if (!fpath || strlen(fpath) == 0) {
+		LOG_ERR("FAIL: Invalid file path");
+		return -EINVAL;
+	}
+
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	if (is_flash_path(fpath)) {
+		return flash_get_file_size(fpath);
+	}
+#endif
+
+#if CONFIG_XRUN_STORAGE_FILE_CACHE > 0
+	return file_cache_size(fpath);
+#else
+	return file_stat_size(fpath);
+#endif
+}
+
+static struct xrun_io_budget io_budget = {
+	.rate = KB(CONFIG_XRUN_IO_RATE_LIMIT),
+	.burst = KB(CONFIG_XRUN_IO_BURST),
+	.tokens = KB(CONFIG_XRUN_IO_BURST),
+};
+
+void xrun_io_budget_init(struct xrun_io_budget *budget, uint32_t rate,
+			 uint32_t burst)
+{
+	k_spinlock_key_t key;
+
+	if (!budget) {
+		return;
+	}
+
+	key = k_spin_lock(&budget->lock);
+	budget->rate = rate;
+	budget->burst = burst;
+	budget->tokens = burst;
+	budget->last_refill = k_uptime_ticks();
+	memset(&budget->stats, 0, sizeof(budget->stats));
+	k_spin_unlock(&budget->lock, key);
+}
+
+void xrun_io_budget_charge(struct xrun_io_budget *budget, size_t size)
+{
+	k_spinlock_key_t key;
+	int64_t now, wait_us = 0;
+
+	if (!budget) {
+		return;
+	}
+
+	key = k_spin_lock(&budget->lock);
+	budget->stats.bytes += size;
+	if (!budget->rate) {
+		k_spin_unlock(&budget->lock, key);
+		return;
+	}
+
+	now = k_uptime_ticks();
+	budget->tokens += ((now - budget->last_refill) * budget->rate) /
+			  CONFIG_SYS_CLOCK_TICKS_PER_SEC;
+	budget->tokens = MIN(budget->tokens, (int64_t)budget->burst);
+	budget->last_refill = now;
+
+	budget->tokens -= size;
+	if (budget->tokens < 0) {
+		wait_us = (-budget->tokens * USEC_PER_SEC) / budget->rate;
+		budget->stats.throttled_us += wait_us;
+	}
+	k_spin_unlock(&budget->lock, key);
+
+	if (wait_us) {
+		LOG_DBG("throttle %zu bytes for %lld us", size, wait_us);
+		k_sleep(K_USEC(wait_us));
+	}
+}
+
+void xrun_io_budget_get_stats(struct xrun_io_budget *budget,
+			      struct xrun_io_budget_stats *stats)
+{
+	k_spinlock_key_t key;
+
+	if (!stats) {
+		return;
+	}
+
+	if (!budget) {
+		budget = &io_budget;
+	}
+
+	key = k_spin_lock(&budget->lock);
+	*stats = budget->stats;
+	k_spin_unlock(&budget->lock, key);
+}
+
+void xrun_storage_set_io_rate(uint32_t rate, uint32_t burst)
+{
+	k_spinlock_key_t key = k_spin_lock(&io_budget.lock);
+
+	io_budget.rate = rate;
+	io_budget.burst = burst;
+	io_budget.tokens = MIN(io_budget.tokens, (int64_t)burst);
+	k_spin_unlock(&io_budget.lock, key);
+}
+
+/* Returns time spent waiting for the budgets in us */
+static uint64_t io_budget_charge(struct xrun_io_budget *budget, size_t size)
+{
+	int64_t start = k_uptime_ticks();
+
+	xrun_io_budget_charge(budget, size);
+	xrun_io_budget_charge(&io_budget, size);
+
+	return k_ticks_to_us_floor64(k_uptime_ticks() - start);
+}
+
+static int stream_seek(struct xrun_stream *stream, off_t offset)
+{
+	int rc;
+
+	if (stream->pos == offset) {
+		return 0;
+	}
+
+	rc = fs_seek(&stream->file, offset, FS_SEEK_SET);
+	if (rc < 0) {
+		LOG_ERR("FAIL: stream seek to %ld: %d", (long)offset, rc);
+		return rc;
+	}
+
+	stream->pos = offset;
+	return 0;
+}
+
+static void stream_adapt_chunk(struct xrun_stream *stream, size_t read,
+			       uint32_t time_us)
+{
+	uint32_t rate = (uint32_t)(((uint64_t)read * USEC_PER_SEC) /
+				   (MAX(time_us, 1) * 1024ULL));
+	size_t chunk = stream->chunk;
+
+	/*
+	 * Bigger chunks amortize per request storage overhead, so keep
+	 * growing the chunk until throughput stops improving and step back
+	 * when it drops noticeably.
+	 */
+	if (rate >= stream->last_rate) {
+		if (chunk * 2 <= STREAM_CHUNK_MAX) {
+			chunk *= 2;
+		}
+	} else if (rate < stream->last_rate - stream->last_rate / 4) {
+		if (chunk / 2 >= STREAM_CHUNK_MIN) {
+			chunk /= 2;
+		}
+	}
+
+	if (chunk != stream->chunk) {
+		LOG_DBG("stream chunk %zu -> %zu (%u KB/s)", stream->chunk,
+			chunk, rate);
+		stream->chunk = chunk;
+	}
+
+	stream->last_rate = rate;
+}
+
+static ssize_t stream_read_timed(struct xrun_stream *stream, uint8_t *buf,
+				 size_t size, off_t offset, uint32_t *time_us)
+{
+	uint32_t start;
+	ssize_t rc;
+
+	rc = stream_seek(stream, offset);
+	if (rc < 0) {
+		return rc;
+	}
+
+	start = k_cycle_get_32();
+#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+	/*
+	 * Read-ahead buffers are DMA capable. External buffers are guest
+	 * memory mapped to Dom0, their machine address is unknown, so they
+	 * are bounced.
+	 */
+	if (stream->slot && buf == stream->slot->buf) {
+		rc = fs_read(&stream->file, buf, size);
+	} else {
+		rc = xrun_file_read_debounce(&stream->file, buf, size);
+	}
+#else
+	rc = fs_read(&stream->file, buf, size);
+#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+	*time_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+	if (rc < 0) {
+		LOG_ERR("FAIL: stream read at %ld: %zd", (long)offset, rc);
+		/* File position is unknown after failed read */
+		stream->pos = -1;
+		return rc;
+	}
+
+	stream->pos += rc;
+	stream->stats.reads++;
+	stream->stats.io_time_us += *time_us;
+
+	return rc;
+}
+
+static int chunk_slots_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(chunk_slots); i++) {
+		k_mutex_init(&chunk_slots[i].lock);
+		chunk_slots[i].buf = chunk_bufs[i];
+	}
+
+	return 0;
+}
+
+SYS_INIT(chunk_slots_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+/*
+ * Locks the read-ahead buffer owned by the stream. Returns false if the
+ * stream has no buffer or it was taken over by other stream.
+ */
+static bool chunk_slot_lock_owned(struct xrun_stream *stream)
+{
+	struct chunk_slot *slot = stream->slot;
+
+	if (!slot) {
+		return false;
+	}
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CHUNK,
+			k_mutex_lock(&slot->lock, K_FOREVER));
+	if (slot->owner != stream) {
+		k_mutex_unlock(&slot->lock);
+		stream->slot = NULL;
+		stream->ra_len = 0;
+		return false;
+	}
+
+	k_mutex_lock(&chunk_lock, K_FOREVER);
+	slot->last_used = ++chunk_tick;
+	k_mutex_unlock(&chunk_lock);
+	return true;
+}
+
+/* Takes over the free or the least recently used read-ahead buffer */
+static void chunk_slot_take(struct xrun_stream *stream)
+{
+	struct chunk_slot *slot = NULL;
+	int i;
+
+	k_mutex_lock(&chunk_lock, K_FOREVER);
+	for (i = 0; i < ARRAY_SIZE(chunk_slots); i++) {
+		if (!slot || (slot->owner && (!chunk_slots[i].owner ||
+		    chunk_slots[i].last_used < slot->last_used))) {
+			slot = &chunk_slots[i];
+		}
+	}
+	k_mutex_unlock(&chunk_lock);
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CHUNK,
+			k_mutex_lock(&slot->lock, K_FOREVER));
+	k_mutex_lock(&chunk_lock, K_FOREVER);
+	slot->owner = stream;
+	slot->last_used = ++chunk_tick;
+	k_mutex_unlock(&chunk_lock);
+
+	stream->slot = slot;
+	stream->ra_len = 0;
+}
+
+static void chunk_slot_release(struct xrun_stream *stream)
+{
+	struct chunk_slot *slot = stream->slot;
+
+	if (!slot) {
+		return;
+	}
+
+	k_mutex_lock(&slot->lock, K_FOREVER);
+	k_mutex_lock(&chunk_lock, K_FOREVER);
+	if (slot->owner == stream) {
+		slot->owner = NULL;
+	}
+	k_mutex_unlock(&chunk_lock);
+	k_mutex_unlock(&slot->lock);
+
+	stream->slot = NULL;
+}
+
+/* Should be called with the stream read-ahead buffer locked */
+static ssize_t stream_fill_chunk(struct xrun_stream *stream, off_t offset)
+{
+	uint32_t time_us;
+	ssize_t rc;
+
+	stream->ra_len = 0;
+	rc = stream_read_timed(stream, stream->slot->buf, stream->chunk,
+			       offset, &time_us);
+	if (rc < 0) {
+		return rc;
+	}
+
+	/* Short read means end of file and gives no throughput estimation */
+	if ((size_t)rc == stream->chunk) {
+		stream_adapt_chunk(stream, rc, time_us);
+	}
+
+	stream->ra_off = offset;
+	stream->ra_len = rc;
+
+	return rc;
+}
+
+/* Should be called with stream lock held */
+static void stream_account(struct xrun_stream *stream, uint64_t throttled_us)
+{
+	int64_t now = k_uptime_ticks();
+
+	if (!stream->stats.requests) {
+		stream->first_request = now;
+	}
+
+	stream->stats.requests++;
+	stream->stats.throttled_us += throttled_us;
+	stream->stats.active_us = k_ticks_to_us_floor64(now -
+							stream->first_request);
+}
+
+/* Size of the opened file, so it doesn't depend on the cached stat */
+static ssize_t file_handle_size(struct fs_file_t *file)
+{
+	off_t size;
+	int rc;
+
+	rc = fs_seek(file, 0, FS_SEEK_END);
+	if (rc < 0) {
+		return rc;
+	}
+
+	size = fs_tell(file);
+	if (size < 0) {
+		return size;
+	}
+
+	rc = fs_seek(file, 0, FS_SEEK_SET);
+	return (rc < 0) ? rc : size;
+}
+
+int xrun_stream_open(const char *fpath, struct xrun_stream **stream)
+{
+	struct xrun_stream *new_stream;
+	ssize_t size;
+	int rc;
+
+	if (!stream || !fpath || strlen(fpath) == 0) {
+		return -EINVAL;
+	}
+
+	new_stream = k_malloc(sizeof(*new_stream));
+	if (!new_stream) {
+		LOG_ERR("Unable to allocate stream for %s", fpath);
+		return -ENOMEM;
+	}
+
+	memset(new_stream, 0, sizeof(*new_stream));
+	k_mutex_init(&new_stream->lock);
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	if (is_flash_path(fpath)) {
+		rc = flash_file_open(fpath, &new_stream->flash);
+		size = new_stream->flash.size;
+	} else
+#endif
+	{
+		fs_file_t_init(&new_stream->file);
+		rc = fs_open(&new_stream->file, fpath, FS_O_READ);
+		if (!rc) {
+			size = file_handle_size(&new_stream->file);
+			if (size < 0) {
+				fs_close(&new_stream->file);
+				rc = size;
+			}
+		}
+	}
+	if (rc < 0) {
+		LOG_ERR("FAIL: open %s: %d", fpath, rc);
+		k_free(new_stream);
+		return rc;
+	}
+
+	new_stream->size = size;
+	new_stream->chunk = STREAM_CHUNK_MIN;
+	new_stream->stats.chunk_size = new_stream->chunk;
+	*stream = new_stream;
+
+	return 0;
+}
+
+ssize_t xrun_stream_read(struct xrun_stream *stream, uint8_t *buf,
+			 size_t size, uint64_t offset)
+{
+	size_t done = 0, left, count;
+	off_t pos;
+	uint32_t time_us;
+	uint64_t throttled_us;
+	bool owned;
+	ssize_t rc = 0;
+
+	if (!stream || !buf) {
+		return -EINVAL;
+	}
+
+	if (offset >= stream->size) {
+		return 0;
+	}
+
+	size = MIN(size, stream->size - offset);
+	offset += stream->base;
+
+	/*
+	 * Budget is charged for the requested bytes before the read-ahead
+	 * buffer is locked, so throttled stream doesn't block the others.
+	 * Read-ahead only moves reads in time, so the rate is preserved.
+	 */
+	throttled_us = io_budget_charge(stream->budget, size);
+
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	if (stream->flash.fa) {
+		uint32_t start = k_cycle_get_32();
+
+		/* No read-ahead needed, flash is read directly to buffer */
+		rc = flash_file_read(&stream->flash, buf, size, offset);
+		time_us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+		k_mutex_lock(&stream->lock, K_FOREVER);
+		stream_account(stream, throttled_us);
+		if (rc > 0) {
+			stream->stats.reads++;
+			stream->stats.bytes += rc;
+			stream->stats.io_time_us += time_us;
+		}
+		k_mutex_unlock(&stream->lock);
+
+		return rc;
+	}
+#endif /* CONFIG_XRUN_STORAGE_FLASH */
+
+	k_mutex_lock(&stream->lock, K_FOREVER);
+	stream_account(stream, throttled_us);
+	owned = chunk_slot_lock_owned(stream);
+
+	while (done < size) {
+		left = size - done;
+		pos = offset + done;
+
+		if (owned && pos >= stream->ra_off &&
+		    pos < stream->ra_off + stream->ra_len) {
+			count = MIN(left, stream->ra_off + stream->ra_len - pos);
+			memcpy(buf + done,
+			       stream->slot->buf + (pos - stream->ra_off),
+			       count);
+			done += count;
+			continue;
+		}
+
+		if (left >= stream->chunk) {
+			/* Large request, read it directly to the destination */
+			rc = stream_read_timed(stream, buf + done, left, pos,
+					       &time_us);
+			if (rc > 0) {
+				done += rc;
+			}
+		} else {
+			if (!owned) {
+				chunk_slot_take(stream);
+				owned = true;
+			}
+			rc = stream_fill_chunk(stream, pos);
+		}
+
+		/* Stop on error or end of file */
+		if (rc <= 0) {
+			break;
+		}
+	}
+
+	if (owned) {
+		k_mutex_unlock(&stream->slot->lock);
+	}
+
+	stream->stats.bytes += done;
+	stream->stats.chunk_size = stream->chunk;
+	k_mutex_unlock(&stream->lock);
+
+	return (rc < 0) ? rc : done;
+}
+
+ssize_t xrun_stream_size(struct xrun_stream *stream)
+{
+	if (!stream) {
+		return -EINVAL;
+	}
+
+	return stream->size;
+}
+
+void xrun_stream_get_stats(struct xrun_stream *stream,
+			   struct xrun_stream_stats *stats)
+{
+	if (!stream || !stats) {
+		return;
+	}
+
+	k_mutex_lock(&stream->lock, K_FOREVER);
+	*stats = stream->stats;
+	k_mutex_unlock(&stream->lock);
+}
+
+void xrun_stream_set_budget(struct xrun_stream *stream,
+			    struct xrun_io_budget *budget)
+{
+	if (!stream) {
+		return;
+	}
+
+	stream->budget = budget;
+}
+
+int xrun_stream_create(const char *fpath, struct xrun_stream **stream)
+{
+	struct xrun_stream *new_stream;
+	int rc;
+
+	if (!stream || !fpath || strlen(fpath) == 0) {
+		return -EINVAL;
+	}
+
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	if (is_flash_path(fpath)) {
+		LOG_ERR("FAIL: %s is read only", fpath);
+		return -EROFS;
+	}
+#endif
+
+	new_stream = k_malloc(sizeof(*new_stream));
+	if (!new_stream) {
+		LOG_ERR("Unable to allocate stream for %s", fpath);
+		return -ENOMEM;
+	}
+
+	memset(new_stream, 0, sizeof(*new_stream));
+	k_mutex_init(&new_stream->lock);
+	fs_file_t_init(&new_stream->file);
+	rc = fs_open(&new_stream->file, fpath, FS_O_CREATE | FS_O_WRITE);
+	if (rc < 0) {
+		LOG_ERR("FAIL: create %s: %d", fpath, rc);
+		k_free(new_stream);
+		return rc;
+	}
+
+	/* Cached handle and size are stale once the file is rewritten */
+	xrun_storage_invalidate(fpath);
+
+	rc = fs_truncate(&new_stream->file, 0);
+	if (rc < 0) {
+		LOG_ERR("FAIL: truncate %s: %d", fpath, rc);
+		fs_close(&new_stream->file);
+		k_free(new_stream);
+		return rc;
+	}
+
+	*stream = new_stream;
+	return 0;
+}
+
+ssize_t xrun_stream_write(struct xrun_stream *stream, const uint8_t *buf,
+			  size_t size)
+{
+	uint32_t start;
+	ssize_t rc;
+
+	if (!stream || !buf) {
+		return -EINVAL;
+	}
+
+	start = k_cycle_get_32();
+#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+	rc = xrun_file_write_debounce(&stream->file, buf, size);
+#else
+	rc = fs_write(&stream->file, buf, size);
+#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+	if (rc < 0) {
+		LOG_ERR("FAIL: stream write: %zd", rc);
+		return rc;
+	}
+
+	stream->pos += rc;
+	stream->size += rc;
+	stream->stats.requests++;
+	stream->stats.bytes += rc;
+	stream->stats.io_time_us += k_cyc_to_us_floor32(k_cycle_get_32() -
+							  start);
+
+	return ((size_t)rc == size) ? rc : -ENOSPC;
+}
+
+int xrun_stream_close(struct xrun_stream *stream)
+{
+	int rc;
+
+	if (!stream) {
+		return 0;
+	}
+
+	chunk_slot_release(stream);
+
+#ifdef CONFIG_XRUN_STORAGE_FLASH
+	if (stream->flash.fa) {
+		flash_file_close(&stream->flash);
+		k_free(stream);
+		return 0;
+	}
+#endif
+
+	rc = fs_close(&stream->file);
+	if (rc < 0) {
+		LOG_ERR("FAIL: stream close: %d", rc);
+	}
+
+	k_free(stream);
+	return rc;
+}
+
+struct xrun_archive {
+	char fpath[CONFIG_XRUN_MAX_PATH_SIZE];
+	struct xrun_stream *stream;
+	struct xrun_archive_header hdr;
+};
+
+static const struct xrun_archive_entry *archive_lookup(
+	struct xrun_archive *archive, const char *name)
+{
+	int i;
+
+	for (i = 0; i < archive->hdr.nr_entries; i++) {
+		if (strncmp(archive->hdr.entries[i].name, name,
+			    XRUN_ARCHIVE_NAME_MAX) == 0) {
+			return &archive->hdr.entries[i];
+		}
+	}
+
+	LOG_ERR("Entry %s not found in %s", name, archive->fpath);
+	return NULL;
+}
+
+static bool archive_entry_has_digest(const struct xrun_archive_entry *entry)
+{
+	int i;
+
+	for (i = 0; i < XRUN_ARCHIVE_DIGEST_SIZE; i++) {
+		if (entry->digest[i]) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+#ifdef CONFIG_XRUN_ARCHIVE_VERIFY
+/* Reads the whole entry, so it is verified before any of it is used */
+static int archive_check_digest(struct xrun_archive *archive,
+				const struct xrun_archive_entry *entry)
+{
+	uint8_t digest[XRUN_ARCHIVE_DIGEST_SIZE];
+	mbedtls_sha256_context ctx;
+	uint64_t done;
+	uint8_t *buf;
+	ssize_t rc = 0;
+
+	if (!archive_entry_has_digest(entry)) {
+		return 0;
+	}
+
+	buf = k_malloc(STREAM_CHUNK_MIN);
+	if (!buf) {
+		return -ENOMEM;
+	}
+
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	for (done = 0; done < entry->size; done += rc) {
+		rc = xrun_stream_read(archive->stream, buf,
+				      MIN(STREAM_CHUNK_MIN, entry->size - done),
+				      entry->offset + done);
+		if (rc <= 0) {
+			LOG_ERR("FAIL: read entry %s of %s: %zd", entry->name,
+				archive->fpath, rc);
+			rc = rc ? rc : -EIO;
+			break;
+		}
+		mbedtls_sha256_update(&ctx, buf, rc);
+	}
+
+	if (rc >= 0) {
+		mbedtls_sha256_finish(&ctx, digest);
+		if (memcmp(digest, entry->digest, sizeof(digest))) {
+			LOG_ERR("Entry %s of %s is corrupted", entry->name,
+				archive->fpath);
+			rc = -EBADMSG;
+		}
+	}
+
+	mbedtls_sha256_free(&ctx);
+	k_free(buf);
+	return (rc < 0) ? rc : 0;
+}
+#else
+static int archive_check_digest(struct xrun_archive *archive,
+				const struct xrun_archive_entry *entry)
+{
+	if (!archive_entry_has_digest(entry)) {
+		return 0;
+	}
+
+	/* Archive expects verification, don't load it silently */
+	LOG_ERR("Digest of %s in %s can't be verified", entry->name,
+		archive->fpath);
+	return -ENOTSUP;
+}
+#endif /* CONFIG_XRUN_ARCHIVE_VERIFY */
+
+static int archive_validate(struct xrun_archive *archive)
+{
+	const struct xrun_archive_entry *entry;
+	size_t size = xrun_stream_size(archive->stream);
+	int i, rc;
+
+	if (archive->hdr.magic != XRUN_ARCHIVE_MAGIC ||
+	    archive->hdr.version != XRUN_ARCHIVE_VERSION ||
+	    archive->hdr.nr_entries > XRUN_ARCHIVE_ENTRIES_MAX) {
+		LOG_ERR("%s is not a bundle archive", archive->fpath);
+		return -EINVAL;
+	}
+
+	for (i = 0; i < archive->hdr.nr_entries; i++) {
+		entry = &archive->hdr.entries[i];
+		if (entry->name[XRUN_ARCHIVE_NAME_MAX - 1] != '\0' ||
+		    entry->offset % XRUN_ARCHIVE_ALIGN ||
+		    entry->offset > size || entry->size > size - entry->offset) {
+			LOG_ERR("%s has corrupted entry %d", archive->fpath, i);
+			return -EINVAL;
+		}
+
+		rc = archive_check_digest(archive, entry);
+		if (rc < 0) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
+
+int xrun_archive_open(const char *fpath, struct xrun_archive **archive)
+{
+	struct xrun_archive *new_archive;
+	ssize_t rc;
+
+	if (!archive || !fpath || strlen(fpath) >= CONFIG_XRUN_MAX_PATH_SIZE) {
+		return -EINVAL;
+	}
+
+	new_archive = k_malloc(sizeof(*new_archive));
+	if (!new_archive) {
+		LOG_ERR("Unable to allocate archive for %s", fpath);
+		return -ENOMEM;
+	}
+
+	strcpy(new_archive->fpath, fpath);
+	rc = xrun_stream_open(fpath, &new_archive->stream);
+	if (rc < 0) {
+		k_free(new_archive);
+		return rc;
+	}
+
+	rc = xrun_stream_read(new_archive->stream, (uint8_t *)&new_archive->hdr,
+			      sizeof(new_archive->hdr), 0);
+	if (rc != sizeof(new_archive->hdr)) {
+		LOG_ERR("FAIL: read archive header %s: %zd", fpath, rc);
+		rc = (rc < 0) ? rc : -EINVAL;
+		goto err;
+	}
+
+	rc = archive_validate(new_archive);
+	if (rc < 0) {
+		goto err;
+	}
+
+	*archive = new_archive;
+	return 0;
+
+err:
+	xrun_stream_close(new_archive->stream);
+	k_free(new_archive);
+	return rc;
+}
+
+ssize_t xrun_archive_read_file(struct xrun_archive *archive, const char *name,
+			       char *buf, size_t size, int skip)
+{
+	const struct xrun_archive_entry *entry;
+
+	if (!archive || !name || !buf || size == 0 || skip < 0) {
+		return -EINVAL;
+	}
+
+	entry = archive_lookup(archive, name);
+	if (!entry) {
+		return -ENOENT;
+	}
+
+	if (skip >= entry->size) {
+		return 0;
+	}
+
+	return xrun_stream_read(archive->stream, (uint8_t *)buf,
+				MIN(size, entry->size - skip),
+				entry->offset + skip);
+}
+
+ssize_t xrun_archive_get_file_size(struct xrun_archive *archive,
+				   const char *name)
+{
+	const struct xrun_archive_entry *entry;
+
+	if (!archive || !name) {
+		return -EINVAL;
+	}
+
+	entry = archive_lookup(archive, name);
+	if (!entry) {
+		return -ENOENT;
+	}
+
+	return entry->size;
+}
+
+int xrun_archive_stream_open(struct xrun_archive *archive, const char *name,
+			     struct xrun_stream **stream)
+{
+	const struct xrun_archive_entry *entry;
+	int rc;
+
+	if (!archive || !name || !stream) {
+		return -EINVAL;
+	}
+
+	entry = archive_lookup(archive, name);
+	if (!entry) {
+		return -ENOENT;
+	}
+
+	/* Entry stream has its own file handle and read-ahead state */
+	rc = xrun_stream_open(archive->fpath, stream);
+	if (rc < 0) {
+		return rc;
+	}
+
+	(*stream)->base = entry->offset;
+	(*stream)->size = entry->size;
+	return 0;
+}
+
+int xrun_archive_close(struct xrun_archive *archive)
+{
+	int rc;
+
+	if (!archive) {
+		return 0;
+	}
+
+	rc = xrun_stream_close(archive->stream);
+	k_free(archive);
+	return rc;
+}
+
+#if CONFIG_XRUN_IO_THREADS > 0
+static sys_slist_t io_queue = SYS_SLIST_STATIC_INIT(&io_queue);
+static K_MUTEX_DEFINE(io_queue_lock);
+static K_SEM_DEFINE(io_pending, 0, CONFIG_XRUN_IO_QUEUE_DEPTH);
+static K_SEM_DEFINE(io_slots, CONFIG_XRUN_IO_QUEUE_DEPTH,
+		    CONFIG_XRUN_IO_QUEUE_DEPTH);
+
+static struct k_thread io_threads[CONFIG_XRUN_IO_THREADS];
+static K_THREAD_STACK_ARRAY_DEFINE(io_stacks, CONFIG_XRUN_IO_THREADS,
+				   CONFIG_XRUN_IO_STACK_SIZE);
+
+#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+/* Each worker has own bounce buffer, so workers don't share debounce_lock */
+static uint8_t io_bounce[CONFIG_XRUN_IO_THREADS]
+			[KB(CONFIG_XRUN_STORAGE_DMA_DEBOUNCE)]
+			__aligned(CONFIG_SDHC_BUFFER_ALIGNMENT) __nocache;
+#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+
+/*
+ * Requests are ordered by path and by offset within the file. Paths of
+ * the same device share the mount point prefix, so requests to one
+ * device are kept together as well.
+ */
+static bool io_req_before(const struct xrun_io_req *a,
+			  const struct xrun_io_req *b)
+{
+	int cmp = strncmp(a->fpath, b->fpath, CONFIG_XRUN_MAX_PATH_SIZE);
+
+	if (cmp) {
+		return cmp < 0;
+	}
+
+	return a->skip < b->skip;
+}
+
+static void io_queue_insert(struct xrun_io_req *req)
+{
+	struct xrun_io_req *cur, *prev = NULL;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&io_queue, cur, node) {
+		if (io_req_before(req, cur)) {
+			break;
+		}
+		prev = cur;
+	}
+
+	if (prev) {
+		sys_slist_insert(&io_queue, &prev->node, &req->node);
+	} else {
+		sys_slist_prepend(&io_queue, &req->node);
+	}
+}
+
+static ssize_t io_read(struct xrun_io_req *req, int worker)
+{
+#if CONFIG_XRUN_STORAGE_DMA_DEBOUNCE > 0
+	return read_path(req->fpath, req->buf, req->size, req->skip,
+			 io_bounce[worker]);
+#else
+	return read_path(req->fpath, req->buf, req->size, req->skip, NULL);
+#endif /* CONFIG_XRUN_STORAGE_DMA_DEBOUNCE */
+}
+
+static void io_worker(void *p1, void *p2, void *p3)
+{
+	int worker = POINTER_TO_INT(p1);
+	struct xrun_io_req *req;
+
+	for (;;) {
+		k_sem_take(&io_pending, K_FOREVER);
+
+		k_mutex_lock(&io_queue_lock, K_FOREVER);
+		req = SYS_SLIST_PEEK_HEAD_CONTAINER(&io_queue, req, node);
+		sys_slist_remove(&io_queue, NULL, &req->node);
+		k_mutex_unlock(&io_queue_lock);
+
+		k_sem_give(&io_slots);
+
+		req->result = io_read(req, worker);
+		/* Buffer may be bigger than the file, charge what was read */
+		if (req->result > 0) {
+			io_budget_charge(req->budget, req->result);
+		}
+		if (req->cb) {
+			req->cb(req, req->result);
+		}
+		k_sem_give(&req->done);
+	}
+}
+
+static int io_sched_init(void)
+{
+	int i;
+
+	for (i = 0; i < CONFIG_XRUN_IO_THREADS; i++) {
+		k_thread_create(&io_threads[i], io_stacks[i],
+				K_THREAD_STACK_SIZEOF(io_stacks[i]), io_worker,
+				INT_TO_POINTER(i), NULL, NULL,
+				K_PRIO_PREEMPT(CONFIG_XRUN_IO_THREAD_PRIO), 0,
+				K_NO_WAIT);
+		k_thread_name_set(&io_threads[i], "xrun_io");
+	}
+
+	return 0;
+}
+
+SYS_INIT(io_sched_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+int xrun_io_submit(struct xrun_io_req *reqs, size_t count)
+{
+	size_t i;
+
+	if (!reqs) {
+		return -EINVAL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!reqs[i].fpath || !reqs[i].buf || !reqs[i].size ||
+		    reqs[i].skip < 0) {
+			return -EINVAL;
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		k_sem_init(&reqs[i].done, 0, 1);
+		reqs[i].result = -EINPROGRESS;
+
+		/* Wait for free slot if queue depth is exhausted */
+		k_sem_take(&io_slots, K_FOREVER);
+
+		k_mutex_lock(&io_queue_lock, K_FOREVER);
+		io_queue_insert(&reqs[i]);
+		k_mutex_unlock(&io_queue_lock);
+
+		k_sem_give(&io_pending);
+	}
+
+	return 0;
+}
+#else
+int xrun_io_submit(struct xrun_io_req *reqs, size_t count)
+{
+	size_t i;
+
+	if (!reqs) {
+		return -EINVAL;
+	}
+
+	/* No workers, complete requests in the caller context */
+	for (i = 0; i < count; i++) {
+		k_sem_init(&reqs[i].done, 0, 1);
+		reqs[i].result = xrun_read_file(reqs[i].fpath, reqs[i].buf,
+						reqs[i].size, reqs[i].skip);
+		/* Global budget is charged by xrun_read_file() */
+		if (reqs[i].result > 0) {
+			xrun_io_budget_charge(reqs[i].budget, reqs[i].result);
+		}
+		if (reqs[i].cb) {
+			reqs[i].cb(&reqs[i], reqs[i].result);
+		}
+		k_sem_give(&reqs[i].done);
+	}
+
+	return 0;
+}
+#endif /* CONFIG_XRUN_IO_THREADS */
+
+ssize_t xrun_io_wait(struct xrun_io_req *req, k_timeout_t timeout)
+{
+	int rc;
+
+	if (!req) {
+		return -EINVAL;
+	}
+
+	rc = k_sem_take(&req->done, timeout);
+	if (rc) {
+		return rc;
+	}
+
+	/* Keep request completed for the subsequent waits */
+	k_sem_give(&req->done);
+	return req->result;
 }
@@ -18,135 +18,264 @@
 #include <zephyr/xen/public/domctl.h>
 #endif
 
+#ifdef CONFIG_XRUN_CHECKPOINT
+#include <checkpoint.h>
+#endif
+#ifdef CONFIG_XRUN_CONSOLE
+#include <console.h>
+#endif
+#include <hypervisor.h>
 #include <storage.h>
 #include <xen_dom_mgmt.h>
 #include <xl_parser.h>
+#ifdef CONFIG_XRUN_DT_GENERATE
+#include <xrun_fdt.h>
+#endif
+#include <xrun_pool.h>
+#include <xrun_spec.h>
+#include <xrun_trace.h>
 #include "xrun.h"
 
 LOG_MODULE_REGISTER(xrun);
 
 #define UNIKERNEL_ID_START 12
-#define VCPUS_MAX_COUNT 24
+#define SCHED_WEIGHT_DEFAULT 256
+#define SCHED_WEIGHT_MAX 65535
+#define DOMAIN_MEM_KB_DEFAULT 4096
 
 #define CONFIG_JSON_NAME "config.json"
+#define BUNDLE_ARCHIVE_EXT ".xrar"
+#define FLASH_PATH_PREFIX "flash:"
 
 static K_MUTEX_DEFINE(container_lock);
 
 static sys_slist_t container_list = SYS_SLIST_STATIC_INIT(&container_list);
 static uint32_t next_domid = UNIKERNEL_ID_START;
 
-#define XRUN_JSON_PARAMETERS_MAX 24
-
-struct hypervisor_spec {
-	const char *path;
-	const char *parameters[XRUN_JSON_PARAMETERS_MAX];
-	size_t params_len;
-};
-
-struct kernel_spec {
-	const char *path;
-	const char *parameters[XRUN_JSON_PARAMETERS_MAX];
-	size_t params_len;
-};
-
-struct iomem_spec {
-	const uint64_t firstGFN;
-	const uint64_t firstMFN;
-	const uint64_t nrMFNs;
-};
-
-struct hwconfig_spec {
-	const char *deviceTree;
-	const uint32_t vcpus;
-	const uint64_t memKB;
-	const char *dtdevs[CONFIG_XRUN_DTDEVS_MAX];
-	const struct iomem_spec iomems[CONFIG_XRUN_IOMEMS_MAX];
-	const uint32_t irqs[CONFIG_XRUN_IRQS_MAX];
-	size_t iomems_len;
-	size_t dtdevs_len;
-	size_t irqs_len;
+/*
+ * Container starts are serialized by the start gate, waiting starts are
+ * admitted by the spec priority. The gate is held for the whole
+ * domain_create(), as the image is loaded from inside of it and xenlib
+ * doesn't support concurrent domain creation, so the start holding the
+ * gate is never preempted.
+ */
+struct start_waiter {
+	sys_snode_t node;
+	int32_t priority;
+	struct k_sem sem;
 };
 
-struct vm_spec {
-	struct hypervisor_spec hypervisor;
-	struct kernel_spec kernel;
-	struct hwconfig_spec hwConfig;
+enum restart_policy {
+	RESTART_NO = 0,
+	RESTART_ON_FAILURE,
+	RESTART_ALWAYS,
 };
 
-struct domain_spec {
-	const char *ociVersion;
-	struct vm_spec vm;
+static struct k_spinlock start_gate_lock;
+static bool start_gate_busy;
+static sys_slist_t start_gate_waiters =
+	SYS_SLIST_STATIC_INIT(&start_gate_waiters);
+
+#ifdef CONFIG_XRUN_ADMISSION
+struct admission_group {
+	char name[CONTAINER_NAME_SIZE];
+	/* Limits set by xrun_set_group_limit, 0 - no limit */
+	uint64_t mem_limit_kb;
+	uint32_t vcpus_limit;
+	uint64_t reserved_mem_kb;
+	uint32_t reserved_vcpus;
 };
-
-static K_MUTEX_DEFINE(container_run_lock);
-static char *gdtdevs[CONFIG_XRUN_DTDEVS_MAX];
-static struct xen_domain_iomem giomems[CONFIG_XRUN_IOMEMS_MAX];
-static uint32_t girqs[CONFIG_XRUN_IRQS_MAX];
+#endif
 
 struct container {
 	sys_snode_t node;
 
 	char container_id[CONTAINER_NAME_SIZE];
-	const char *bundle;
+	char bundle[CONFIG_XRUN_MAX_PATH_SIZE];
+
+	/*
+	 * Spec and domain configuration are kept while container is
+	 * registered, so domain can be recreated without bundle parsing.
+	 * Spec strings point to the config buffer.
+	 */
+	char *config;
+	size_t config_size;
+	struct xrun_domain_spec spec;
+	struct xen_domain_cfg domcfg;
+	/*
+	 * Set under container_lock when the first start is finished, so
+	 * domcfg is complete and the container may be killed.
+	 */
+	bool ready;
+	uint32_t restarts;
+
+	enum restart_policy restart_policy;
+	uint32_t max_retries;
+	/* Restarts since the domain last ran for a stable period */
+	uint32_t retries;
+	/* Domain exits other than power off */
+	uint32_t crashes;
+#ifdef CONFIG_XRUN_SUPERVISOR
+	/* Set by xrun_kill, supervisor doesn't touch container anymore */
+	bool killed;
+	struct k_work_delayable restart_work;
+	/* Restart is scheduled and holds a container reference */
+	bool restart_pending;
+#endif
+#ifdef CONFIG_XRUN_ADMISSION
+	struct admission_group *group;
+	uint64_t reserved_mem_kb;
+	uint32_t reserved_vcpus;
+	/* Admitted, but domain memory is not allocated yet */
+	bool admission_pending;
+#endif
+	/* Kernel image in memory, embedded or cached, is used if set */
+	const uint8_t *image_data;
+	size_t image_data_size;
+#if CONFIG_XRUN_IMAGE_CACHE_SIZE > 0
+	/* Kernel image bytes, used once whole image is loaded */
+	uint8_t *image_cache;
+	size_t image_cache_size;
+	/* End of the image part loaded from the start without gaps */
+	size_t image_cached;
+#endif
 
 	uint8_t devicetree[CONFIG_PARTIAL_DEVICE_TREE_SIZE] __aligned(8);
+	/* Size of the device-tree embedded in devicetree, 0 - not embedded */
+	size_t dtb_size;
 
 	uint64_t domid;
+	uint64_t mem_kb;
+	uint64_t min_mem_kb;
+	uint64_t max_mem_kb;
+	/* Memory target set for the domain balloon driver */
+	uint64_t target_mem_kb;
+	uint32_t vcpus;
+	/* Physical CPU masks of the vCPUs, 0 - no affinity */
+	uint32_t vcpu_affinity[XRUN_VCPUS_MAX];
+	uint32_t sched_weight;
+	uint32_t sched_cap;
+	/* Weight or cap is set and must be applied on every start */
+	bool sched_set;
+	/* Domain is created and not destroyed yet */
+	bool domain_created;
+	int console_socket;
 	char kernel_image[CONFIG_XRUN_MAX_PATH_SIZE];
 	char dt_image[CONFIG_XRUN_MAX_PATH_SIZE];
+	char cmdline[CONFIG_XRUN_CMDLINE_SIZE_MAX];
 	bool has_dt_image;
+	struct xrun_stream *image;
+	struct xrun_archive *archive;
+	struct xrun_io_req dtb_req;
+	bool dtb_pending;
+	struct xrun_io_budget io_budget;
+	bool throttled;
+	struct start_waiter start;
+
+	/*
+	 * Domain configuration arrays, used until domain is created. Kept per
+	 * container, so pending starts don't share them with others.
+	 */
+	char *dtdevs[CONFIG_XRUN_DTDEVS_MAX];
+	struct xen_domain_iomem iomems[CONFIG_XRUN_IOMEMS_MAX];
+	uint32_t irqs[CONFIG_XRUN_IRQS_MAX];
 	enum container_status status;
+	int64_t start_time;
+	uint64_t image_size;
+	uint32_t load_time_ms;
+	uint32_t load_rate;
 	struct k_mutex lock;
 	int refcount;
+	/* Registry reference is dropped, set under container_lock */
+	bool removed;
 };
 
+#ifdef CONFIG_XRUN_SUPERVISOR
+static void supervisor_restart(struct k_work *work);
+#endif
+
 static const struct json_obj_descr hypervisor_spec_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct hypervisor_spec, path, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_ARRAY(struct hypervisor_spec, parameters,
+	JSON_OBJ_DESCR_PRIM(struct xrun_hypervisor_spec, path, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_hypervisor_spec, parameters,
 			     XRUN_JSON_PARAMETERS_MAX, params_len,
 			     JSON_TOK_STRING),
 };
 
 static const struct json_obj_descr kernel_spec_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct kernel_spec, path, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_ARRAY(struct kernel_spec, parameters,
+	JSON_OBJ_DESCR_PRIM(struct xrun_kernel_spec, path, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_kernel_spec, parameters,
 			     XRUN_JSON_PARAMETERS_MAX, params_len,
 			     JSON_TOK_STRING),
 };
 
 static const struct json_obj_descr iomem_spec_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct iomem_spec, firstGFN, JSON_TOK_NUMBER),
-	JSON_OBJ_DESCR_PRIM(struct iomem_spec, firstMFN, JSON_TOK_NUMBER),
-	JSON_OBJ_DESCR_PRIM(struct iomem_spec, nrMFNs, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_iomem_spec, firstGFN, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_iomem_spec, firstMFN, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_iomem_spec, nrMFNs, JSON_TOK_NUMBER),
+};
+
+static const struct json_obj_descr dt_node_spec_descr[] = {
+	JSON_OBJ_DESCR_PRIM(struct xrun_dt_node_spec, name, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct xrun_dt_node_spec, compatible, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct xrun_dt_node_spec, path, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_dt_node_spec, reg, XRUN_DT_NODE_REGS_MAX,
+			     reg_len, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_dt_node_spec, interrupts,
+			     XRUN_DT_NODE_IRQS_MAX, interrupts_len,
+			     JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_dt_node_spec, props, XRUN_DT_NODE_PROPS_MAX,
+			     props_len, JSON_TOK_STRING),
 };
 
 static const struct json_obj_descr hwconfig_spec_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct hwconfig_spec, deviceTree, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_PRIM(struct hwconfig_spec, vcpus, JSON_TOK_NUMBER),
-	JSON_OBJ_DESCR_PRIM(struct hwconfig_spec, memKB, JSON_TOK_NUMBER),
-	JSON_OBJ_DESCR_ARRAY(struct hwconfig_spec, dtdevs, CONFIG_XRUN_DTDEVS_MAX,
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, deviceTree, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, vcpus, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, memKB, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, minMemKB, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, maxMemKB, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_hwconfig_spec, dtdevs, CONFIG_XRUN_DTDEVS_MAX,
 			     dtdevs_len, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_OBJ_ARRAY(struct hwconfig_spec, iomems,
+	JSON_OBJ_DESCR_OBJ_ARRAY(struct xrun_hwconfig_spec, iomems,
 				 CONFIG_XRUN_IOMEMS_MAX, iomems_len,
 				 iomem_spec_descr,
 				 ARRAY_SIZE(iomem_spec_descr)),
-	JSON_OBJ_DESCR_ARRAY(struct hwconfig_spec, irqs, CONFIG_XRUN_IRQS_MAX,
+	JSON_OBJ_DESCR_ARRAY(struct xrun_hwconfig_spec, irqs, CONFIG_XRUN_IRQS_MAX,
 			     irqs_len, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, cpuAffinity, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_ARRAY(struct xrun_hwconfig_spec, vcpuPinning, XRUN_VCPUS_MAX,
+			     vcpuPinning_len, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, schedWeight, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_hwconfig_spec, schedCap, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_OBJ_ARRAY(struct xrun_hwconfig_spec, dtNodes,
+				 XRUN_DT_NODES_MAX, dtNodes_len,
+				 dt_node_spec_descr,
+				 ARRAY_SIZE(dt_node_spec_descr)),
+};
+
+static const struct json_obj_descr restart_policy_spec_descr[] = {
+	JSON_OBJ_DESCR_PRIM(struct xrun_restart_policy_spec, name, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_PRIM(struct xrun_restart_policy_spec, maxRetries,
+			    JSON_TOK_NUMBER),
 };
 
 static const struct json_obj_descr vm_spec_descr[] = {
-	JSON_OBJ_DESCR_OBJECT(struct vm_spec,
+	JSON_OBJ_DESCR_OBJECT(struct xrun_vm_spec,
 			      hypervisor, hypervisor_spec_descr),
-	JSON_OBJ_DESCR_OBJECT(struct vm_spec, kernel, kernel_spec_descr),
-	JSON_OBJ_DESCR_OBJECT(struct vm_spec, hwConfig, hwconfig_spec_descr),
+	JSON_OBJ_DESCR_OBJECT(struct xrun_vm_spec, kernel, kernel_spec_descr),
+	JSON_OBJ_DESCR_OBJECT(struct xrun_vm_spec, hwConfig, hwconfig_spec_descr),
+	JSON_OBJ_DESCR_PRIM(struct xrun_vm_spec, priority, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_PRIM(struct xrun_vm_spec, ioRateKBps, JSON_TOK_NUMBER),
+	JSON_OBJ_DESCR_OBJECT(struct xrun_vm_spec, restartPolicy,
+			      restart_policy_spec_descr),
+	JSON_OBJ_DESCR_PRIM(struct xrun_vm_spec, group, JSON_TOK_STRING),
 };
 
 static const struct json_obj_descr domain_spec_descr[] = {
-	JSON_OBJ_DESCR_PRIM(struct domain_spec, ociVersion, JSON_TOK_STRING),
-	JSON_OBJ_DESCR_OBJECT(struct domain_spec, vm, vm_spec_descr),
+	JSON_OBJ_DESCR_PRIM(struct xrun_domain_spec, ociVersion, JSON_TOK_STRING),
+	JSON_OBJ_DESCR_OBJECT(struct xrun_domain_spec, vm, vm_spec_descr),
 };
 
-int parse_config_json(char *json, size_t json_size, struct domain_spec *domain)
+int parse_config_json(char *json, size_t json_size, struct xrun_domain_spec *domain)
 {
 	int expected_return_code = (1 << ARRAY_SIZE(domain_spec_descr)) - 1;
 	int ret = json_obj_parse(json,
@@ -165,6 +294,217 @@ int parse_config_json(char *json, size_t json_size, struct domain_spec *domain)
 	return ret;
 }
 
+#ifdef CONFIG_XRUN_ADMISSION
+/*
+ * Memory and vCPUs of the container are reserved right after its spec is
+ * parsed, so start which can't fit fails before the images are read.
+ * Containers reserve maxMemKB, so ballooning can't exceed group limits.
+ */
+static K_MUTEX_DEFINE(admission_lock);
+static K_CONDVAR_DEFINE(admission_cond);
+static struct admission_group admission_groups[CONFIG_XRUN_ADMISSION_GROUPS];
+static uint64_t admission_reserved_kb;
+static uint32_t admission_reserved_vcpus;
+/* Hypervisor doesn't count memory of the domains not created yet */
+static uint64_t admission_pending_kb;
+
+/* Called with admission lock held */
+static struct admission_group *admission_group_get(const char *name,
+						    bool create)
+{
+	struct admission_group *unused = NULL;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(admission_groups); i++) {
+		if (!admission_groups[i].name[0]) {
+			if (!unused) {
+				unused = &admission_groups[i];
+			}
+			continue;
+		}
+
+		if (!strncmp(admission_groups[i].name, name,
+			     CONTAINER_NAME_SIZE)) {
+			return &admission_groups[i];
+		}
+	}
+
+	if (!create || !unused) {
+		return NULL;
+	}
+
+	snprintf(unused->name, CONTAINER_NAME_SIZE, "%s", name);
+	return unused;
+}
+
+/* Called with admission lock held, group without limits and users is freed */
+static void admission_group_put(struct admission_group *group)
+{
+	if (group && !group->mem_limit_kb && !group->vcpus_limit &&
+	    !group->reserved_mem_kb && !group->reserved_vcpus) {
+		memset(group, 0, sizeof(*group));
+	}
+}
+
+/*
+ * Called with admission lock held. Returns -ENOMEM if the host can't fit
+ * the domain and -ENOSPC if the group limit is reached, reason is set
+ * in both cases.
+ */
+static int admission_check(uint64_t mem_kb, uint64_t max_kb, uint32_t vcpus,
+			   const struct admission_group *group,
+			   const char **reason)
+{
+	uint64_t free_kb;
+	uint32_t nr_cpus;
+	int ret;
+
+	*reason = NULL;
+	ret = xrun_hyp_get_physinfo(&free_kb, &nr_cpus);
+	if (ret) {
+		return ret;
+	}
+
+	if (mem_kb + admission_pending_kb > free_kb) {
+		*reason = "host memory";
+		return -ENOMEM;
+	}
+
+	if (CONFIG_XRUN_ADMISSION_VCPU_RATIO &&
+	    admission_reserved_vcpus + vcpus >
+	    nr_cpus * CONFIG_XRUN_ADMISSION_VCPU_RATIO) {
+		*reason = "host vCPUs";
+		return -ENOMEM;
+	}
+
+	if (group && group->mem_limit_kb &&
+	    group->reserved_mem_kb + max_kb > group->mem_limit_kb) {
+		*reason = "group memory";
+		return -ENOSPC;
+	}
+
+	if (group && group->vcpus_limit &&
+	    group->reserved_vcpus + vcpus > group->vcpus_limit) {
+		*reason = "group vCPUs";
+		return -ENOSPC;
+	}
+
+	return 0;
+}
+
+static int admission_reserve(struct container *container)
+{
+	const struct xrun_vm_spec *vm = &container->spec.vm;
+	int64_t deadline = k_uptime_get() + CONFIG_XRUN_ADMISSION_WAIT_MS;
+	struct admission_group *group = NULL;
+	const char *reason = NULL;
+	uint64_t mem_kb, max_kb;
+	uint32_t vcpus;
+	int64_t remaining;
+	int ret = 0;
+
+	mem_kb = (vm->hwConfig.memKB) ?
+		vm->hwConfig.memKB : DOMAIN_MEM_KB_DEFAULT;
+	max_kb = MAX(vm->hwConfig.maxMemKB, mem_kb);
+	mem_kb += CONFIG_XRUN_ADMISSION_OVERHEAD_KB;
+	vcpus = (vm->hwConfig.vcpus) ? vm->hwConfig.vcpus : 1;
+	if (vcpus > XRUN_VCPUS_MAX) {
+		/* Invalid spec is rejected by fill_domcfg */
+		return 0;
+	}
+
+	k_mutex_lock(&admission_lock, K_FOREVER);
+	if (vm->group) {
+		group = admission_group_get(vm->group, true);
+		if (!group) {
+			LOG_ERR("No free admission group for %s", vm->group);
+			ret = -ENOSPC;
+			goto out;
+		}
+	}
+
+	for (;;) {
+		ret = admission_check(mem_kb, max_kb, vcpus, group, &reason);
+		if (!reason) {
+			break;
+		}
+
+		remaining = deadline - k_uptime_get();
+		if (remaining <= 0) {
+			break;
+		}
+
+		/* Wait for other containers to release their resources */
+		k_condvar_wait(&admission_cond, &admission_lock,
+			       K_MSEC(remaining));
+	}
+
+	if (reason) {
+		LOG_ERR("%s: not enough %s for %llu KB and %u vCPUs",
+			container->container_id, reason, max_kb, vcpus);
+	}
+
+	if (ret) {
+		goto out;
+	}
+
+	container->group = group;
+	container->reserved_mem_kb = max_kb;
+	container->reserved_vcpus = vcpus;
+	container->admission_pending = true;
+	admission_reserved_kb += max_kb;
+	admission_reserved_vcpus += vcpus;
+	admission_pending_kb += mem_kb;
+	if (group) {
+		group->reserved_mem_kb += max_kb;
+		group->reserved_vcpus += vcpus;
+	}
+out:
+	if (ret) {
+		admission_group_put(group);
+	}
+	k_mutex_unlock(&admission_lock);
+	return ret;
+}
+
+/* Domain memory is allocated and counted by the hypervisor now */
+static void admission_commit(struct container *container)
+{
+	const struct xrun_vm_spec *vm = &container->spec.vm;
+	uint64_t mem_kb = (vm->hwConfig.memKB) ?
+		vm->hwConfig.memKB : DOMAIN_MEM_KB_DEFAULT;
+
+	k_mutex_lock(&admission_lock, K_FOREVER);
+	if (container->admission_pending) {
+		admission_pending_kb -= mem_kb + CONFIG_XRUN_ADMISSION_OVERHEAD_KB;
+		container->admission_pending = false;
+	}
+	k_mutex_unlock(&admission_lock);
+}
+
+static void admission_release(struct container *container)
+{
+	if (!container->reserved_vcpus) {
+		/* Container was not admitted */
+		return;
+	}
+
+	admission_commit(container);
+
+	k_mutex_lock(&admission_lock, K_FOREVER);
+	admission_reserved_kb -= container->reserved_mem_kb;
+	admission_reserved_vcpus -= container->reserved_vcpus;
+	if (container->group) {
+		container->group->reserved_mem_kb -= container->reserved_mem_kb;
+		container->group->reserved_vcpus -= container->reserved_vcpus;
+		admission_group_put(container->group);
+	}
+	container->reserved_vcpus = 0;
+	k_condvar_broadcast(&admission_cond);
+	k_mutex_unlock(&admission_lock);
+}
+#endif /* CONFIG_XRUN_ADMISSION */
+
 static struct container *get_container_locked(const char *container_id)
 {
 	struct container *container = NULL;
@@ -184,7 +524,8 @@ static struct container *get_container(const char *container_id)
 {
 	struct container *container = NULL;
 
-	k_mutex_lock(&container_lock, K_FOREVER);
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
 
 	container = get_container_locked(container_id);
 
@@ -192,57 +533,193 @@ static struct container *get_container(const char *container_id)
 	return container;
 }
 
-static void put_container(struct container *container)
+/* Destroys domain of the container removed from the registry */
+static int container_free(struct container *container)
 {
-	int ret;
-
-	if (!container) {
-		return;
-	}
-	k_mutex_lock(&container_lock, K_FOREVER);
+	int ret = 0;
 
-	container->refcount--;
-	if (container->refcount == 0) {
+	/* Failed start or restart has already destroyed the domain */
+	if (container->domain_created) {
+#ifdef CONFIG_XRUN_CONSOLE
+		if (container->console_socket > 0) {
+			xrun_console_stop(container->domid);
+		}
+#endif
 		ret = domain_destroy(container->domid);
 		if (ret) {
-			LOG_ERR("Failed to destroy domain %llu", container->domid);
+			LOG_ERR("Failed to destroy domain %llu",
+				container->domid);
 		}
+	}
+#ifdef CONFIG_XRUN_ADMISSION
+	admission_release(container);
+#endif
+
+#if CONFIG_XRUN_IMAGE_CACHE_SIZE > 0
+	k_free(container->image_cache);
+#endif
+	k_free(container->config);
+	k_free(container);
+
+	return ret;
+}
+
+/* Returns result of the domain destroy if the last reference is dropped */
+static int put_container(struct container *container)
+{
+	bool last;
+
+	if (!container) {
+		return 0;
+	}
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
 
+	container->refcount--;
+	last = container->refcount == 0;
+	if (last) {
 		sys_slist_find_and_remove(&container_list, &container->node);
-		k_free(container);
 	}
 
 	k_mutex_unlock(&container_lock);
+
+	/* Domain is destroyed without the registry locked */
+	return last ? container_free(container) : 0;
+}
+
+/*
+ * Removes container from the registry and drops the registry reference.
+ * Only the first caller drops it, so concurrent kill and stop don't put
+ * the same reference twice. Returns -EALREADY for the others.
+ */
+static int unregister_container(struct container *container)
+{
+	bool registered;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	registered = !container->removed;
+	if (registered) {
+		container->removed = true;
+		sys_slist_find_and_remove(&container_list, &container->node);
+	}
+	k_mutex_unlock(&container_lock);
+
+	return registered ? put_container(container) : -EALREADY;
 }
 
-static struct container *register_container_id(const char *container_id)
+static int register_container_id(const char *container_id,
+				 struct container **out)
 {
 	struct container *container;
 
-	k_mutex_lock(&container_lock, K_FOREVER);
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
 	container = get_container_locked(container_id);
 	if (container) {
 		k_mutex_unlock(&container_lock);
 		put_container(container);
 		LOG_ERR("Container %s already exists", container_id);
-		return NULL;
+		return -EEXIST;
 	}
 
 	container = (struct container *)k_malloc(sizeof(*container));
 	if (!container) {
 		k_mutex_unlock(&container_lock);
-		return NULL;
+		return -ENOMEM;
 	}
 
+	memset(container, 0, sizeof(*container));
 	strncpy(container->container_id, container_id, CONTAINER_NAME_SIZE);
 	container->domid = next_domid++;
+	/* Domain is not created yet */
+	container->status = DESTROYED;
+	container->start_time = 0;
+	container->console_socket = 0;
+	container->image_size = 0;
+	container->load_time_ms = 0;
+	container->load_rate = 0;
+	container->image = NULL;
+	container->archive = NULL;
+	container->dtb_pending = false;
+	container->throttled = false;
+	container->start.priority = 0;
+	k_sem_init(&container->start.sem, 0, 1);
 	k_mutex_init(&container->lock);
+#ifdef CONFIG_XRUN_SUPERVISOR
+	k_work_init_delayable(&container->restart_work, supervisor_restart);
+#endif
 
 	sys_slist_append(&container_list, &container->node);
-	container->refcount = 1;
+	/* Registry reference and the one held by the start till its end */
+	container->refcount = 2;
 	k_mutex_unlock(&container_lock);
 
-	return container;
+	*out = container;
+	return 0;
+}
+
+/* Container is registered, but its first start has not finished yet */
+static bool container_starting(struct container *container)
+{
+	bool starting;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	starting = !container->ready;
+	k_mutex_unlock(&container_lock);
+
+	return starting;
+}
+
+/* Waiters are sorted by priority, FIFO for the same priority */
+static void start_gate_enqueue_locked(struct start_waiter *waiter)
+{
+	struct start_waiter *cur, *prev = NULL;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&start_gate_waiters, cur, node) {
+		if (cur->priority < waiter->priority) {
+			break;
+		}
+		prev = cur;
+	}
+
+	if (prev) {
+		sys_slist_insert(&start_gate_waiters, &prev->node, &waiter->node);
+	} else {
+		sys_slist_prepend(&start_gate_waiters, &waiter->node);
+	}
+}
+
+static void start_gate_acquire(struct start_waiter *waiter)
+{
+	k_spinlock_key_t key = k_spin_lock(&start_gate_lock);
+
+	if (!start_gate_busy) {
+		start_gate_busy = true;
+		k_spin_unlock(&start_gate_lock, key);
+		return;
+	}
+
+	start_gate_enqueue_locked(waiter);
+	k_spin_unlock(&start_gate_lock, key);
+
+	/* Gate is handed over by the previous owner */
+	k_sem_take(&waiter->sem, K_FOREVER);
+}
+
+static void start_gate_release(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&start_gate_lock);
+	sys_snode_t *node = sys_slist_get(&start_gate_waiters);
+
+	if (node) {
+		k_sem_give(&CONTAINER_OF(node, struct start_waiter, node)->sem);
+	} else {
+		start_gate_busy = false;
+	}
+
+	k_spin_unlock(&start_gate_lock, key);
 }
 
 static int load_image_bytes(uint8_t *buf, size_t bufsize,
@@ -257,8 +734,33 @@ static int load_image_bytes(uint8_t *buf, size_t bufsize,
 
 	container = (struct container *)image_info;
 
-	res = xrun_read_file(container->kernel_image, buf,
-			     bufsize, image_load_offset);
+	if (container->image_data) {
+		if (image_load_offset >= container->image_data_size) {
+			return -EINVAL;
+		}
+
+		memcpy(buf, container->image_data + image_load_offset,
+		       MIN(bufsize, container->image_data_size -
+			   image_load_offset));
+		return 0;
+	}
+
+	xrun_trace(XRUN_TRACE_IMAGE_CHUNK_BEGIN, bufsize);
+	res = xrun_stream_read(container->image, buf, bufsize,
+			       image_load_offset);
+	xrun_trace(XRUN_TRACE_IMAGE_CHUNK_END, bufsize);
+
+#if CONFIG_XRUN_IMAGE_CACHE_SIZE > 0
+	/* Chunks may be reread, only the contiguous loaded part is valid */
+	if (res > 0 && container->image_cache &&
+	    image_load_offset + res <= container->image_cache_size) {
+		memcpy(container->image_cache + image_load_offset, buf, res);
+		if (image_load_offset <= container->image_cached) {
+			container->image_cached = MAX(container->image_cached,
+						      image_load_offset + res);
+		}
+	}
+#endif
 
 	return (res > 0) ? 0 : res;
 }
@@ -274,18 +776,87 @@ static ssize_t get_image_size(void *image_info, uint64_t *size)
 
 	containter = (struct container *)image_info;
 
-	image_size = xrun_get_file_size(containter->kernel_image);
-	if (image_size > 0) {
-		*size = image_size;
+	if (containter->image_data) {
+		*size = containter->image_data_size;
+		return 0;
+	}
+
+	image_size = xrun_stream_size(containter->image);
+	if (image_size <= 0) {
+		return (image_size == 0) ? -EINVAL : image_size;
+	}
+
+#if CONFIG_XRUN_IMAGE_CACHE_SIZE > 0
+	/* Keep small images in memory to skip storage on restart */
+	if (!containter->image_cache &&
+	    image_size <= KB(CONFIG_XRUN_IMAGE_CACHE_SIZE)) {
+		containter->image_cache = k_malloc(image_size);
+		containter->image_cache_size = image_size;
+		containter->image_cached = 0;
+	}
+#endif
+
+	*size = image_size;
+	return 0;
+}
+
+static void log_image_stats(struct container *container)
+{
+	struct xrun_stream_stats stats;
+	uint64_t rate = 0, achieved = 0;
+
+	/* Image was taken from the cache */
+	if (!container->image) {
+		return;
+	}
+
+	xrun_stream_get_stats(container->image, &stats);
+	if (stats.io_time_us) {
+		rate = (stats.bytes * USEC_PER_SEC) /
+			(stats.io_time_us * 1024ULL);
+	}
+
+	if (stats.active_us) {
+		achieved = (stats.bytes * USEC_PER_SEC) /
+			(stats.active_us * 1024ULL);
+	}
+
+	container->image_size = stats.bytes;
+	container->load_rate = achieved;
+
+	LOG_INF("%s: image %llu bytes, %u requests, %u reads, chunk %zu, %llu KB/s",
+		container->container_id, stats.bytes, stats.requests,
+		stats.reads, stats.chunk_size, rate);
+	LOG_INF("%s: achieved %llu KB/s, throttled %llu ms",
+		container->container_id, achieved,
+		stats.throttled_us / USEC_PER_MSEC);
+}
+
+static ssize_t read_bundle_file(struct container *container, const char *path,
+				char *buf, size_t size);
+
+/* Cap is limited by the number of vCPUs, as each vCPU is 100% of pCPU */
+static int check_sched(uint32_t weight, uint32_t cap, uint32_t vcpus)
+{
+	if (!weight || weight > SCHED_WEIGHT_MAX) {
+		LOG_ERR("Scheduler weight %u is out of [1, %d] range", weight,
+			SCHED_WEIGHT_MAX);
+		return -EINVAL;
+	}
+
+	if (cap > 100 * vcpus) {
+		LOG_ERR("Scheduler cap %u exceeds %u%% for %u vcpus", cap,
+			100 * vcpus, vcpus);
+		return -EINVAL;
 	}
 
-	return (size == 0) ? -EINVAL : 0;
+	return 0;
 }
 
-static int fill_domcfg(struct xen_domain_cfg *domcfg, struct domain_spec *spec,
+static int fill_domcfg(struct xen_domain_cfg *domcfg, struct xrun_domain_spec *spec,
 		       struct container *container)
 {
-	int i;
+	int i, ret;
 
 	if (!domcfg || !spec) {
 		return -EINVAL;
@@ -293,16 +864,58 @@ static int fill_domcfg(struct xen_domain_cfg *domcfg, struct domain_spec *spec,
 
 	snprintf(domcfg->name, CONTAINER_NAME_SIZE, "%s", container->container_id);
 	domcfg->mem_kb = (spec->vm.hwConfig.memKB) ?
-		spec->vm.hwConfig.memKB : 4096;
+		spec->vm.hwConfig.memKB : DOMAIN_MEM_KB_DEFAULT;
 	domcfg->flags = (XEN_DOMCTL_CDF_hvm | XEN_DOMCTL_CDF_hap);
 	domcfg->max_evtchns = 10;
-	if (spec->vm.hwConfig.vcpus < VCPUS_MAX_COUNT) {
-		domcfg->max_vcpus = (spec->vm.hwConfig.vcpus) ?
-			spec->vm.hwConfig.vcpus : 1;
-	} else {
-		domcfg->max_vcpus = 1;
+	if (spec->vm.hwConfig.vcpus > XRUN_VCPUS_MAX) {
+		LOG_ERR("vcpus %u exceeds maximum of %d",
+			spec->vm.hwConfig.vcpus, XRUN_VCPUS_MAX);
+		return -EINVAL;
+	}
+
+	domcfg->max_vcpus = (spec->vm.hwConfig.vcpus) ?
+		spec->vm.hwConfig.vcpus : 1;
+
+	if (spec->vm.hwConfig.vcpuPinning_len > domcfg->max_vcpus) {
+		LOG_ERR("vcpuPinning has %zu entries for %u vcpus",
+			spec->vm.hwConfig.vcpuPinning_len, domcfg->max_vcpus);
+		return -EINVAL;
+	}
+
+	container->sched_weight = (spec->vm.hwConfig.schedWeight) ?
+		spec->vm.hwConfig.schedWeight : SCHED_WEIGHT_DEFAULT;
+	container->sched_cap = spec->vm.hwConfig.schedCap;
+	container->sched_set = spec->vm.hwConfig.schedWeight ||
+		spec->vm.hwConfig.schedCap;
+	ret = check_sched(container->sched_weight, container->sched_cap,
+			  domcfg->max_vcpus);
+	if (ret) {
+		return ret;
+	}
+
+	for (i = 0; i < domcfg->max_vcpus; i++) {
+		container->vcpu_affinity[i] =
+			(i < spec->vm.hwConfig.vcpuPinning_len) ?
+			spec->vm.hwConfig.vcpuPinning[i] :
+			spec->vm.hwConfig.cpuAffinity;
 	}
 
+	container->mem_kb = domcfg->mem_kb;
+	container->target_mem_kb = domcfg->mem_kb;
+	container->min_mem_kb = (spec->vm.hwConfig.minMemKB) ?
+		spec->vm.hwConfig.minMemKB : domcfg->mem_kb;
+	container->max_mem_kb = (spec->vm.hwConfig.maxMemKB) ?
+		spec->vm.hwConfig.maxMemKB : domcfg->mem_kb;
+	if (container->min_mem_kb > domcfg->mem_kb ||
+	    container->max_mem_kb < domcfg->mem_kb) {
+		LOG_ERR("memKB %llu is out of [%llu, %llu] range",
+			domcfg->mem_kb, container->min_mem_kb,
+			container->max_mem_kb);
+		return -EINVAL;
+	}
+
+	container->vcpus = domcfg->max_vcpus;
+
 	domcfg->gnt_frames = 32;
 	domcfg->max_maptrack_frames = 1;
 
@@ -377,81 +990,113 @@ static int fill_domcfg(struct xen_domain_cfg *domcfg, struct domain_spec *spec,
 	domcfg->image_info = container;
 
 	if (container->has_dt_image) {
-		size_t res =
-			xrun_read_file(container->dt_image,
-				       container->devicetree,
-				       CONFIG_PARTIAL_DEVICE_TREE_SIZE, 0);
+		ssize_t res;
+
+		if (container->dtb_pending) {
+			res = xrun_io_wait(&container->dtb_req, K_FOREVER);
+			container->dtb_pending = false;
+		} else {
+			res = read_bundle_file(container, container->dt_image,
+					       container->devicetree,
+					       CONFIG_PARTIAL_DEVICE_TREE_SIZE);
+		}
 		if (res < 0) {
 			LOG_ERR("Unable to read dtb rc: %ld", res);
 			return res;
 		}
 		domcfg->dtb_start = container->devicetree;
 		domcfg->dtb_end = container->devicetree + res;
+	} else if (container->dtb_size) {
+		domcfg->dtb_start = container->devicetree;
+		domcfg->dtb_end = container->devicetree + container->dtb_size;
 	} else {
 		domcfg->dtb_start = NULL;
 		domcfg->dtb_end = NULL;
 	}
 
-	/* Parse and fill backend configuration */
-	memset(&domcfg->back_cfg, 0, sizeof(domcfg->back_cfg));
-
-	for (i = 0; i < spec->vm.kernel.params_len; i++) {
-		parse_one_record_and_fill_cfg(spec->vm.kernel.parameters[i], &domcfg->back_cfg);
-	}
-
 	return 0;
 }
 
-static int generate_cmdline(struct domain_spec *spec, char **cmdline)
+static bool is_backend_record(const char *param)
 {
-	int i, pos = 0;
-	int len = 0, str_len;
+	static const char *const backends[] = { "disk", "vif" };
+	const char *pos;
+	size_t len;
+	int i;
 
-	if (!spec) {
-		LOG_ERR("Can't generate cmdline, invalid parameters");
-		return -EINVAL;
+	for (i = 0; i < ARRAY_SIZE(backends); i++) {
+		len = strlen(backends[i]);
+		if (strncmp(param, backends[i], len)) {
+			continue;
+		}
+
+		/* xl allows spaces between record name and '=' */
+		for (pos = param + len; *pos == ' '; pos++) {
+		}
+
+		if (*pos == '=') {
+			return true;
+		}
 	}
 
-	if (spec->vm.kernel.params_len == 0) {
-		/*
-		 * If cmd parameter weren't provided - then we
-		 * don't allocate any memory for cmdline and return
-		 * NULL. This is safe because /chosen node will not
-		 * be created if cmdline is NULL. k_free also handles
-		 * NULL
-		 */
-		*cmdline = NULL;
-		return 0;
+	return false;
+}
+
+/*
+ * Build kernel cmdline into container buffer and fill backend
+ * configuration in a single pass over kernel parameters.
+ */
+static int generate_cmdline(struct xrun_domain_spec *spec,
+			    struct xen_domain_cfg *domcfg,
+			    struct container *container)
+{
+	const char *param;
+	size_t pos = 0, len;
+	int i;
+
+	if (!spec || !domcfg || !container) {
+		LOG_ERR("Can't generate cmdline, invalid parameters");
+		return -EINVAL;
 	}
 
+	memset(&domcfg->back_cfg, 0, sizeof(domcfg->back_cfg));
+
 	for (i = 0; i < spec->vm.kernel.params_len; i++) {
-		str_len = strlen(spec->vm.kernel.parameters[i]);
-		if (!str_len) {
+		param = spec->vm.kernel.parameters[i];
+		len = strlen(param);
+		if (!len) {
 			LOG_ERR("Empty parameter from json");
 			return -EINVAL;
 		}
 
-		len += str_len;
+		if (is_backend_record(param)) {
+			parse_one_record_and_fill_cfg(param, &domcfg->back_cfg);
+		}
+
+		/* Reserve space for separator and terminating null */
+		if (pos + (pos ? 1 : 0) + len + 1 > sizeof(container->cmdline)) {
+			LOG_ERR("Kernel cmdline is too long");
+			return -E2BIG;
+		}
 
-		if (i == spec->vm.kernel.params_len - 1) {
-			len++;
+		if (pos) {
+			container->cmdline[pos++] = ' ';
 		}
-	}
 
-	*cmdline = k_malloc(len + 1);
-	if (!*cmdline) {
-		LOG_ERR("Unable to allocate cmdline");
-		return -ENOMEM;
+		memcpy(container->cmdline + pos, param, len);
+		pos += len;
 	}
 
-	for (i = 0; i < spec->vm.kernel.params_len; i++) {
-		if (i == spec->vm.kernel.params_len - 1) {
-			pos += snprintf(*cmdline + pos, len - pos + 1, "%s",
-					spec->vm.kernel.parameters[i]);
-		} else {
-			pos += snprintf(*cmdline + pos, len - pos + 1, "%s ",
-					spec->vm.kernel.parameters[i]);
-		}
+	/*
+	 * If cmd parameters weren't provided - then cmdline is NULL.
+	 * This is safe because /chosen node will not be created if
+	 * cmdline is NULL.
+	 */
+	if (pos) {
+		container->cmdline[pos] = '\0';
+		domcfg->cmdline = container->cmdline;
+	} else {
+		domcfg->cmdline = NULL;
 	}
 
 	return 0;
@@ -484,216 +1129,1833 @@ static ssize_t get_fpath_size(const char *path, const char *name)
 	return target_size;
 }
 
-int xrun_run(const char *bundle, int console_socket, const char *container_id)
+static bool is_bundle_archive(const char *bundle)
 {
-	int ret = 0;
-	ssize_t bytes_read;
-	char *config;
-	char *fpath;
-	ssize_t fpath_len;
-	struct domain_spec spec = {0};
-	struct container *container;
-	struct xen_domain_cfg domcfg = {0};
+	size_t len = strlen(bundle);
 
-	/* Don't allow empty (first char is \0) or null container_id */
-	if (!container_id || !*container_id) {
-		return -EINVAL;
+	return (len > strlen(BUNDLE_ARCHIVE_EXT) &&
+		!strcmp(bundle + len - strlen(BUNDLE_ARCHIVE_EXT),
+			BUNDLE_ARCHIVE_EXT)) ||
+		!strncmp(bundle, FLASH_PATH_PREFIX, strlen(FLASH_PATH_PREFIX));
+}
+
+/* Relative paths from the archived bundle spec are archive entries */
+static bool in_archive(struct container *container, const char *path)
+{
+	return container->archive && path[0] != '/';
+}
+
+static ssize_t read_bundle_file(struct container *container, const char *path,
+				char *buf, size_t size)
+{
+	ssize_t res;
+
+	if (in_archive(container, path)) {
+		res = xrun_archive_read_file(container->archive, path, buf,
+					     size, 0);
+	} else {
+		res = xrun_read_file(path, buf, size, 0);
 	}
 
-	/* Don't allow empty or null bundle */
-	if (!bundle || !*bundle) {
-		return -EINVAL;
+	if (res > 0 && container->throttled) {
+		xrun_io_budget_charge(&container->io_budget, res);
 	}
 
-	container = register_container_id(container_id);
-	if (!container) {
-		ret = -ENOMEM;
-		goto err_unlock;
+	return res;
+}
+
+static int open_bundle_stream(struct container *container, const char *path,
+			      struct xrun_stream **stream)
+{
+	if (in_archive(container, path)) {
+		return xrun_archive_stream_open(container->archive, path,
+						stream);
 	}
 
-	config = k_malloc(CONFIG_XRUN_JSON_SIZE_MAX);
-	if (!config) {
-		ret = -ENOMEM;
-		goto err;
+	return xrun_stream_open(path, stream);
+}
+
+static ssize_t read_config(struct container *container, const char *bundle,
+			   char *config)
+{
+	ssize_t bytes_read;
+	ssize_t fpath_len;
+	char *fpath;
+	int ret;
+
+	if (container->archive) {
+		return xrun_archive_read_file(container->archive,
+					      CONFIG_JSON_NAME, config,
+					      CONFIG_XRUN_JSON_SIZE_MAX, 0);
 	}
 
 	fpath_len = get_fpath_size(bundle, CONFIG_JSON_NAME);
 	if (fpath_len < 0) {
-		ret = fpath_len;
-		goto err_config;
+		return fpath_len;
 	}
 
 	fpath = k_malloc(fpath_len);
 	if (!fpath) {
 		LOG_ERR("Unable to allocate fpath memory");
-		ret = -ENOMEM;
-		goto err_config;
+		return -ENOMEM;
 	}
 
 	ret = snprintf(fpath, fpath_len, "%s/%s", bundle, CONFIG_JSON_NAME);
 	if (ret <= 0) {
 		LOG_ERR("Unable to form file path: %d", ret);
 		k_free(fpath);
-		goto err_config;
+		return -EINVAL;
 	}
 
 	bytes_read = xrun_read_file(fpath, config,
 				    CONFIG_XRUN_JSON_SIZE_MAX, 0);
-	if (bytes_read < 0) {
-		LOG_ERR("Can't read config.json ret = %ld", bytes_read);
-		ret = bytes_read;
-		k_free(fpath);
-		goto err_config;
+	k_free(fpath);
+
+	return bytes_read;
+}
+
+#ifdef CONFIG_XRUN_DT_GENERATE
+/* Phandle of the guest GIC set by the toolstack, GUEST_PHANDLE_GIC */
+#define DT_GIC_PHANDLE 65000
+#define DT_GIC_SPI_BASE 32
+#define DT_IRQ_TYPE_LEVEL_HIGH 4
+#define DT_PROP_NAME_MAX 32
+
+static bool dt_has_irq(const struct xrun_hwconfig_spec *hw, uint32_t irq)
+{
+	size_t i;
+
+	for (i = 0; i < hw->irqs_len; i++) {
+		if (hw->irqs[i] == irq) {
+			return true;
+		}
 	}
 
-	k_free(fpath);
+	return false;
+}
 
-	ret = parse_config_json(config, bytes_read, &spec);
-	if (ret < 0) {
-		goto err_config;
+static bool dt_has_dtdev(const struct xrun_hwconfig_spec *hw, const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < hw->dtdevs_len; i++) {
+		if (!strcmp(hw->dtdevs[i], path)) {
+			return true;
+		}
 	}
 
-	ret = snprintf(container->kernel_image,
-		       CONFIG_XRUN_MAX_PATH_SIZE,
-		       "%s", spec.vm.kernel.path);
-	if (ret < strlen(spec.vm.kernel.path)) {
-		LOG_ERR("Unable to get kernel path, rc = %d", ret);
-		goto err_config;
+	return false;
+}
+
+static bool dt_has_node(const struct xrun_hwconfig_spec *hw, const char *path)
+{
+	size_t i;
+
+	for (i = 0; i < hw->dtNodes_len; i++) {
+		if (hw->dtNodes[i].path && !strcmp(hw->dtNodes[i].path, path)) {
+			return true;
+		}
 	}
 
-	container->has_dt_image = spec.vm.hwConfig.deviceTree &&
-		strlen(spec.vm.hwConfig.deviceTree) > 0;
+	return false;
+}
 
-	if (container->has_dt_image) {
-		ret = snprintf(container->dt_image,
-			       CONFIG_XRUN_MAX_PATH_SIZE,
-			       "%s", spec.vm.hwConfig.deviceTree);
-		if (ret < strlen(spec.vm.hwConfig.deviceTree)) {
-			LOG_ERR("Unable to get device-tree path, rc = %d", ret);
-			goto err_config;
+static int dt_add_props(struct xrun_fdt *fdt, const struct xrun_dt_node_spec *node)
+{
+	char name[DT_PROP_NAME_MAX];
+	const char *value;
+	size_t i, len;
+
+	for (i = 0; i < node->props_len; i++) {
+		value = strchr(node->props[i], '=');
+		if (!value) {
+			xrun_fdt_prop(fdt, node->props[i], NULL, 0);
+			continue;
+		}
+
+		len = value - node->props[i];
+		if (!len || len >= sizeof(name)) {
+			LOG_ERR("Invalid property %s of node %s",
+				node->props[i], node->name);
+			return -EINVAL;
 		}
+
+		memcpy(name, node->props[i], len);
+		name[len] = '\0';
+		xrun_fdt_prop_string(fdt, name, value + 1);
 	}
 
-	ret = generate_cmdline(&spec, &domcfg.cmdline);
-	if (ret < 0) {
-		goto err_config;
+	return 0;
+}
+
+static int dt_add_node(struct xrun_fdt *fdt, const struct xrun_hwconfig_spec *hw,
+		       const struct xrun_dt_node_spec *node)
+{
+	uint32_t reg[XRUN_DT_NODE_REGS_MAX * 4];
+	uint32_t irqs[XRUN_DT_NODE_IRQS_MAX * 3];
+	const struct xrun_iomem_spec *iomem;
+	uint64_t addr, size;
+	size_t i;
+
+	if (!node->name) {
+		LOG_ERR("Device-tree node without name");
+		return -EINVAL;
 	}
 
-	container->bundle = bundle;
-	container->status = RUNNING;
+	if (node->path && !dt_has_dtdev(hw, node->path)) {
+		LOG_ERR("Node %s path %s is not in dtdevs", node->name,
+			node->path);
+		return -EINVAL;
+	}
 
-	if (spec.vm.hwConfig.iomems_len) {
-		domcfg.iomems = giomems;
+	for (i = 0; i < node->reg_len; i++) {
+		if (node->reg[i] >= hw->iomems_len) {
+			LOG_ERR("Node %s reg %u is not in iomems", node->name,
+				node->reg[i]);
+			return -EINVAL;
+		}
+
+		/* Device is mapped to the guest at its GFN */
+		iomem = &hw->iomems[node->reg[i]];
+		addr = iomem->firstGFN * XRUN_PAGE_SIZE;
+		size = iomem->nrMFNs * XRUN_PAGE_SIZE;
+		reg[i * 4] = addr >> 32;
+		reg[i * 4 + 1] = (uint32_t)addr;
+		reg[i * 4 + 2] = size >> 32;
+		reg[i * 4 + 3] = (uint32_t)size;
 	}
 
-	if (spec.vm.hwConfig.dtdevs_len) {
-		domcfg.dtdevs = gdtdevs;
+	for (i = 0; i < node->interrupts_len; i++) {
+		if (node->interrupts[i] < DT_GIC_SPI_BASE ||
+		    !dt_has_irq(hw, node->interrupts[i])) {
+			LOG_ERR("Node %s interrupt %u is not in irqs",
+				node->name, node->interrupts[i]);
+			return -EINVAL;
+		}
+
+		/* GIC SPI cells: type, number and level-high trigger */
+		irqs[i * 3] = 0;
+		irqs[i * 3 + 1] = node->interrupts[i] - DT_GIC_SPI_BASE;
+		irqs[i * 3 + 2] = DT_IRQ_TYPE_LEVEL_HIGH;
 	}
 
-	if (spec.vm.hwConfig.irqs_len) {
-		domcfg.irqs = girqs;
+	xrun_fdt_begin_node(fdt, node->name);
+	if (node->compatible) {
+		xrun_fdt_prop_string(fdt, "compatible", node->compatible);
+	}
+	if (node->reg_len) {
+		xrun_fdt_prop_cells(fdt, "reg", reg, node->reg_len * 4);
+	}
+	if (node->interrupts_len) {
+		xrun_fdt_prop_cells(fdt, "interrupts", irqs,
+				    node->interrupts_len * 3);
+		xrun_fdt_prop_u32(fdt, "interrupt-parent", DT_GIC_PHANDLE);
 	}
+	if (node->path) {
+		xrun_fdt_prop_string(fdt, "xen,path", node->path);
+	}
+	if (dt_add_props(fdt, node)) {
+		return -EINVAL;
+	}
+	xrun_fdt_end_node(fdt);
 
-	LOG_DBG("domid = %lld", container->domid);
-	k_mutex_lock(&container_run_lock, K_FOREVER);
+	return 0;
+}
 
-	ret = fill_domcfg(&domcfg, &spec, container);
-	if (ret) {
-		k_mutex_unlock(&container_run_lock);
-		goto err_config;
+/*
+ * Builds the partial device-tree of the passthrough devices from the spec,
+ * so no device-tree file is read. The result is kept in the container and
+ * reused on restart.
+ */
+static int generate_dtb(struct container *container)
+{
+	const struct xrun_hwconfig_spec *hw = &container->spec.vm.hwConfig;
+	const char *name;
+	struct xrun_fdt fdt;
+	ssize_t size;
+	size_t i;
+	int ret;
+
+	xrun_fdt_init(&fdt, container->devicetree,
+		      sizeof(container->devicetree));
+	xrun_fdt_begin_node(&fdt, "");
+	xrun_fdt_prop_u32(&fdt, "#address-cells", 2);
+	xrun_fdt_prop_u32(&fdt, "#size-cells", 2);
+
+	xrun_fdt_begin_node(&fdt, "passthrough");
+	xrun_fdt_prop_string(&fdt, "compatible", "simple-bus");
+	xrun_fdt_prop(&fdt, "ranges", NULL, 0);
+	xrun_fdt_prop_u32(&fdt, "#address-cells", 2);
+	xrun_fdt_prop_u32(&fdt, "#size-cells", 2);
+
+	for (i = 0; i < hw->dtNodes_len; i++) {
+		ret = dt_add_node(&fdt, hw, &hw->dtNodes[i]);
+		if (ret) {
+			return ret;
+		}
 	}
 
-	ret = domain_create(&domcfg, container->domid);
-	if (ret < 0) {
-		k_mutex_unlock(&container_run_lock);
-		goto err_config;
+	/* Assigned devices without described node get a bare one */
+	for (i = 0; i < hw->dtdevs_len; i++) {
+		if (dt_has_node(hw, hw->dtdevs[i])) {
+			continue;
+		}
+
+		name = strrchr(hw->dtdevs[i], '/');
+		xrun_fdt_begin_node(&fdt, name ? name + 1 : hw->dtdevs[i]);
+		xrun_fdt_prop_string(&fdt, "xen,path", hw->dtdevs[i]);
+		xrun_fdt_end_node(&fdt);
 	}
 
-	ret = domain_post_create(&domcfg, container->domid);
+	xrun_fdt_end_node(&fdt);
+	xrun_fdt_end_node(&fdt);
 
-	k_free(config);
-	k_free(domcfg.cmdline);
-	k_mutex_unlock(&container_run_lock);
+	size = xrun_fdt_finish(&fdt);
+	if (size < 0) {
+		LOG_ERR("Unable to generate device-tree, rc = %ld", size);
+		return size;
+	}
 
-	return ret;
- err_config:
-	k_free(config);
- err:
-	k_free(domcfg.cmdline);
-	put_container(container);
- err_unlock:
-	k_mutex_unlock(&container_run_lock);
-	return ret;
+	container->dtb_size = size;
+	return 0;
 }
+#endif /* CONFIG_XRUN_DT_GENERATE */
 
-int xrun_pause(const char *container_id)
+/*
+ * Start reading of the device-tree in background, so it is read while
+ * kernel image is opened and domain configuration is prepared.
+ */
+static int prefetch_dtb(struct container *container)
 {
-	int ret = 0;
-	struct container *container = get_container(container_id);
+	int ret;
 
-	if (!container) {
-		return -EINVAL;
+	if (!container->has_dt_image ||
+	    in_archive(container, container->dt_image)) {
+		return 0;
 	}
-	k_mutex_lock(&container->lock, K_FOREVER);
 
-	ret = domain_pause(container->domid);
+	memset(&container->dtb_req, 0, sizeof(container->dtb_req));
+	container->dtb_req.fpath = container->dt_image;
+	container->dtb_req.buf = container->devicetree;
+	container->dtb_req.size = CONFIG_PARTIAL_DEVICE_TREE_SIZE;
+	if (container->throttled) {
+		container->dtb_req.budget = &container->io_budget;
+	}
+
+	ret = xrun_io_submit(&container->dtb_req, 1);
 	if (ret) {
-		goto out;
+		LOG_ERR("Unable to submit dtb read, rc = %d", ret);
+		return ret;
 	}
 
-	container->status = PAUSED;
-out:
-	k_mutex_unlock(&container->lock);
-	put_container(container);
-	return ret;
+	container->dtb_pending = true;
+	return 0;
 }
 
-int xrun_resume(const char *container_id)
+static void close_bundle(struct container *container)
 {
-	int ret = 0;
-	struct container *container = get_container(container_id);
+	/* Device-tree buffer should not be freed while it is being read */
+	if (container->dtb_pending) {
+		xrun_io_wait(&container->dtb_req, K_FOREVER);
+		container->dtb_pending = false;
+	}
 
-	if (!container) {
-		return -EINVAL;
+	xrun_stream_close(container->image);
+	container->image = NULL;
+	xrun_archive_close(container->archive);
+	container->archive = NULL;
+}
+
+#ifdef CONFIG_XRUN_CHECKPOINT
+/*
+ * domain_create() boots the guest, so checkpoint replaces RAM and vCPU
+ * state of the already running domain. Event channels, grant tables and
+ * xenstore entries are the ones of the new domain, so guests with PV
+ * backends or passthrough devices can't be checkpointed. Only memKB of
+ * RAM is saved, so ballooning is not supported either.
+ */
+static int check_checkpoint_spec(const struct xrun_domain_spec *spec)
+{
+	const struct xrun_hwconfig_spec *hw = &spec->vm.hwConfig;
+	int i;
+
+	for (i = 0; i < spec->vm.kernel.params_len; i++) {
+		if (is_backend_record(spec->vm.kernel.parameters[i])) {
+			LOG_ERR("Checkpoint of domain with PV backends");
+			return -ENOTSUP;
+		}
 	}
-	k_mutex_lock(&container->lock, K_FOREVER);
 
-	ret = domain_unpause(container->domid);
+	if (hw->dtdevs_len || hw->iomems_len || hw->irqs_len) {
+		LOG_ERR("Checkpoint of domain with passthrough devices");
+		return -ENOTSUP;
+	}
+
+	if ((hw->minMemKB && hw->minMemKB != hw->memKB) ||
+	    (hw->maxMemKB && hw->maxMemKB != hw->memKB)) {
+		LOG_ERR("Checkpoint of domain with balloon");
+		return -ENOTSUP;
+	}
+
+	return 0;
+}
+
+static int restore_checkpoint(struct container *container,
+			      const char *checkpoint)
+{
+	int ret, rc;
+
+	/* Domain shouldn't run until its memory and vCPUs are restored */
+	ret = domain_pause(container->domid);
 	if (ret) {
-		goto out;
+		LOG_ERR("Failed to pause domain %llu (%d)", container->domid, ret);
+		return ret;
 	}
 
-	container->status = RUNNING;
-out:
-	k_mutex_unlock(&container->lock);
-	put_container(container);
-	return ret;
+	ret = xrun_checkpoint_load(container->domid, container->mem_kb,
+				   container->vcpus, checkpoint);
+
+	rc = domain_unpause(container->domid);
+	if (rc) {
+		LOG_ERR("Failed to unpause domain %llu (%d)", container->domid, rc);
+	}
+
+	return ret ? ret : rc;
 }
+#endif /* CONFIG_XRUN_CHECKPOINT */
 
-int xrun_kill(const char *container_id)
+static int apply_affinity(struct container *container)
 {
-	int ret = 0;
-	struct container *container = get_container(container_id);
+	uint32_t i;
+	int ret;
 
-	if (!container) {
+	for (i = 0; i < container->vcpus; i++) {
+		if (!container->vcpu_affinity[i]) {
+			continue;
+		}
+
+		ret = xrun_hyp_set_vcpu_affinity(container->domid, i,
+						 container->vcpu_affinity[i]);
+		if (ret) {
+			LOG_ERR("Unable to pin vcpu %u of %s, rc = %d", i,
+				container->container_id, ret);
+			return ret;
+		}
+	}
+
+	return 0;
+}
+
+static int parse_restart_policy(struct container *container,
+				const struct xrun_restart_policy_spec *policy)
+{
+	if (!policy->name || !strcmp(policy->name, "no")) {
+		container->restart_policy = RESTART_NO;
+	} else if (!strcmp(policy->name, "on-failure")) {
+		container->restart_policy = RESTART_ON_FAILURE;
+	} else if (!strcmp(policy->name, "always")) {
+		container->restart_policy = RESTART_ALWAYS;
+	} else {
+		LOG_ERR("Unknown restart policy %s", policy->name);
 		return -EINVAL;
 	}
 
-	/* Put container twice to drop the last reference */
-	put_container(container);
-	put_container(container);
-	return ret;
+	container->max_retries = policy->maxRetries;
+	return 0;
 }
 
-int xrun_state(const char *container_id, enum container_status *state)
+static int open_image(struct container *container)
 {
-	struct container *container = get_container(container_id);
+	int ret;
 
-	if (!container) {
-		return -EINVAL;
+	if (is_bundle_archive(container->bundle) && !container->archive) {
+		ret = xrun_archive_open(container->bundle, &container->archive);
+		if (ret < 0) {
+			LOG_ERR("Can't open bundle archive ret = %d", ret);
+			return ret;
+		}
+	}
+
+	ret = open_bundle_stream(container, container->kernel_image,
+				 &container->image);
+	if (ret < 0) {
+		LOG_ERR("Unable to open kernel image, rc = %d", ret);
+		return ret;
+	}
+
+	/*
+	 * Every image chunk waits for the container budget, so the load is
+	 * spread over time. Throttled load holds the start gate longer.
+	 */
+	if (container->throttled) {
+		xrun_stream_set_budget(container->image, &container->io_budget);
 	}
 
-	*state = container->status;
-	put_container(container);
 	return 0;
 }
+
+#if CONFIG_XRUN_IMAGE_CACHE_SIZE > 0
+static void image_cache_commit(struct container *container)
+{
+	if (!container->image_cache || container->image_data) {
+		return;
+	}
+
+	/* Image is loaded in one pass, partial cache is useless */
+	if (container->image_cached == container->image_cache_size) {
+		container->image_data = container->image_cache;
+		container->image_data_size = container->image_cache_size;
+	} else {
+		k_free(container->image_cache);
+		container->image_cache = NULL;
+	}
+}
+#endif
+
+/*
+ * Creates domain from the configuration kept in container. Kernel image
+ * should be opened, unless it is cached. Domain is destroyed if the start
+ * fails once it is created.
+ */
+static int domain_start(struct container *container, const char *checkpoint)
+{
+	int64_t load_start;
+	int ret;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_START_GATE,
+			start_gate_acquire(&container->start));
+	load_start = k_uptime_get();
+
+	xrun_trace(XRUN_TRACE_CREATE_BEGIN, container->domid);
+	ret = domain_create(&container->domcfg, container->domid);
+	xrun_trace(XRUN_TRACE_CREATE_END, container->domid);
+	if (ret < 0) {
+		goto out;
+	}
+
+	container->domain_created = true;
+	container->load_time_ms = k_uptime_get() - load_start;
+#if CONFIG_XRUN_IMAGE_CACHE_SIZE > 0
+	image_cache_commit(container);
+#endif
+
+#ifdef CONFIG_XRUN_CHECKPOINT
+	/* Restored state replaces the booted guest as soon as possible */
+	if (checkpoint) {
+		ret = restore_checkpoint(container, checkpoint);
+		if (ret) {
+			goto err_destroy;
+		}
+	}
+#endif
+
+	ret = apply_affinity(container);
+	if (ret) {
+		goto err_destroy;
+	}
+
+	/* Defaults are left to the scheduler, which may have no weight */
+	if (container->sched_set) {
+		ret = xrun_hyp_set_sched(container->domid,
+					 container->sched_weight,
+					 container->sched_cap);
+		if (ret) {
+			goto err_destroy;
+		}
+	}
+
+	/* Allow domain to balloon up to the maximum memory */
+	if (container->max_mem_kb > container->mem_kb) {
+		ret = xrun_hyp_set_max_mem(container->domid,
+					   container->max_mem_kb);
+		if (ret) {
+			goto err_destroy;
+		}
+	}
+
+	log_image_stats(container);
+	/* Image is loaded to the domain memory and is not needed anymore */
+	close_bundle(container);
+
+	xrun_trace(XRUN_TRACE_POST_CREATE_BEGIN, container->domid);
+	ret = domain_post_create(&container->domcfg, container->domid);
+	xrun_trace(XRUN_TRACE_POST_CREATE_END, container->domid);
+	if (ret) {
+		goto err_destroy;
+	}
+
+#ifdef CONFIG_XRUN_CONSOLE
+	if (container->console_socket > 0) {
+		ret = xrun_console_start(container->domid,
+					 container->console_socket);
+		if (ret) {
+			LOG_ERR("Unable to forward console of %s, rc = %d",
+				container->container_id, ret);
+			goto err_destroy;
+		}
+	}
+#endif
+
+	start_gate_release();
+	return 0;
+
+err_destroy:
+	/* Failed start shouldn't leave the domain running */
+	if (domain_destroy(container->domid)) {
+		LOG_ERR("Failed to destroy domain %llu", container->domid);
+	} else {
+		container->domain_created = false;
+	}
+out:
+	start_gate_release();
+	return ret;
+}
+
+/*
+ * Prepares domain configuration from the container spec and starts the
+ * domain. Container is not released on error.
+ */
+static int container_start(struct container *container, int console_socket,
+			   const char *checkpoint)
+{
+	struct xrun_domain_spec *spec = &container->spec;
+	struct xen_domain_cfg *domcfg = &container->domcfg;
+	int ret;
+
+	ret = parse_restart_policy(container, &spec->vm.restartPolicy);
+	if (ret < 0) {
+		return ret;
+	}
+
+#ifdef CONFIG_XRUN_CHECKPOINT
+	if (checkpoint) {
+		ret = check_checkpoint_spec(spec);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+#endif
+
+#ifdef CONFIG_XRUN_ADMISSION
+	/* Fail before any image is read if the domain doesn't fit */
+	ret = admission_reserve(container);
+	if (ret < 0) {
+		return ret;
+	}
+#endif
+
+	/* Embedded kernel image is not read from storage */
+	if (!container->image_data) {
+		ret = snprintf(container->kernel_image,
+			       CONFIG_XRUN_MAX_PATH_SIZE,
+			       "%s", spec->vm.kernel.path);
+		if (ret < strlen(spec->vm.kernel.path)) {
+			LOG_ERR("Unable to get kernel path, rc = %d", ret);
+			return ret < 0 ? ret : -ENAMETOOLONG;
+		}
+	}
+
+	container->has_dt_image = !container->dtb_size &&
+		spec->vm.hwConfig.deviceTree &&
+		strlen(spec->vm.hwConfig.deviceTree) > 0;
+
+	if (container->has_dt_image) {
+		ret = snprintf(container->dt_image,
+			       CONFIG_XRUN_MAX_PATH_SIZE,
+			       "%s", spec->vm.hwConfig.deviceTree);
+		if (ret < strlen(spec->vm.hwConfig.deviceTree)) {
+			LOG_ERR("Unable to get device-tree path, rc = %d", ret);
+			return ret < 0 ? ret : -ENAMETOOLONG;
+		}
+	}
+
+	if (spec->vm.ioRateKBps) {
+		xrun_io_budget_init(&container->io_budget,
+				    KB(spec->vm.ioRateKBps),
+				    KB(CONFIG_XRUN_IO_BURST));
+		container->throttled = true;
+
+		/* config.json is read before the rate is known */
+		xrun_io_budget_charge(&container->io_budget,
+				      container->config_size);
+	}
+
+#ifdef CONFIG_XRUN_DT_GENERATE
+	if (!container->has_dt_image && !container->dtb_size &&
+	    spec->vm.hwConfig.dtNodes_len) {
+		ret = generate_dtb(container);
+		if (ret < 0) {
+			return ret;
+		}
+	}
+#endif
+
+	/* Trace end is emitted on error too, so events stay paired */
+	xrun_trace(XRUN_TRACE_OPEN_BEGIN, container->domid);
+	ret = prefetch_dtb(container);
+	if (!ret) {
+		ret = generate_cmdline(spec, domcfg, container);
+	}
+
+	if (!ret && !container->image_data) {
+		ret = open_image(container);
+	}
+	xrun_trace(XRUN_TRACE_OPEN_END, container->domid);
+	if (ret < 0) {
+		return ret;
+	}
+
+	container->console_socket = console_socket;
+
+	if (spec->vm.hwConfig.iomems_len) {
+		domcfg->iomems = container->iomems;
+	}
+
+	if (spec->vm.hwConfig.dtdevs_len) {
+		domcfg->dtdevs = container->dtdevs;
+	}
+
+	if (spec->vm.hwConfig.irqs_len) {
+		domcfg->irqs = container->irqs;
+	}
+
+	LOG_DBG("domid = %lld", container->domid);
+	container->start.priority = spec->vm.priority;
+
+	ret = fill_domcfg(domcfg, spec, container);
+	if (ret) {
+		return ret;
+	}
+
+	ret = domain_start(container, checkpoint);
+	if (ret < 0) {
+		return ret;
+	}
+
+	container->status = RUNNING;
+	container->start_time = k_uptime_get();
+#ifdef CONFIG_XRUN_ADMISSION
+	admission_commit(container);
+#endif
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	container->ready = true;
+	k_mutex_unlock(&container_lock);
+	return 0;
+}
+
+static int container_run(const char *bundle, int console_socket,
+			 const char *container_id, const char *checkpoint)
+{
+	int ret = 0;
+	ssize_t bytes_read;
+	struct container *container;
+
+	/* Don't allow empty (first char is \0) or null container_id */
+	if (!container_id || !*container_id) {
+		return -EINVAL;
+	}
+
+	/* Don't allow empty or null bundle */
+	if (!bundle || !*bundle) {
+		return -EINVAL;
+	}
+
+	ret = register_container_id(container_id, &container);
+	if (ret) {
+		return ret;
+	}
+
+	xrun_trace(XRUN_TRACE_RUN_BEGIN, container->domid);
+	ret = snprintf(container->bundle, CONFIG_XRUN_MAX_PATH_SIZE, "%s",
+		       bundle);
+	if (ret >= CONFIG_XRUN_MAX_PATH_SIZE) {
+		LOG_ERR("Bundle path is too long");
+		ret = -ENAMETOOLONG;
+		goto err;
+	}
+
+	container->config = k_malloc(CONFIG_XRUN_JSON_SIZE_MAX);
+	if (!container->config) {
+		ret = -ENOMEM;
+		goto err;
+	}
+
+	if (is_bundle_archive(bundle)) {
+		ret = xrun_archive_open(bundle, &container->archive);
+		if (ret < 0) {
+			LOG_ERR("Can't open bundle archive ret = %d", ret);
+			goto err;
+		}
+	}
+
+	xrun_trace(XRUN_TRACE_CONFIG_BEGIN, container->domid);
+	bytes_read = read_config(container, bundle, container->config);
+	xrun_trace(XRUN_TRACE_CONFIG_END, container->domid);
+	if (bytes_read < 0) {
+		LOG_ERR("Can't read config.json ret = %ld", bytes_read);
+		ret = bytes_read;
+		goto err;
+	}
+	container->config_size = bytes_read;
+
+	xrun_trace(XRUN_TRACE_PARSE_BEGIN, container->domid);
+	ret = parse_config_json(container->config, bytes_read,
+				&container->spec);
+	xrun_trace(XRUN_TRACE_PARSE_END, container->domid);
+	if (ret < 0) {
+		goto err;
+	}
+
+	ret = container_start(container, console_socket, checkpoint);
+	if (ret < 0) {
+		goto err;
+	}
+
+	xrun_trace(XRUN_TRACE_RUN_END, container->domid);
+	put_container(container);
+	return ret;
+ err:
+	xrun_trace(XRUN_TRACE_RUN_END, container->domid);
+	close_bundle(container);
+	unregister_container(container);
+	put_container(container);
+	return ret;
+}
+
+int xrun_run(const char *bundle, int console_socket, const char *container_id)
+{
+	return container_run(bundle, console_socket, container_id, NULL);
+}
+
+#ifdef CONFIG_XRUN_CHECKPOINT
+int xrun_restore(const char *bundle, const char *checkpoint,
+		 int console_socket, const char *container_id)
+{
+	if (!checkpoint || !*checkpoint) {
+		return -EINVAL;
+	}
+
+	return container_run(bundle, console_socket, container_id, checkpoint);
+}
+#endif /* CONFIG_XRUN_CHECKPOINT */
+
+#ifdef CONFIG_XRUN_STATIC
+int xrun_run_static(const char *name, int console_socket)
+{
+	const struct xrun_static_container *def = NULL;
+	struct container *container;
+	int ret;
+
+	if (!name) {
+		return -EINVAL;
+	}
+
+	STRUCT_SECTION_FOREACH(xrun_static_container, entry) {
+		if (!strcmp(entry->name, name)) {
+			def = entry;
+			break;
+		}
+	}
+
+	if (!def) {
+		LOG_ERR("Static container %s is not defined", name);
+		return -ENOENT;
+	}
+
+	ret = register_container_id(def->name, &container);
+	if (ret) {
+		return ret;
+	}
+
+	xrun_trace(XRUN_TRACE_RUN_BEGIN, container->domid);
+	/* Spec is complete at build time, nothing is read or parsed */
+	memcpy(&container->spec, &def->spec, sizeof(container->spec));
+
+	if (def->kernel) {
+		container->image_data = def->kernel;
+		container->image_data_size = def->kernel_size;
+	}
+
+	if (def->dtb) {
+		if (def->dtb_size > sizeof(container->devicetree)) {
+			LOG_ERR("Device-tree of %s is too big", name);
+			ret = -E2BIG;
+			goto err;
+		}
+
+		memcpy(container->devicetree, def->dtb, def->dtb_size);
+		container->dtb_size = def->dtb_size;
+	}
+
+	ret = container_start(container, console_socket, NULL);
+	if (ret < 0) {
+		goto err;
+	}
+
+	xrun_trace(XRUN_TRACE_RUN_END, container->domid);
+	put_container(container);
+	return 0;
+ err:
+	xrun_trace(XRUN_TRACE_RUN_END, container->domid);
+	close_bundle(container);
+	unregister_container(container);
+	put_container(container);
+	return ret;
+}
+#endif /* CONFIG_XRUN_STATIC */
+
+#ifdef CONFIG_XRUN_CHECKPOINT
+int xrun_checkpoint(const char *container_id, const char *checkpoint)
+{
+	int ret, rc;
+	bool paused = false;
+	struct container *container;
+
+	if (!checkpoint || !*checkpoint) {
+		return -EINVAL;
+	}
+
+	container = get_container(container_id);
+	if (!container) {
+		return -EINVAL;
+	}
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	ret = check_checkpoint_spec(&container->spec);
+	if (ret) {
+		goto out;
+	}
+
+	if (container->status == RUNNING) {
+		ret = domain_pause(container->domid);
+		if (ret) {
+			goto out;
+		}
+		paused = true;
+	}
+
+	ret = xrun_checkpoint_save(container->domid, container->mem_kb,
+				   container->vcpus, checkpoint);
+
+	if (paused) {
+		rc = domain_unpause(container->domid);
+		if (rc) {
+			LOG_ERR("Failed to unpause domain %llu (%d)",
+				container->domid, rc);
+			ret = ret ? ret : rc;
+		}
+	}
+out:
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+#endif /* CONFIG_XRUN_CHECKPOINT */
+
+int xrun_pause(const char *container_id)
+{
+	int ret = 0;
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	if (container->status == STOPPING) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = domain_pause(container->domid);
+	if (ret) {
+		goto out;
+	}
+
+	container->status = PAUSED;
+out:
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+int xrun_resume(const char *container_id)
+{
+	int ret = 0;
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	if (container->status == STOPPING) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	ret = domain_unpause(container->domid);
+	if (ret) {
+		goto out;
+	}
+
+	container->status = RUNNING;
+out:
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+/* Recreates domain of the container, container lock should be held */
+static int container_restart(struct container *container)
+{
+	int ret;
+
+	/* Container is registered, but its start has not finished yet */
+	if (!container->ready || container->status == STOPPING) {
+		return -EBUSY;
+	}
+
+#ifdef CONFIG_XRUN_CONSOLE
+	if (container->console_socket > 0) {
+		xrun_console_stop(container->domid);
+	}
+#endif
+	ret = domain_destroy(container->domid);
+	if (ret) {
+		LOG_ERR("Failed to destroy domain %llu", container->domid);
+		return ret;
+	}
+	container->domain_created = false;
+	container->status = DESTROYED;
+
+	/* Domain id is reused, so the old domain should be gone first */
+	ret = xrun_hyp_wait_destroyed(container->domid,
+				      CONFIG_XRUN_DESTROY_TIMEOUT_MS);
+	if (ret) {
+		return ret;
+	}
+
+	if (!container->image_data) {
+		ret = open_image(container);
+		if (ret) {
+			return ret;
+		}
+	}
+
+	ret = domain_start(container, NULL);
+	if (ret) {
+		LOG_ERR("Failed to restart %s (%d)", container->container_id,
+			ret);
+		close_bundle(container);
+		return ret;
+	}
+
+	container->status = RUNNING;
+	container->start_time = k_uptime_get();
+	container->restarts++;
+	return 0;
+}
+
+int xrun_restart(const char *container_id)
+{
+	int ret = 0;
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	ret = container_restart(container);
+
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+#ifdef CONFIG_XRUN_SUPERVISOR
+/*
+ * Supervisor learns about domain exits from VIRQ_DOM_EXC and restarts
+ * containers according to their restart policy. Restarts are delayed
+ * with exponential backoff, so crash looping container doesn't starve
+ * others.
+ */
+static struct k_work_q supervisor_wq;
+static K_THREAD_STACK_DEFINE(supervisor_stack,
+			     CONFIG_XRUN_SUPERVISOR_STACK_SIZE);
+
+static void supervisor_scan(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(supervisor_scan_work, supervisor_scan);
+
+static uint32_t supervisor_backoff_ms(uint32_t retries)
+{
+	uint64_t delay = (uint64_t)CONFIG_XRUN_RESTART_BACKOFF_MS <<
+			 MIN(retries, 16);
+
+	return MIN(delay, CONFIG_XRUN_RESTART_BACKOFF_MAX_MS);
+}
+
+/* Called with container_lock and container lock held */
+static void supervisor_handle_exit(struct container *container,
+				   enum xrun_hyp_exit exit)
+{
+	bool failure = exit != XRUN_HYP_EXIT_POWEROFF;
+	uint32_t delay;
+	int ret;
+
+	container->status = DESTROYED;
+	if (failure) {
+		container->crashes++;
+	}
+
+	if (container->restart_policy == RESTART_NO ||
+	    (container->restart_policy == RESTART_ON_FAILURE && !failure)) {
+		LOG_INF("Container %s has exited (%d)",
+			container->container_id, exit);
+		return;
+	}
+
+	/* Domain which ran long enough is not crash looping */
+	if (k_uptime_get() - container->start_time >=
+	    CONFIG_XRUN_RESTART_STABLE_MS) {
+		container->retries = 0;
+	}
+
+	if (container->max_retries &&
+	    container->retries >= container->max_retries) {
+		LOG_ERR("Container %s is crash looping, %u retries done",
+			container->container_id, container->retries);
+		return;
+	}
+
+	/* Killed container is detached, its restart work can't be queued */
+	if (container->killed || container->restart_pending) {
+		return;
+	}
+
+	delay = supervisor_backoff_ms(container->retries);
+	container->retries++;
+	LOG_INF("Restarting container %s in %u ms (%d)",
+		container->container_id, delay, exit);
+
+	/* Caller holds a reference, so the pending one is not the last */
+	container->refcount++;
+	container->restart_pending = true;
+	ret = k_work_schedule_for_queue(&supervisor_wq,
+					&container->restart_work,
+					K_MSEC(delay));
+	if (ret < 0) {
+		LOG_ERR("Unable to schedule restart of %s (%d)",
+			container->container_id, ret);
+		container->restart_pending = false;
+		container->refcount--;
+	}
+}
+
+static void supervisor_scan(struct k_work *work)
+{
+	struct container *container;
+	enum xrun_hyp_exit exit;
+	bool busy = false;
+	int ret;
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	SYS_SLIST_FOR_EACH_CONTAINER(&container_list, container, node) {
+		if (!container->ready || container->killed ||
+		    container->status == DESTROYED) {
+			continue;
+		}
+
+		/* Don't wait for long operations with the registry locked */
+		if (k_mutex_lock(&container->lock, K_NO_WAIT)) {
+			busy = true;
+			continue;
+		}
+
+		ret = xrun_hyp_get_exit(container->domid, &exit);
+		if (!ret && exit != XRUN_HYP_EXIT_NONE &&
+		    container->status != DESTROYED) {
+			supervisor_handle_exit(container, exit);
+		}
+		k_mutex_unlock(&container->lock);
+	}
+	k_mutex_unlock(&container_lock);
+
+	/* Check skipped containers later, so their exit is not missed */
+	if (busy) {
+		k_work_schedule_for_queue(&supervisor_wq, &supervisor_scan_work,
+					  K_MSEC(CONFIG_XRUN_RESTART_BACKOFF_MS));
+	}
+}
+
+static void supervisor_restart(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct container *container =
+		CONTAINER_OF(dwork, struct container, restart_work);
+	bool pending;
+	int ret;
+
+	/* Reference is owned by the one who clears the pending flag */
+	k_mutex_lock(&container_lock, K_FOREVER);
+	pending = container->restart_pending;
+	container->restart_pending = false;
+	k_mutex_unlock(&container_lock);
+	if (!pending) {
+		return;
+	}
+
+	k_mutex_lock(&container->lock, K_FOREVER);
+	if (!container->killed && container->status == DESTROYED) {
+		ret = container_restart(container);
+		if (ret) {
+			/*
+			 * Failed restart is handled as one more crash, it
+			 * shouldn't be taken for a stable run.
+			 */
+			container->start_time = k_uptime_get();
+			k_mutex_lock(&container_lock, K_FOREVER);
+			supervisor_handle_exit(container, XRUN_HYP_EXIT_CRASH);
+			k_mutex_unlock(&container_lock);
+		}
+	}
+	k_mutex_unlock(&container->lock);
+
+	put_container(container);
+}
+
+static void supervisor_dom_exc(void *priv)
+{
+	k_work_reschedule_for_queue(&supervisor_wq, &supervisor_scan_work,
+				    K_NO_WAIT);
+}
+
+/* Stops supervision of the container, so it can be destroyed */
+static void supervisor_detach(struct container *container)
+{
+	struct k_work_sync sync;
+	bool pending;
+
+	k_mutex_lock(&container_lock, K_FOREVER);
+	container->killed = true;
+	pending = container->restart_pending;
+	container->restart_pending = false;
+	k_mutex_unlock(&container_lock);
+
+	/* Work item should be idle before container is freed */
+	k_work_cancel_delayable_sync(&container->restart_work, &sync);
+	if (pending) {
+		put_container(container);
+	}
+}
+
+static void supervisor_init(void)
+{
+	k_work_queue_start(&supervisor_wq, supervisor_stack,
+			   K_THREAD_STACK_SIZEOF(supervisor_stack),
+			   K_PRIO_PREEMPT(CONFIG_XRUN_SUPERVISOR_THREAD_PRIO),
+			   NULL);
+	k_thread_name_set(&supervisor_wq.thread, "xrun_supervisor");
+}
+#endif /* CONFIG_XRUN_SUPERVISOR */
+
+/*
+ * Threads waiting for domain exits are woken on VIRQ_DOM_EXC and check
+ * their domains again, as the event doesn't tell which domain exited.
+ */
+struct exit_waiter {
+	sys_snode_t node;
+	struct k_sem sem;
+};
+
+static struct k_spinlock exit_waiters_lock;
+static sys_slist_t exit_waiters = SYS_SLIST_STATIC_INIT(&exit_waiters);
+
+static void dom_exc_handler(void *priv)
+{
+	k_spinlock_key_t key = k_spin_lock(&exit_waiters_lock);
+	struct exit_waiter *waiter;
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&exit_waiters, waiter, node) {
+		k_sem_give(&waiter->sem);
+	}
+	k_spin_unlock(&exit_waiters_lock, key);
+
+#ifdef CONFIG_XRUN_SUPERVISOR
+	supervisor_dom_exc(priv);
+#endif
+}
+
+/* Returns true if the domain has shut down before the deadline */
+static bool wait_domain_exit(uint64_t domid, int64_t deadline)
+{
+	struct exit_waiter waiter;
+	enum xrun_hyp_exit exit;
+	k_spinlock_key_t key;
+	int64_t remaining;
+	bool exited = false;
+
+	k_sem_init(&waiter.sem, 0, 1);
+	key = k_spin_lock(&exit_waiters_lock);
+	sys_slist_append(&exit_waiters, &waiter.node);
+	k_spin_unlock(&exit_waiters_lock, key);
+
+	for (;;) {
+		if (xrun_hyp_get_exit(domid, &exit)) {
+			break;
+		}
+
+		if (exit != XRUN_HYP_EXIT_NONE) {
+			exited = true;
+			break;
+		}
+
+		remaining = deadline - k_uptime_get();
+		if (remaining <= 0) {
+			break;
+		}
+
+		k_sem_take(&waiter.sem, K_MSEC(remaining));
+	}
+
+	key = k_spin_lock(&exit_waiters_lock);
+	sys_slist_find_and_remove(&exit_waiters, &waiter.node);
+	k_spin_unlock(&exit_waiters_lock, key);
+
+	return exited;
+}
+
+static int dom_exc_init(void)
+{
+#ifdef CONFIG_XRUN_SUPERVISOR
+	/* Work queue should be ready before the first event */
+	supervisor_init();
+#endif
+
+	return xrun_hyp_bind_dom_exc(dom_exc_handler, NULL);
+}
+
+SYS_INIT(dom_exc_init, APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY);
+
+int xrun_kill(const char *container_id)
+{
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+
+	/* Start uses the container till it is ready */
+	if (container_starting(container)) {
+		put_container(container);
+		return -EBUSY;
+	}
+
+#ifdef CONFIG_XRUN_SUPERVISOR
+	supervisor_detach(container);
+#endif
+	/*
+	 * Container being stopped is destroyed once the stop is over, as
+	 * it holds a reference.
+	 */
+	unregister_container(container);
+	put_container(container);
+	return 0;
+}
+
+static struct xrun_stop_stats stop_stats;
+
+int xrun_stop(const char *container_id, uint32_t timeout_ms)
+{
+	struct container *container = get_container(container_id);
+	int64_t start = k_uptime_get();
+	bool forced = true;
+	uint32_t time_ms;
+	int ret;
+
+	if (!container) {
+		return -EINVAL;
+	}
+
+	if (container_starting(container)) {
+		put_container(container);
+		return -EBUSY;
+	}
+
+	k_mutex_lock(&container->lock, K_FOREVER);
+	if (container->status == STOPPING) {
+		k_mutex_unlock(&container->lock);
+		put_container(container);
+		return -EALREADY;
+	}
+
+	/* Paused domain can't handle the request, it is destroyed at once */
+	if (container->status == RUNNING && timeout_ms) {
+		container->status = STOPPING;
+		forced = false;
+	}
+	k_mutex_unlock(&container->lock);
+
+#ifdef CONFIG_XRUN_SUPERVISOR
+	/* Domain which has shut down must not be restarted */
+	supervisor_detach(container);
+#endif
+
+	if (!forced) {
+		ret = xrun_hyp_request_shutdown(container->domid);
+		forced = ret || !wait_domain_exit(container->domid,
+						  start + timeout_ms);
+	}
+
+	/* Registry reference may be dropped by xrun_kill already */
+	unregister_container(container);
+	ret = put_container(container);
+
+	time_ms = k_uptime_get() - start;
+	LOG_INF("Container %s %s in %u ms", container_id,
+		forced ? "destroyed" : "shut down", time_ms);
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	stop_stats.stops++;
+	if (forced) {
+		stop_stats.forced++;
+	}
+	stop_stats.last_ms = time_ms;
+	stop_stats.max_ms = MAX(stop_stats.max_ms, time_ms);
+	stop_stats.total_ms += time_ms;
+	k_mutex_unlock(&container_lock);
+
+	return ret;
+}
+
+int xrun_get_stop_stats(struct xrun_stop_stats *stats)
+{
+	if (!stats) {
+		return -EINVAL;
+	}
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	*stats = stop_stats;
+	k_mutex_unlock(&container_lock);
+
+	return 0;
+}
+
+/*
+ * Containers of xrun_kill_all are detached from the registry at once and
+ * torn down in parallel by the kill workers.
+ */
+struct kill_all_ctx {
+	sys_slist_t list;
+	size_t next;
+	int64_t deadline;
+	struct xrun_kill_result *results;
+	size_t count;
+	struct k_mutex lock;
+};
+
+/* Only one teardown is run at a time, workers are shared */
+XRUN_POOL_DEFINE(kill_pool, CONFIG_XRUN_KILL_THREADS,
+		 CONFIG_XRUN_KILL_STACK_SIZE);
+
+static void kill_worker(void *p1, void *p2, void *p3)
+{
+	struct kill_all_ctx *ctx = p1;
+	struct xrun_kill_result result;
+	struct container *container;
+	int64_t start;
+	size_t idx;
+
+	for (;;) {
+		k_mutex_lock(&ctx->lock, K_FOREVER);
+		container = SYS_SLIST_PEEK_HEAD_CONTAINER(&ctx->list, container,
+							  node);
+		if (container) {
+			sys_slist_get(&ctx->list);
+			idx = ctx->next++;
+		}
+		k_mutex_unlock(&ctx->lock);
+
+		if (!container) {
+			return;
+		}
+
+		start = k_uptime_get();
+		memset(&result, 0, sizeof(result));
+		strncpy(result.container_id, container->container_id,
+			CONTAINER_NAME_SIZE);
+		/* Only running domains were asked to shut down */
+		result.forced = container->status != RUNNING ||
+			!wait_domain_exit(container->domid, ctx->deadline);
+
+		/* Drop the kill and the registry references */
+		put_container(container);
+		result.result = put_container(container);
+		result.time_ms = k_uptime_get() - start;
+
+		if (result.result) {
+			LOG_ERR("Failed to kill %s (%d)", result.container_id,
+				result.result);
+		}
+
+		if (idx < ctx->count) {
+			ctx->results[idx] = result;
+		}
+	}
+}
+
+ssize_t xrun_kill_all(uint32_t timeout_ms, struct xrun_kill_result *results,
+		      size_t count)
+{
+	struct kill_all_ctx ctx = {
+		.results = results,
+		.count = count,
+	};
+	struct container *container, *next;
+	int64_t start = k_uptime_get();
+	int ret;
+
+	if (!results && count) {
+		return -EINVAL;
+	}
+
+	sys_slist_init(&ctx.list);
+	k_mutex_init(&ctx.lock);
+
+	/* New lookups fail from now on, domains are destroyed by workers */
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	SYS_SLIST_FOR_EACH_CONTAINER_SAFE(&container_list, container, next,
+					  node) {
+		/* Starting containers are left to their start */
+		if (!container->ready) {
+			LOG_WRN("Container %s is starting, not killed",
+				container->container_id);
+			continue;
+		}
+
+		sys_slist_find_and_remove(&container_list, &container->node);
+		container->refcount++;
+		/* Registry reference is dropped by the kill worker */
+		container->removed = true;
+		sys_slist_append(&ctx.list, &container->node);
+	}
+	k_mutex_unlock(&container_lock);
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&ctx.list, container, node) {
+#ifdef CONFIG_XRUN_SUPERVISOR
+		/* Domain which has shut down must not be restarted */
+		supervisor_detach(container);
+#endif
+		/* Ask all domains at once, so they shut down in parallel */
+		if (timeout_ms && container->status == RUNNING) {
+			ret = xrun_hyp_request_shutdown(container->domid);
+			if (ret) {
+				LOG_WRN("Can't request shutdown of %s (%d)",
+					container->container_id, ret);
+			}
+		}
+	}
+	ctx.deadline = k_uptime_get() + timeout_ms;
+
+	xrun_pool_run(&kill_pool, kill_worker, &ctx);
+
+	LOG_INF("%zu containers killed in %lld ms", ctx.next,
+		k_uptime_get() - start);
+	return ctx.next;
+}
+
+int xrun_state(const char *container_id, enum container_status *state)
+{
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+
+	*state = container->status;
+	put_container(container);
+	return 0;
+}
+
+int xrun_get_domid(const char *container_id, uint64_t *domid)
+{
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+
+	*domid = container->domid;
+	put_container(container);
+	return 0;
+}
+
+int xrun_set_memory(const char *container_id, uint64_t mem_kb)
+{
+	int ret;
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	if (container->status == DESTROYED) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (mem_kb < container->min_mem_kb || mem_kb > container->max_mem_kb) {
+		LOG_ERR("Memory %llu KB is out of [%llu, %llu] range for %s",
+			mem_kb, container->min_mem_kb, container->max_mem_kb,
+			container_id);
+		ret = -ERANGE;
+		goto out;
+	}
+
+	ret = xrun_hyp_set_mem_target(container->domid, mem_kb);
+	if (ret) {
+		goto out;
+	}
+
+	container->target_mem_kb = mem_kb;
+out:
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+int xrun_set_affinity(const char *container_id, int vcpu, uint32_t cpumask)
+{
+	int ret = 0;
+	uint32_t i;
+	struct container *container;
+
+	if (!cpumask) {
+		return -EINVAL;
+	}
+
+	container = get_container(container_id);
+	if (!container) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	if (container->status == DESTROYED || vcpu >= (int)container->vcpus) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	for (i = 0; i < container->vcpus; i++) {
+		if (vcpu >= 0 && i != (uint32_t)vcpu) {
+			continue;
+		}
+
+		ret = xrun_hyp_set_vcpu_affinity(container->domid, i, cpumask);
+		if (ret) {
+			goto out;
+		}
+
+		container->vcpu_affinity[i] = cpumask;
+	}
+out:
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+int xrun_set_sched(const char *container_id, uint32_t weight, uint32_t cap)
+{
+	int ret;
+	struct container *container = get_container(container_id);
+
+	if (!container) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	if (container->status == DESTROYED) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	ret = check_sched(weight, cap, container->vcpus);
+	if (ret) {
+		goto out;
+	}
+
+	ret = xrun_hyp_set_sched(container->domid, weight, cap);
+	if (ret) {
+		goto out;
+	}
+
+	container->sched_weight = weight;
+	container->sched_cap = cap;
+	container->sched_set = true;
+out:
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+int xrun_get_memory(const char *container_id, uint64_t *cur_kb,
+		    uint64_t *target_kb)
+{
+	int ret = 0;
+	struct container *container;
+
+	if (!cur_kb || !target_kb) {
+		return -EINVAL;
+	}
+
+	container = get_container(container_id);
+	if (!container) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&container->lock, K_FOREVER);
+
+	ret = xrun_hyp_get_mem(container->domid, cur_kb);
+	*target_kb = container->target_mem_kb;
+
+	k_mutex_unlock(&container->lock);
+	put_container(container);
+	return ret;
+}
+
+ssize_t xrun_list(struct xrun_container_info *info, size_t count)
+{
+	struct container *container;
+	int64_t now = k_uptime_get();
+	ssize_t total = 0;
+
+	if (!info && count) {
+		return -EINVAL;
+	}
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&container_list, container, node) {
+		if (total < count) {
+			strncpy(info[total].container_id, container->container_id,
+				CONTAINER_NAME_SIZE);
+			info[total].domid = container->domid;
+			info[total].status = container->status;
+			info[total].uptime_ms = (container->status == DESTROYED) ?
+				0 : now - container->start_time;
+			info[total].mem_kb = container->mem_kb;
+			info[total].target_mem_kb = container->target_mem_kb;
+			info[total].vcpus = container->vcpus;
+			info[total].sched_weight = container->sched_weight;
+			info[total].sched_cap = container->sched_cap;
+			info[total].image_size = container->image_size;
+			info[total].load_time_ms = container->load_time_ms;
+			info[total].load_rate = container->load_rate;
+			info[total].restarts = container->restarts;
+			info[total].crashes = container->crashes;
+			info[total].retries = container->retries;
+#ifdef CONFIG_XRUN_ADMISSION
+			info[total].reserved_mem_kb = container->reserved_mem_kb;
+#endif
+		}
+		total++;
+	}
+
+	k_mutex_unlock(&container_lock);
+	return total;
+}
+
+#ifdef CONFIG_XRUN_ADMISSION
+int xrun_set_group_limit(const char *group, uint64_t mem_kb, uint32_t vcpus)
+{
+	struct admission_group *entry;
+	int ret = 0;
+
+	if (!group || !*group) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&admission_lock, K_FOREVER);
+	entry = admission_group_get(group, true);
+	if (!entry) {
+		ret = -ENOSPC;
+		goto out;
+	}
+
+	/* Reservations above the new limit are kept, new starts are refused */
+	entry->mem_limit_kb = mem_kb;
+	entry->vcpus_limit = vcpus;
+	admission_group_put(entry);
+	/* Raised limit may admit waiting starts */
+	k_condvar_broadcast(&admission_cond);
+out:
+	k_mutex_unlock(&admission_lock);
+	return ret;
+}
+
+int xrun_get_admission(const char *group, struct xrun_admission_info *info)
+{
+	struct admission_group *entry = NULL;
+	struct container *container;
+	uint32_t nr_cpus;
+	uint64_t mem_kb;
+	int ret;
+
+	if (!info) {
+		return -EINVAL;
+	}
+
+	memset(info, 0, sizeof(*info));
+	ret = xrun_hyp_get_physinfo(&info->free_mem_kb, &nr_cpus);
+	if (ret) {
+		return ret;
+	}
+
+	xrun_trace_lock(XRUN_TRACE_LOCK_CONTAINERS,
+			k_mutex_lock(&container_lock, K_FOREVER));
+	k_mutex_lock(&admission_lock, K_FOREVER);
+
+	if (group) {
+		entry = admission_group_get(group, false);
+		if (!entry) {
+			ret = -ENOENT;
+			goto out;
+		}
+
+		info->reserved_mem_kb = entry->reserved_mem_kb;
+		info->reserved_vcpus = entry->reserved_vcpus;
+		info->mem_limit_kb = entry->mem_limit_kb;
+		info->vcpus_limit = entry->vcpus_limit;
+	} else {
+		info->reserved_mem_kb = admission_reserved_kb;
+		info->reserved_vcpus = admission_reserved_vcpus;
+		info->vcpus_limit = nr_cpus * CONFIG_XRUN_ADMISSION_VCPU_RATIO;
+	}
+
+	SYS_SLIST_FOR_EACH_CONTAINER(&container_list, container, node) {
+		if ((entry && container->group != entry) ||
+		    container->status == DESTROYED) {
+			continue;
+		}
+
+		if (!xrun_hyp_get_mem(container->domid, &mem_kb)) {
+			info->used_mem_kb += mem_kb;
+		}
+	}
+out:
+	k_mutex_unlock(&admission_lock);
+	k_mutex_unlock(&container_lock);
+	return ret;
+}
+#endif /* CONFIG_XRUN_ADMISSION */
@@ -3,8 +3,10 @@
  * Copyright (c) 2023 EPAM Systems
  */
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <xrun.h>
+#include <zephyr/kernel.h>
 #include <zephyr/shell/shell.h>
 
 const char *get_param(size_t argc, char **argv, char opt)
@@ -55,6 +57,60 @@ static int xrun_shell_kill(const struct shell *shell, size_t argc, char **argv)
 	return xrun_kill(container_id);
 }
 
+static int xrun_shell_stop(const struct shell *shell, size_t argc, char **argv)
+{
+	const char *container_id;
+	const char *timeout;
+
+	container_id = get_param(argc, argv, 'c');
+	timeout = get_param(argc, argv, 't');
+
+	if (!container_id || !timeout) {
+		shell_error(shell, "Invalid parameters\n");
+		return -EINVAL;
+	}
+
+	return xrun_stop(container_id, atoi(timeout));
+}
+
+static int xrun_shell_killall(const struct shell *shell, size_t argc,
+			      char **argv)
+{
+	struct xrun_kill_result *results;
+	const char *timeout;
+	ssize_t total, i;
+
+	timeout = get_param(argc, argv, 't');
+
+	if (!timeout) {
+		shell_error(shell, "Invalid timeout passed to killall cmd\n");
+		return -EINVAL;
+	}
+
+	total = xrun_list(NULL, 0);
+	if (total <= 0) {
+		return total;
+	}
+
+	results = k_calloc(total, sizeof(*results));
+	if (!results) {
+		shell_error(shell, "Unable to allocate results\n");
+		return -ENOMEM;
+	}
+
+	/* Containers could be added since the list call */
+	total = MIN(xrun_kill_all(atoi(timeout), results, total), total);
+	for (i = 0; i < total; i++) {
+		shell_print(shell, "%s: %s in %u ms (%d)",
+			    results[i].container_id,
+			    results[i].forced ? "destroyed" : "shut down",
+			    results[i].time_ms, results[i].result);
+	}
+
+	k_free(results);
+	return 0;
+}
+
 static int xrun_shell_pause(const struct shell *shell, size_t argc,
 			    char **argv)
 {
@@ -86,6 +142,128 @@ static int xrun_shell_resume(const struct shell *shell, size_t argc,
 	return xrun_resume(container_id);
 }
 
+static int xrun_shell_restart(const struct shell *shell, size_t argc,
+			      char **argv)
+{
+	const char *container_id;
+
+	container_id = get_param(argc, argv, 'c');
+
+	if (!container_id) {
+		shell_error(shell,
+			    "Invalid containerid passed to restart cmd\n");
+		return -EINVAL;
+	}
+
+	return xrun_restart(container_id);
+}
+
+#ifdef CONFIG_XRUN_AUTOSTART
+static int xrun_shell_autostart(const struct shell *shell, size_t argc,
+				char **argv)
+{
+	const char *manifest;
+
+	manifest = get_param(argc, argv, 'f');
+
+	if (!manifest) {
+		shell_error(shell, "Invalid manifest passed to autostart cmd\n");
+		return -EINVAL;
+	}
+
+	return xrun_autostart(manifest);
+}
+#endif
+
+static int xrun_shell_mem(const struct shell *shell, size_t argc, char **argv)
+{
+	const char *container_id;
+	const char *mem;
+	uint64_t cur_kb, target_kb;
+	int rc;
+
+	container_id = get_param(argc, argv, 'c');
+	mem = get_param(argc, argv, 'm');
+
+	if (!container_id) {
+		shell_error(shell, "Invalid containerid passed to mem cmd\n");
+		return -EINVAL;
+	}
+
+	if (mem) {
+		rc = xrun_set_memory(container_id, strtoull(mem, NULL, 10));
+		if (rc) {
+			shell_error(shell, "Unable to set memory (%d)\n", rc);
+			return rc;
+		}
+	}
+
+	rc = xrun_get_memory(container_id, &cur_kb, &target_kb);
+	if (rc) {
+		shell_error(shell, "Unable to get memory (%d)\n", rc);
+		return rc;
+	}
+
+	shell_print(shell, "%s memory %llu KB, target %llu KB", container_id,
+		    cur_kb, target_kb);
+	return 0;
+}
+
+static int xrun_shell_affinity(const struct shell *shell, size_t argc,
+			       char **argv)
+{
+	const char *container_id;
+	const char *vcpu;
+	const char *mask;
+
+	container_id = get_param(argc, argv, 'c');
+	vcpu = get_param(argc, argv, 'v');
+	mask = get_param(argc, argv, 'm');
+
+	if (!container_id || !mask) {
+		shell_error(shell, "Invalid parameters\n");
+		return -EINVAL;
+	}
+
+	return xrun_set_affinity(container_id, vcpu ? atoi(vcpu) : -1,
+				 strtoul(mask, NULL, 0));
+}
+
+static int xrun_shell_sched(const struct shell *shell, size_t argc,
+			    char **argv)
+{
+	const char *container_id;
+	const char *weight;
+	const char *cap;
+
+	container_id = get_param(argc, argv, 'c');
+	weight = get_param(argc, argv, 'w');
+	cap = get_param(argc, argv, 'p');
+
+	if (!container_id || !weight || !cap) {
+		shell_error(shell, "Invalid parameters\n");
+		return -EINVAL;
+	}
+
+	return xrun_set_sched(container_id, atoi(weight), atoi(cap));
+}
+
+static const char *status_to_str(enum container_status status)
+{
+	switch (status) {
+	case RUNNING:
+		return "running";
+	case PAUSED:
+		return "paused";
+	case DESTROYED:
+		return "destroyed";
+	case STOPPING:
+		return "stopping";
+	default:
+		return "unknown";
+	}
+}
+
 static int xrun_shell_state(const struct shell *shell, size_t argc,
 			    char **argv)
 {
@@ -101,12 +279,130 @@ static int xrun_shell_state(const struct shell *shell, size_t argc,
 	}
 
 	rc = xrun_state(container_id, &state);
-	if (!rc) {
+	if (rc) {
 		shell_error(shell, "Unable to get specs for the container\n");
 		return -EINVAL;
 	}
 
-	shell_print(shell, "%s state is %d", container_id, state);
+	shell_print(shell, "%s state is %s", container_id,
+		    status_to_str(state));
+	return 0;
+}
+
+/* Takes snapshot of the containers, info should be freed by caller */
+static ssize_t get_snapshot(const struct shell *shell,
+			    struct xrun_container_info **info)
+{
+	ssize_t total;
+
+	*info = NULL;
+	total = xrun_list(NULL, 0);
+	if (total <= 0) {
+		if (total < 0) {
+			shell_error(shell, "Unable to get containers list\n");
+		}
+		return total;
+	}
+
+	*info = k_malloc(total * sizeof(**info));
+	if (!*info) {
+		shell_error(shell, "Unable to allocate containers list\n");
+		return -ENOMEM;
+	}
+
+	/* Containers could be added since the first call */
+	return MIN(xrun_list(*info, total), total);
+}
+
+static int xrun_shell_list(const struct shell *shell, size_t argc,
+			   char **argv)
+{
+	struct xrun_container_info *info;
+	ssize_t total, i;
+
+	total = get_snapshot(shell, &info);
+	if (total < 0) {
+		return total;
+	}
+
+	if (total == 0) {
+		shell_print(shell, "No containers");
+		return 0;
+	}
+
+	shell_print(shell, "%-24s %-6s %-10s %-9s %-6s %s", "ID", "DOMID",
+		    "STATE", "UPTIME(s)", "WEIGHT", "CAP(%)");
+	for (i = 0; i < total; i++) {
+		shell_print(shell, "%-24s %-6llu %-10s %-9lld %-6u %u",
+			    info[i].container_id, info[i].domid,
+			    status_to_str(info[i].status),
+			    info[i].uptime_ms / MSEC_PER_SEC,
+			    info[i].sched_weight, info[i].sched_cap);
+	}
+
+	k_free(info);
+	return 0;
+}
+
+/* Single snapshot by default, shell is blocked until top is finished */
+#define TOP_DEFAULT_ITERATIONS 1
+#define TOP_DEFAULT_DELAY_S 2
+
+static int xrun_shell_top(const struct shell *shell, size_t argc,
+			  char **argv)
+{
+	struct xrun_container_info *info;
+	const char *param;
+	int iterations = TOP_DEFAULT_ITERATIONS;
+	int delay = TOP_DEFAULT_DELAY_S;
+	ssize_t total, i;
+
+	param = get_param(argc, argv, 'n');
+	if (param) {
+		iterations = atoi(param);
+	}
+
+	param = get_param(argc, argv, 'd');
+	if (param) {
+		delay = atoi(param);
+	}
+
+	if (iterations <= 0 || delay <= 0) {
+		shell_error(shell, "Invalid parameters\n");
+		return -EINVAL;
+	}
+
+	while (iterations--) {
+		total = get_snapshot(shell, &info);
+		if (total < 0) {
+			return total;
+		}
+
+		/* Clear screen and move cursor home */
+		shell_fprintf(shell, SHELL_NORMAL, "\033[2J\033[H");
+		shell_print(shell, "xrun top - %u containers, uptime %llu s",
+			    (unsigned int)total, k_uptime_get() / MSEC_PER_SEC);
+		shell_print(shell, "%-24s %-6s %-10s %-9s %-8s %-5s %-10s %-8s %s",
+			    "ID", "DOMID", "STATE", "UPTIME(s)", "MEM(KB)",
+			    "VCPUS", "IMAGE(KB)", "LOAD(ms)", "LOAD(KB/s)");
+		for (i = 0; i < total; i++) {
+			shell_print(shell,
+				    "%-24s %-6llu %-10s %-9lld %-8llu %-5u %-10llu %-8u %u",
+				    info[i].container_id, info[i].domid,
+				    status_to_str(info[i].status),
+				    info[i].uptime_ms / MSEC_PER_SEC,
+				    info[i].mem_kb, info[i].vcpus,
+				    info[i].image_size / 1024,
+				    info[i].load_time_ms, info[i].load_rate);
+		}
+
+		k_free(info);
+
+		if (iterations) {
+			k_sleep(K_SECONDS(delay));
+		}
+	}
+
 	return 0;
 }
 
@@ -120,6 +416,14 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 		" Destroy container\n"
 		" Usage: kill -c <container_id>\n",
 		xrun_shell_kill, 3, 0),
+	SHELL_CMD_ARG(stop, NULL,
+		" Stop container, destroying it after timeout ms\n"
+		" Usage: stop -c <container_id> -t <timeout_ms>\n",
+		xrun_shell_stop, 5, 0),
+	SHELL_CMD_ARG(killall, NULL,
+		" Kill all containers, giving them timeout ms to shut down\n"
+		" Usage: killall -t <timeout_ms>\n",
+		xrun_shell_killall, 3, 0),
 	SHELL_CMD_ARG(pause, NULL,
 		" Pause container\n"
 		" Usage: pause -c <container_id>\n",
@@ -128,10 +432,38 @@ SHELL_STATIC_SUBCMD_SET_CREATE(
 		" Resume container\n"
 		" Usage: resume -c <container_id>\n",
 		xrun_shell_resume, 3, 0),
+	SHELL_CMD_ARG(restart, NULL,
+		" Restart container from the parsed spec\n"
+		" Usage: restart -c <container_id>\n",
+		xrun_shell_restart, 3, 0),
+	SHELL_COND_CMD_ARG(CONFIG_XRUN_AUTOSTART, autostart, NULL,
+		" Start containers from the manifest\n"
+		" Usage: autostart -f <manifest_path>\n",
+		xrun_shell_autostart, 3, 0),
 	SHELL_CMD_ARG(state, NULL,
 		" Show container state\n"
 		" Usage: state -c <container_id>\n",
 		xrun_shell_state, 3, 0),
+	SHELL_CMD_ARG(list, NULL,
+		" List all containers\n"
+		" Usage: list\n",
+		xrun_shell_list, 1, 0),
+	SHELL_CMD_ARG(mem, NULL,
+		" Show or set container memory\n"
+		" Usage: mem -c <container_id> [-m <memory in KB>]\n",
+		xrun_shell_mem, 3, 2),
+	SHELL_CMD_ARG(affinity, NULL,
+		" Pin container vCPUs to physical CPUs\n"
+		" Usage: affinity -c <container_id> [-v <vcpu>] -m <cpumask>\n",
+		xrun_shell_affinity, 5, 2),
+	SHELL_CMD_ARG(sched, NULL,
+		" Set container scheduler parameters\n"
+		" Usage: sched -c <container_id> -w <weight> -p <cap %>\n",
+		xrun_shell_sched, 7, 0),
+	SHELL_CMD_ARG(top, NULL,
+		" Show containers resources and load statistics, once by default\n"
+		" Usage: top [-n <iterations>] [-d <delay in seconds>]\n",
+		xrun_shell_top, 1, 4),
 	SHELL_SUBCMD_SET_END);
 
 SHELL_CMD_ARG_REGISTER(xrun, &subcmd_xrun, "XRun commands", NULL, 3, 0);
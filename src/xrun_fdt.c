@@ -0,0 +1,218 @@
+// SPDX-License-Identifier: Apache-2.0
+/*
+ * Copyright (c) 2024 EPAM Systems
+ */
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include <xrun_fdt.h>
+
+#define FDT_MAGIC 0xd00dfeed
+#define FDT_VERSION 17
+#define FDT_LAST_COMP_VERSION 16
+
+#define FDT_BEGIN_NODE 0x1
+#define FDT_END_NODE 0x2
+#define FDT_PROP 0x3
+#define FDT_END 0x9
+
+#define FDT_HEADER_SIZE 40
+/* Empty memory reservation map holds only the terminating entry */
+#define FDT_RSVMAP_SIZE 16
+
+static void *fdt_grab(struct xrun_fdt *fdt, size_t len)
+{
+	size_t aligned = ROUND_UP(len, sizeof(uint32_t));
+	void *ptr;
+
+	if (fdt->err) {
+		return NULL;
+	}
+
+	if (fdt->off + aligned > fdt->size) {
+		fdt->err = -ENOSPC;
+		return NULL;
+	}
+
+	ptr = fdt->buf + fdt->off;
+	/* Padding should be zeroed */
+	memset(ptr, 0, aligned);
+	fdt->off += aligned;
+
+	return ptr;
+}
+
+static void fdt_token(struct xrun_fdt *fdt, uint32_t token)
+{
+	uint8_t *ptr = fdt_grab(fdt, sizeof(token));
+
+	if (ptr) {
+		sys_put_be32(token, ptr);
+	}
+}
+
+static int fdt_string_offset(struct xrun_fdt *fdt, const char *name)
+{
+	size_t len = strlen(name) + 1;
+	size_t off = 0;
+
+	/* Property names are few, so linear search is enough */
+	while (off < fdt->strings_len) {
+		if (!strcmp(fdt->strings + off, name)) {
+			return off;
+		}
+		off += strlen(fdt->strings + off) + 1;
+	}
+
+	if (fdt->strings_len + len > sizeof(fdt->strings)) {
+		return -ENOSPC;
+	}
+
+	memcpy(fdt->strings + fdt->strings_len, name, len);
+	fdt->strings_len += len;
+
+	return off;
+}
+
+void xrun_fdt_init(struct xrun_fdt *fdt, void *buf, size_t size)
+{
+	memset(fdt, 0, sizeof(*fdt));
+	fdt->buf = buf;
+	fdt->size = size;
+	fdt->off = FDT_HEADER_SIZE + FDT_RSVMAP_SIZE;
+
+	if (size < fdt->off) {
+		fdt->err = -ENOSPC;
+		return;
+	}
+
+	memset(fdt->buf, 0, fdt->off);
+}
+
+void xrun_fdt_begin_node(struct xrun_fdt *fdt, const char *name)
+{
+	size_t len = strlen(name) + 1;
+	uint8_t *ptr;
+
+	fdt_token(fdt, FDT_BEGIN_NODE);
+	ptr = fdt_grab(fdt, len);
+	if (ptr) {
+		memcpy(ptr, name, len);
+		fdt->depth++;
+	}
+}
+
+void xrun_fdt_end_node(struct xrun_fdt *fdt)
+{
+	if (!fdt->err && fdt->depth == 0) {
+		fdt->err = -EINVAL;
+		return;
+	}
+
+	fdt_token(fdt, FDT_END_NODE);
+	if (!fdt->err) {
+		fdt->depth--;
+	}
+}
+
+void xrun_fdt_prop(struct xrun_fdt *fdt, const char *name, const void *val,
+		   size_t len)
+{
+	uint8_t *ptr;
+	int nameoff;
+
+	if (fdt->err) {
+		return;
+	}
+
+	nameoff = fdt_string_offset(fdt, name);
+	if (nameoff < 0) {
+		fdt->err = nameoff;
+		return;
+	}
+
+	fdt_token(fdt, FDT_PROP);
+	ptr = fdt_grab(fdt, 2 * sizeof(uint32_t) + len);
+	if (!ptr) {
+		return;
+	}
+
+	sys_put_be32(len, ptr);
+	sys_put_be32(nameoff, ptr + sizeof(uint32_t));
+	if (len) {
+		memcpy(ptr + 2 * sizeof(uint32_t), val, len);
+	}
+}
+
+void xrun_fdt_prop_cells(struct xrun_fdt *fdt, const char *name,
+			 const uint32_t *cells, size_t count)
+{
+	uint8_t *ptr;
+	size_t i;
+
+	xrun_fdt_prop(fdt, name, NULL, 0);
+	if (fdt->err || !count) {
+		return;
+	}
+
+	/* Property was added empty, grow it in place with the cells */
+	ptr = fdt_grab(fdt, count * sizeof(uint32_t));
+	if (!ptr) {
+		return;
+	}
+
+	sys_put_be32(count * sizeof(uint32_t), ptr - 2 * sizeof(uint32_t));
+	for (i = 0; i < count; i++) {
+		sys_put_be32(cells[i], ptr + i * sizeof(uint32_t));
+	}
+}
+
+void xrun_fdt_prop_u32(struct xrun_fdt *fdt, const char *name, uint32_t val)
+{
+	xrun_fdt_prop_cells(fdt, name, &val, 1);
+}
+
+void xrun_fdt_prop_string(struct xrun_fdt *fdt, const char *name,
+			  const char *str)
+{
+	xrun_fdt_prop(fdt, name, str, strlen(str) + 1);
+}
+
+ssize_t xrun_fdt_finish(struct xrun_fdt *fdt)
+{
+	size_t struct_off = FDT_HEADER_SIZE + FDT_RSVMAP_SIZE;
+	size_t struct_size, strings_off;
+	uint8_t *hdr = fdt->buf;
+
+	if (!fdt->err && fdt->depth) {
+		fdt->err = -EINVAL;
+	}
+
+	fdt_token(fdt, FDT_END);
+	if (fdt->err) {
+		return fdt->err;
+	}
+
+	struct_size = fdt->off - struct_off;
+	strings_off = fdt->off;
+	if (strings_off + fdt->strings_len > fdt->size) {
+		return -ENOSPC;
+	}
+	memcpy(fdt->buf + strings_off, fdt->strings, fdt->strings_len);
+
+	sys_put_be32(FDT_MAGIC, hdr);
+	sys_put_be32(strings_off + fdt->strings_len, hdr + 4);
+	sys_put_be32(struct_off, hdr + 8);
+	sys_put_be32(strings_off, hdr + 12);
+	sys_put_be32(FDT_HEADER_SIZE, hdr + 16);
+	sys_put_be32(FDT_VERSION, hdr + 20);
+	sys_put_be32(FDT_LAST_COMP_VERSION, hdr + 24);
+	/* boot_cpuid_phys is left 0 */
+	sys_put_be32(fdt->strings_len, hdr + 32);
+	sys_put_be32(struct_size, hdr + 36);
+
+	return strings_off + fdt->strings_len;
+}
@@ -0,0 +1,186 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+
+#include <xrun.h>
+
+#include "mock.h"
+
+const char *test_manifest;
+const char *test_running;
+enum container_status test_running_state;
+const char *test_run_fail;
+int test_ready_reads;
+
+static int test_position(const char *container_id)
+{
+	int i;
+
+	for (i = 0; i < test_started_count; i++) {
+		if (!strcmp(test_started[i], container_id)) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+ZTEST(autostart_test, test_diamond)
+{
+	/* Dependents are listed first, e doesn't depend on anything */
+	test_manifest = "{ \"containers\": ["
+		"{ \"id\": \"d\", \"bundle\": \"/lfs/d\", "
+		"\"dependsOn\": [\"b\", \"c\"] }, "
+		"{ \"id\": \"c\", \"bundle\": \"/lfs/c\", "
+		"\"dependsOn\": [\"a\"] }, "
+		"{ \"id\": \"b\", \"bundle\": \"/lfs/b\", "
+		"\"dependsOn\": [\"a\"] }, "
+		"{ \"id\": \"e\", \"bundle\": \"/lfs/e\" }, "
+		"{ \"id\": \"a\", \"bundle\": \"/lfs/a\" }"
+		"] }";
+	int ret;
+
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, 0, "Error starting manifest (%d)", ret);
+	zassert_equal(test_started_count, 5, "Wrong number of starts %d",
+		      test_started_count);
+
+	zassert_true(test_position("a") >= 0, "a isn't started");
+	zassert_true(test_position("b") > test_position("a"),
+		     "b is started before its dependency");
+	zassert_true(test_position("c") > test_position("a"),
+		     "c is started before its dependency");
+	zassert_true(test_position("d") > test_position("b") &&
+		     test_position("d") > test_position("c"),
+		     "d is started before its dependencies");
+	zassert_true(test_position("e") >= 0, "e isn't started");
+}
+
+ZTEST(autostart_test, test_cycle)
+{
+	test_manifest = "{ \"containers\": ["
+		"{ \"id\": \"a\", \"bundle\": \"/lfs/a\", "
+		"\"dependsOn\": [\"c\"] }, "
+		"{ \"id\": \"b\", \"bundle\": \"/lfs/b\", "
+		"\"dependsOn\": [\"a\"] }, "
+		"{ \"id\": \"c\", \"bundle\": \"/lfs/c\", "
+		"\"dependsOn\": [\"b\"] }, "
+		"{ \"id\": \"d\", \"bundle\": \"/lfs/d\" }"
+		"] }";
+	int ret;
+
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -ELOOP, "Cycle wasn't detected (%d)", ret);
+	zassert_equal(test_started_count, 0, "Containers were started");
+}
+
+ZTEST(autostart_test, test_unknown_dependency)
+{
+	test_manifest = "{ \"containers\": ["
+		"{ \"id\": \"a\", \"bundle\": \"/lfs/a\", "
+		"\"dependsOn\": [\"x\"] }"
+		"] }";
+	int ret;
+
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -ENOENT, "Unknown dependency wasn't detected (%d)",
+		      ret);
+	zassert_equal(test_started_count, 0, "Containers were started");
+
+	/* Dependency which is not running can't be relied on */
+	test_running = "x";
+	test_running_state = DESTROYED;
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -ESRCH, "Stopped dependency was accepted (%d)",
+		      ret);
+	test_running_state = PAUSED;
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -ESRCH, "Paused dependency was accepted (%d)",
+		      ret);
+	zassert_equal(test_started_count, 0, "Containers were started");
+
+	/* Running dependency started before the manifest is ready */
+	test_running_state = RUNNING;
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, 0, "Error starting manifest (%d)", ret);
+	zassert_equal(test_position("a"), 0, "a isn't started");
+}
+
+ZTEST(autostart_test, test_failed_dependency)
+{
+	test_manifest = "{ \"containers\": ["
+		"{ \"id\": \"a\", \"bundle\": \"/lfs/a\" }, "
+		"{ \"id\": \"b\", \"bundle\": \"/lfs/b\", "
+		"\"dependsOn\": [\"a\"] }, "
+		"{ \"id\": \"c\", \"bundle\": \"/lfs/c\", "
+		"\"dependsOn\": [\"b\"] }, "
+		"{ \"id\": \"d\", \"bundle\": \"/lfs/d\" }"
+		"] }";
+	int ret;
+
+	test_run_fail = "a";
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -EIO, "Failed start wasn't reported (%d)", ret);
+
+	/* Dependents are skipped, other containers are started */
+	zassert_equal(test_started_count, 2, "Wrong number of starts %d",
+		      test_started_count);
+	zassert_true(test_position("a") >= 0, "a isn't started");
+	zassert_true(test_position("d") >= 0, "d isn't started");
+	zassert_equal(test_position("b"), -1, "Dependent b was started");
+	zassert_equal(test_position("c"), -1, "Dependent c was started");
+}
+
+ZTEST(autostart_test, test_ready_timeout)
+{
+	test_manifest = "{ \"containers\": ["
+		"{ \"id\": \"a\", \"bundle\": \"/lfs/a\", "
+		"\"readyPath\": \"data/ready\", \"readyTimeoutMs\": 50 }, "
+		"{ \"id\": \"b\", \"bundle\": \"/lfs/b\", "
+		"\"dependsOn\": [\"a\"] }"
+		"] }";
+	int64_t start = k_uptime_get();
+	int ret;
+
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -ETIMEDOUT, "Ready timeout wasn't reported (%d)",
+		      ret);
+	zassert_true(k_uptime_get() - start >= 50, "Timeout wasn't waited");
+	zassert_true(test_ready_reads > 0, "Ready node wasn't read");
+	zassert_equal(test_position("a"), 0, "a isn't started");
+	zassert_equal(test_position("b"), -1, "Dependent b was started");
+}
+
+ZTEST(autostart_test, test_invalid)
+{
+	int ret;
+
+	ret = xrun_autostart(NULL);
+	zassert_equal(ret, -EINVAL, "Manifest without path was started");
+
+	test_manifest = "{ \"containers\": ["
+		"{ \"id\": \"a\" }"
+		"] }";
+	ret = xrun_autostart("/lfs/autostart.json");
+	zassert_equal(ret, -EINVAL, "Container without bundle was started");
+	zassert_equal(test_started_count, 0, "Containers were started");
+}
+
+static void test_before(void *fixture)
+{
+	test_manifest = NULL;
+	test_running = NULL;
+	test_running_state = RUNNING;
+	test_run_fail = NULL;
+	test_ready_reads = 0;
+	memset(test_started, 0, sizeof(test_started));
+	test_started_count = 0;
+}
+
+ZTEST_SUITE(autostart_test, NULL, NULL, test_before, NULL, NULL);
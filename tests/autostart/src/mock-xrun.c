@@ -0,0 +1,111 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+#include <hypervisor.h>
+#include <storage.h>
+#include <xrun.h>
+
+#include "mock.h"
+
+char test_started[TEST_CONTAINERS_MAX][TEST_ID_SIZE];
+int test_started_count;
+
+static K_MUTEX_DEFINE(test_lock);
+
+static int find_started(const char *container_id)
+{
+	int i;
+
+	for (i = 0; i < test_started_count; i++) {
+		if (!strcmp(test_started[i], container_id)) {
+			return i;
+		}
+	}
+
+	return -ENOENT;
+}
+
+ssize_t xrun_read_file(const char *fpath, char *buf, size_t size, int skip)
+{
+	size_t len;
+
+	if (!test_manifest) {
+		return -ENOENT;
+	}
+
+	len = strlen(test_manifest);
+	if (len > size) {
+		return -ENOMEM;
+	}
+
+	memcpy(buf, test_manifest, len);
+	return len;
+}
+
+int xrun_run(const char *bundle, int console_socket, const char *container_id)
+{
+	k_mutex_lock(&test_lock, K_FOREVER);
+	if (test_started_count < ARRAY_SIZE(test_started)) {
+		strncpy(test_started[test_started_count++], container_id,
+			TEST_ID_SIZE - 1);
+	}
+	k_mutex_unlock(&test_lock);
+
+	if (test_run_fail && !strcmp(container_id, test_run_fail)) {
+		return -EIO;
+	}
+
+	return 0;
+}
+
+int xrun_state(const char *container_id, enum container_status *state)
+{
+	int ret = 0;
+
+	*state = RUNNING;
+	k_mutex_lock(&test_lock, K_FOREVER);
+	if (find_started(container_id) >= 0) {
+		goto out;
+	}
+
+	if (!test_running || strcmp(container_id, test_running)) {
+		ret = -EINVAL;
+	} else {
+		*state = test_running_state;
+	}
+out:
+	k_mutex_unlock(&test_lock);
+	return ret;
+}
+
+int xrun_get_domid(const char *container_id, uint64_t *domid)
+{
+	int ret;
+
+	k_mutex_lock(&test_lock, K_FOREVER);
+	ret = find_started(container_id);
+	k_mutex_unlock(&test_lock);
+
+	if (ret < 0) {
+		return -EINVAL;
+	}
+
+	*domid = ret + 1;
+	return 0;
+}
+
+/* Domains never write the ready node */
+int xrun_hyp_read_node(uint32_t domid, const char *node, char *buf,
+		       size_t size)
+{
+	test_ready_reads++;
+	return -ENOENT;
+}
@@ -0,0 +1,26 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef XENLIB_TEST_AUTOSTART_MOCK_H
+#define XENLIB_TEST_AUTOSTART_MOCK_H
+
+#define TEST_CONTAINERS_MAX 8
+#define TEST_ID_SIZE 16
+
+/* Manifest returned by xrun_read_file */
+extern const char *test_manifest;
+/* Container started before the manifest and its state */
+extern const char *test_running;
+extern enum container_status test_running_state;
+/* Container which fails to start */
+extern const char *test_run_fail;
+extern int test_ready_reads;
+
+/* Containers in the order of xrun_run calls, manifest is freed on return */
+extern char test_started[TEST_CONTAINERS_MAX][TEST_ID_SIZE];
+extern int test_started_count;
+
+#endif /* XENLIB_TEST_AUTOSTART_MOCK_H */
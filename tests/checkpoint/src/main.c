@@ -0,0 +1,215 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/types.h>
+#include <zephyr/ztest.h>
+
+#include <checkpoint.h>
+#include <hypervisor.h>
+
+#define TEST_MEM_KB 256
+#define TEST_NR_PAGES (TEST_MEM_KB * 1024 / XRUN_PAGE_SIZE)
+#define TEST_NR_VCPUS 2
+#define TEST_CTX_SIZE 64
+
+/* Checkpoint stream layout, see src/checkpoint.c */
+#define TEST_CKPT_MAGIC 0x50435258
+#define TEST_REC_DATA 1
+#define TEST_REC_ZERO 2
+#define TEST_REC_END 3
+
+struct test_ckpt_header {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t nr_vcpus;
+	uint32_t ctx_size;
+	uint32_t page_size;
+	uint64_t mem_kb;
+} __packed;
+
+struct test_ckpt_record {
+	uint32_t type;
+	uint32_t nr_pages;
+	uint64_t first_page;
+} __packed;
+
+uint8_t test_ram[TEST_MEM_KB * 1024] __aligned(XRUN_PAGE_SIZE);
+size_t test_ram_size = sizeof(test_ram);
+uint8_t test_vcpu_ctx[TEST_NR_VCPUS][TEST_CTX_SIZE];
+int test_mapped_pages;
+
+uint8_t test_file[sizeof(test_ram) + KB(16)];
+size_t test_file_size;
+size_t test_file_max = sizeof(test_file);
+
+static uint8_t saved_ram[sizeof(test_ram)];
+static uint8_t saved_ctx[TEST_NR_VCPUS][TEST_CTX_SIZE];
+
+static bool test_page_is_data(uint64_t page)
+{
+	/* First page, pages 21-40 and the last page hold data */
+	return page == 0 || (page >= 21 && page <= 40) ||
+		page == TEST_NR_PAGES - 1;
+}
+
+static void test_fill_guest(void)
+{
+	uint64_t page;
+	int i;
+
+	memset(test_ram, 0, sizeof(test_ram));
+	for (page = 0; page < TEST_NR_PAGES; page++) {
+		if (!test_page_is_data(page)) {
+			continue;
+		}
+
+		for (i = 0; i < XRUN_PAGE_SIZE; i++) {
+			test_ram[page * XRUN_PAGE_SIZE + i] = (page + i) | 1;
+		}
+	}
+
+	for (i = 0; i < TEST_NR_VCPUS; i++) {
+		memset(test_vcpu_ctx[i], 0x10 + i, TEST_CTX_SIZE);
+	}
+
+	memcpy(saved_ram, test_ram, sizeof(test_ram));
+	memcpy(saved_ctx, test_vcpu_ctx, sizeof(test_vcpu_ctx));
+}
+
+static void test_scramble_guest(void)
+{
+	memset(test_ram, 0xaa, sizeof(test_ram));
+	memset(test_vcpu_ctx, 0x55, sizeof(test_vcpu_ctx));
+}
+
+ZTEST(checkpoint_test, test_round_trip)
+{
+	int ret;
+
+	test_fill_guest();
+
+	ret = xrun_checkpoint_save(1, TEST_MEM_KB, TEST_NR_VCPUS, "/lfs/ckpt");
+	zassert_equal(ret, 0, "Error saving checkpoint (%d)", ret);
+	zassert_equal(test_mapped_pages, 0, "Guest pages left mapped");
+
+	test_scramble_guest();
+
+	ret = xrun_checkpoint_load(1, TEST_MEM_KB, TEST_NR_VCPUS, "/lfs/ckpt");
+	zassert_equal(ret, 0, "Error loading checkpoint (%d)", ret);
+	zassert_equal(test_mapped_pages, 0, "Guest pages left mapped");
+
+	zassert_mem_equal(test_ram, saved_ram, sizeof(test_ram),
+			  "Guest memory wasn't restored");
+	zassert_mem_equal(test_vcpu_ctx, saved_ctx, sizeof(saved_ctx),
+			  "vCPU contexts weren't restored");
+}
+
+ZTEST(checkpoint_test, test_stream_format)
+{
+	struct test_ckpt_header hdr;
+	struct test_ckpt_record rec;
+	uint64_t page, next_page = 0;
+	size_t offset, data_pages = 0;
+	bool end = false;
+	int ret;
+
+	test_fill_guest();
+
+	ret = xrun_checkpoint_save(1, TEST_MEM_KB, TEST_NR_VCPUS, "/lfs/ckpt");
+	zassert_equal(ret, 0, "Error saving checkpoint (%d)", ret);
+
+	memcpy(&hdr, test_file, sizeof(hdr));
+	zassert_equal(hdr.magic, TEST_CKPT_MAGIC, "Wrong magic");
+	zassert_equal(hdr.nr_vcpus, TEST_NR_VCPUS, "Wrong number of vCPUs");
+	zassert_equal(hdr.ctx_size, TEST_CTX_SIZE, "Wrong context size");
+	zassert_equal(hdr.page_size, XRUN_PAGE_SIZE, "Wrong page size");
+	zassert_equal(hdr.mem_kb, TEST_MEM_KB, "Wrong memory size");
+
+	offset = sizeof(hdr);
+	zassert_mem_equal(test_file + offset, saved_ctx, sizeof(saved_ctx),
+			  "vCPU contexts are not stored after the header");
+	offset += sizeof(saved_ctx);
+
+	/* Records should cover guest RAM in order without gaps */
+	while (offset + sizeof(rec) <= test_file_size) {
+		memcpy(&rec, test_file + offset, sizeof(rec));
+		offset += sizeof(rec);
+
+		if (rec.type == TEST_REC_END) {
+			end = true;
+			break;
+		}
+
+		zassert_equal(rec.first_page, next_page,
+			      "Record at %zu doesn't follow previous one",
+			      offset);
+		zassert_true(rec.nr_pages > 0, "Empty record");
+
+		for (page = rec.first_page;
+		     page < rec.first_page + rec.nr_pages; page++) {
+			zassert_equal(test_page_is_data(page),
+				      rec.type == TEST_REC_DATA,
+				      "Page %llu is stored in wrong record",
+				      page);
+		}
+
+		if (rec.type == TEST_REC_DATA) {
+			zassert_mem_equal(test_file + offset,
+					  saved_ram + rec.first_page *
+					  XRUN_PAGE_SIZE,
+					  rec.nr_pages * XRUN_PAGE_SIZE,
+					  "Wrong payload of page %llu",
+					  rec.first_page);
+			offset += rec.nr_pages * XRUN_PAGE_SIZE;
+			data_pages += rec.nr_pages;
+		} else {
+			zassert_equal(rec.type, TEST_REC_ZERO,
+				      "Unknown record type %u", rec.type);
+		}
+
+		next_page = rec.first_page + rec.nr_pages;
+	}
+
+	zassert_true(end, "No end record");
+	zassert_equal(offset, test_file_size, "Data after the end record");
+	zassert_equal(next_page, TEST_NR_PAGES, "Guest RAM isn't covered");
+	zassert_equal(data_pages, 22, "Zero pages weren't elided");
+}
+
+ZTEST(checkpoint_test, test_load_invalid)
+{
+	struct test_ckpt_header hdr;
+	int ret;
+
+	test_fill_guest();
+
+	ret = xrun_checkpoint_save(1, TEST_MEM_KB, TEST_NR_VCPUS, "/lfs/ckpt");
+	zassert_equal(ret, 0, "Error saving checkpoint (%d)", ret);
+
+	/* Domain configuration should match the saved one */
+	ret = xrun_checkpoint_load(1, TEST_MEM_KB / 2, TEST_NR_VCPUS,
+				   "/lfs/ckpt");
+	zassert_equal(ret, -EINVAL, "Memory size mismatch wasn't detected");
+
+	ret = xrun_checkpoint_load(1, TEST_MEM_KB, 1, "/lfs/ckpt");
+	zassert_equal(ret, -EINVAL, "vCPU number mismatch wasn't detected");
+
+	/* Checkpoint without end record is truncated */
+	test_file_size -= sizeof(struct test_ckpt_record);
+	ret = xrun_checkpoint_load(1, TEST_MEM_KB, TEST_NR_VCPUS, "/lfs/ckpt");
+	zassert_equal(ret, -EIO, "Truncated checkpoint was loaded");
+	test_file_size += sizeof(struct test_ckpt_record);
+
+	memcpy(&hdr, test_file, sizeof(hdr));
+	hdr.magic = 0;
+	memcpy(test_file, &hdr, sizeof(hdr));
+	ret = xrun_checkpoint_load(1, TEST_MEM_KB, TEST_NR_VCPUS, "/lfs/ckpt");
+	zassert_equal(ret, -EINVAL, "Checkpoint with wrong magic was loaded");
+	zassert_equal(test_mapped_pages, 0, "Guest pages left mapped");
+}
+
+ZTEST_SUITE(checkpoint_test, NULL, NULL, NULL, NULL, NULL);
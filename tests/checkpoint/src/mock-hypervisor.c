@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <hypervisor.h>
+
+#include <zephyr/kernel.h>
+
+#define TEST_RAM_GFN 0x40000
+#define TEST_CTX_SIZE 64
+
+extern uint8_t test_ram[];
+extern size_t test_ram_size;
+extern uint8_t test_vcpu_ctx[][TEST_CTX_SIZE];
+extern int test_mapped_pages;
+
+int xrun_hyp_guest_ram_gfn(uint64_t mem_kb, uint64_t *gfn)
+{
+	if (mem_kb * 1024 > test_ram_size) {
+		return -E2BIG;
+	}
+
+	*gfn = TEST_RAM_GFN;
+	return 0;
+}
+
+int xrun_hyp_map_guest_pages(uint32_t domid, uint64_t gfn, size_t nr_pages,
+			     void **addr)
+{
+	if (gfn < TEST_RAM_GFN ||
+	    (gfn - TEST_RAM_GFN + nr_pages) * XRUN_PAGE_SIZE > test_ram_size) {
+		return -EFAULT;
+	}
+
+	test_mapped_pages += nr_pages;
+	*addr = test_ram + (gfn - TEST_RAM_GFN) * XRUN_PAGE_SIZE;
+	return 0;
+}
+
+int xrun_hyp_unmap_guest_pages(void *addr, size_t nr_pages)
+{
+	test_mapped_pages -= nr_pages;
+	return 0;
+}
+
+size_t xrun_hyp_vcpu_context_size(void)
+{
+	return TEST_CTX_SIZE;
+}
+
+int xrun_hyp_get_vcpu_context(uint32_t domid, uint32_t vcpu, void *ctx)
+{
+	memcpy(ctx, test_vcpu_ctx[vcpu], TEST_CTX_SIZE);
+	return 0;
+}
+
+int xrun_hyp_set_vcpu_context(uint32_t domid, uint32_t vcpu, void *ctx)
+{
+	memcpy(test_vcpu_ctx[vcpu], ctx, TEST_CTX_SIZE);
+	return 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <storage.h>
+#include <string.h>
+
+#include <zephyr/kernel.h>
+
+/* Single in-memory file backing all streams */
+extern uint8_t test_file[];
+extern size_t test_file_size;
+extern size_t test_file_max;
+
+struct xrun_stream {
+	size_t pos;
+};
+
+int xrun_stream_open(const char *fpath, struct xrun_stream **stream)
+{
+	*stream = k_malloc(sizeof(**stream));
+	if (!*stream) {
+		return -ENOMEM;
+	}
+
+	(*stream)->pos = 0;
+	return 0;
+}
+
+ssize_t xrun_stream_read(struct xrun_stream *stream, uint8_t *buf,
+			 size_t size, uint64_t offset)
+{
+	if (offset >= test_file_size) {
+		return 0;
+	}
+
+	size = MIN(size, test_file_size - offset);
+	memcpy(buf, test_file + offset, size);
+	return size;
+}
+
+int xrun_stream_create(const char *fpath, struct xrun_stream **stream)
+{
+	test_file_size = 0;
+	return xrun_stream_open(fpath, stream);
+}
+
+ssize_t xrun_stream_write(struct xrun_stream *stream, const uint8_t *buf,
+			  size_t size)
+{
+	if (test_file_size + size > test_file_max) {
+		return -ENOSPC;
+	}
+
+	memcpy(test_file + test_file_size, buf, size);
+	test_file_size += size;
+	return size;
+}
+
+int xrun_stream_close(struct xrun_stream *stream)
+{
+	k_free(stream);
+	return 0;
+}
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/posix/fcntl.h>
+#include <zephyr/posix/sys/socket.h>
+#include <zephyr/posix/unistd.h>
+#include <zephyr/sys/barrier.h>
+#include <zephyr/xen/events.h>
+#include <zephyr/xen/public/io/console.h>
+#include <zephyr/ztest.h>
+
+#include <console.h>
+
+#define TEST_DOMID 1
+
+struct xencons_interface test_ring;
+int test_mapped_pages;
+int test_bound_ports;
+int test_notifies;
+
+extern evtchn_cb_t test_evtchn_cb;
+extern void *test_evtchn_priv;
+
+/* Console is forwarded to the first socket, test reads the second one */
+static int test_sock[2];
+
+static void test_setup(XENCONS_RING_IDX idx)
+{
+	int ret;
+
+	memset(&test_ring, 0, sizeof(test_ring));
+	test_ring.out_cons = idx;
+	test_ring.out_prod = idx;
+	test_notifies = 0;
+
+	ret = socketpair(AF_UNIX, SOCK_STREAM, 0, test_sock);
+	zassert_equal(ret, 0, "Unable to create socket pair (%d)", errno);
+}
+
+static void test_teardown(void)
+{
+	close(test_sock[0]);
+	close(test_sock[1]);
+}
+
+/* Puts data to the ring as the domain does and notifies the console */
+static void test_produce(const char *data, size_t len)
+{
+	XENCONS_RING_IDX prod = test_ring.out_prod;
+	size_t i;
+
+	for (i = 0; i < len; i++, prod++) {
+		test_ring.out[MASK_XENCONS_IDX(prod, test_ring.out)] = data[i];
+	}
+
+	barrier_dmem_fence_full();
+	test_ring.out_prod = prod;
+	test_evtchn_cb(test_evtchn_priv);
+}
+
+static bool test_wait_consumed(void)
+{
+	int i;
+
+	for (i = 0; i < 100; i++) {
+		if (test_ring.out_cons == test_ring.out_prod) {
+			return true;
+		}
+		k_msleep(10);
+	}
+
+	return false;
+}
+
+static size_t test_read(char *buf, size_t size)
+{
+	size_t done = 0;
+	ssize_t rc;
+
+	while (done < size) {
+		rc = read(test_sock[1], buf + done, size - done);
+		if (rc <= 0) {
+			break;
+		}
+		done += rc;
+	}
+
+	return done;
+}
+
+ZTEST(console_test, test_forward)
+{
+	char msg[] = "hello, console";
+	char buf[sizeof(msg)];
+	int ret;
+
+	/* Output of the domain crosses the end of the ring */
+	test_setup(sizeof(test_ring.out) - 4);
+
+	ret = xrun_console_start(TEST_DOMID, test_sock[0]);
+	zassert_equal(ret, 0, "Error starting console (%d)", ret);
+	zassert_equal(test_mapped_pages, 1, "Console ring isn't mapped");
+	zassert_equal(test_bound_ports, 1, "Console evtchn isn't bound");
+
+	test_produce(msg, sizeof(msg));
+	zassert_true(test_wait_consumed(), "Console output wasn't consumed");
+	zassert_true(test_notifies > 0, "Domain wasn't notified");
+
+	zassert_equal(test_read(buf, sizeof(buf)), sizeof(buf),
+		      "Console output wasn't forwarded");
+	zassert_mem_equal(buf, msg, sizeof(msg), "Wrong console output");
+
+	ret = xrun_console_start(TEST_DOMID + 1, -1);
+	zassert_equal(ret, -EINVAL, "Console with invalid fd was started");
+
+	ret = xrun_console_stop(TEST_DOMID);
+	zassert_equal(ret, 0, "Error stopping console (%d)", ret);
+	zassert_equal(test_mapped_pages, 0, "Console ring is left mapped");
+	zassert_equal(test_bound_ports, 0, "Console evtchn is left bound");
+
+	ret = xrun_console_stop(TEST_DOMID);
+	zassert_equal(ret, -ENOENT, "Stopped console was stopped again");
+
+	test_teardown();
+}
+
+ZTEST(console_test, test_slow_reader)
+{
+	static char data[sizeof(test_ring.out) / 2];
+	char buf[16];
+	int i, ret;
+
+	test_setup(0);
+	for (i = 0; i < sizeof(data); i++) {
+		data[i] = 'a' + i % 26;
+	}
+
+	ret = xrun_console_start(TEST_DOMID, test_sock[0]);
+	zassert_equal(ret, 0, "Error starting console (%d)", ret);
+	zassert_true(fcntl(test_sock[0], F_GETFL, 0) & O_NONBLOCK,
+		     "Console fd is blocking");
+
+	/* Nobody reads the socket, but the domain shouldn't stall */
+	for (i = 0; i < 8; i++) {
+		test_produce(data, sizeof(data));
+		zassert_true(test_wait_consumed(),
+			     "Console output is stuck behind slow reader");
+	}
+
+	/* Stop flushes the ring without waiting for the reader */
+	test_produce(data, sizeof(data));
+	ret = xrun_console_stop(TEST_DOMID);
+	zassert_equal(ret, 0, "Error stopping console (%d)", ret);
+	zassert_equal(test_ring.out_cons, test_ring.out_prod,
+		      "Ring wasn't flushed on stop");
+
+	/* Output fitting into the socket is forwarded in order */
+	zassert_equal(test_read(buf, sizeof(buf)), sizeof(buf),
+		      "Console output wasn't forwarded");
+	zassert_mem_equal(buf, data, sizeof(buf), "Wrong console output");
+
+	test_teardown();
+}
+
+ZTEST(console_test, test_idle_event)
+{
+	char msg[] = "idle";
+	char buf[sizeof(msg)];
+	int ret, notifies;
+
+	test_setup(0);
+
+	ret = xrun_console_start(TEST_DOMID, test_sock[0]);
+	zassert_equal(ret, 0, "Error starting console (%d)", ret);
+	k_msleep(50);
+	notifies = test_notifies;
+
+	/* Event without output doesn't kick the domain back */
+	test_evtchn_cb(test_evtchn_priv);
+	k_msleep(50);
+	zassert_equal(test_notifies, notifies,
+		      "Domain was notified without consumed output");
+
+	test_produce(msg, sizeof(msg));
+	zassert_true(test_wait_consumed(), "Console output wasn't consumed");
+	zassert_equal(test_read(buf, sizeof(buf)), sizeof(buf),
+		      "Console output wasn't forwarded");
+	zassert_true(test_notifies > notifies, "Domain wasn't notified");
+
+	ret = xrun_console_stop(TEST_DOMID);
+	zassert_equal(ret, 0, "Error stopping console (%d)", ret);
+
+	test_teardown();
+}
+
+ZTEST(console_test, test_closed_reader)
+{
+	char msg[] = "nobody listens";
+	int i, ret;
+
+	test_setup(0);
+
+	ret = xrun_console_start(TEST_DOMID, test_sock[0]);
+	zassert_equal(ret, 0, "Error starting console (%d)", ret);
+
+	/* Writes fail with EPIPE, output is dropped and domain goes on */
+	close(test_sock[1]);
+	for (i = 0; i < 4; i++) {
+		test_produce(msg, sizeof(msg));
+		zassert_true(test_wait_consumed(),
+			     "Console output is stuck behind closed reader");
+	}
+
+	ret = xrun_console_stop(TEST_DOMID);
+	zassert_equal(ret, 0, "Error stopping console (%d)", ret);
+	zassert_equal(test_mapped_pages, 0, "Console ring is left mapped");
+
+	close(test_sock[0]);
+}
+
+ZTEST_SUITE(console_test, NULL, NULL, NULL, NULL, NULL);
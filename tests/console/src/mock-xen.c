@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <hypervisor.h>
+
+#include <zephyr/kernel.h>
+#include <zephyr/xen/events.h>
+#include <zephyr/xen/public/io/console.h>
+
+#define TEST_CONSOLE_GFN 0x1234
+#define TEST_REMOTE_PORT 7
+#define TEST_LOCAL_PORT 11
+
+extern struct xencons_interface test_ring;
+extern int test_mapped_pages;
+extern int test_bound_ports;
+extern int test_notifies;
+
+/* Event channel callback bound by the console */
+evtchn_cb_t test_evtchn_cb;
+void *test_evtchn_priv;
+
+int xrun_hyp_get_console(uint32_t domid, uint64_t *gfn, uint32_t *port)
+{
+	*gfn = TEST_CONSOLE_GFN;
+	*port = TEST_REMOTE_PORT;
+	return 0;
+}
+
+int xrun_hyp_map_guest_pages(uint32_t domid, uint64_t gfn, size_t nr_pages,
+			     void **addr)
+{
+	if (gfn != TEST_CONSOLE_GFN || nr_pages != 1) {
+		return -EINVAL;
+	}
+
+	test_mapped_pages++;
+	*addr = &test_ring;
+	return 0;
+}
+
+int xrun_hyp_unmap_guest_pages(void *addr, size_t nr_pages)
+{
+	test_mapped_pages -= nr_pages;
+	return 0;
+}
+
+int bind_interdomain_event_channel(domid_t remote_dom,
+				   evtchn_port_t remote_port,
+				   evtchn_cb_t cb, void *data)
+{
+	if (remote_port != TEST_REMOTE_PORT) {
+		return -EINVAL;
+	}
+
+	test_evtchn_cb = cb;
+	test_evtchn_priv = data;
+	test_bound_ports++;
+	return TEST_LOCAL_PORT;
+}
+
+int unbind_event_channel(evtchn_port_t port)
+{
+	test_bound_ports--;
+	return 0;
+}
+
+int evtchn_close(evtchn_port_t port)
+{
+	return 0;
+}
+
+void notify_evtchn(evtchn_port_t port)
+{
+	test_notifies++;
+}
@@ -0,0 +1,478 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <string.h>
+#include <zephyr/types.h>
+#include <zephyr/ztest.h>
+
+#include <storage.h>
+
+#include "mock.h"
+
+#define TEST_FLASH_AREA_OFF 0x1000
+#define TEST_FLASH_AREA_SIZE 0x4000
+
+static uint8_t test_buf[0x2000];
+
+static void test_fill_flash(void)
+{
+	int i;
+
+	for (i = 0; i < TEST_FLASH_AREA_SIZE; i++) {
+		test_flash[TEST_FLASH_AREA_OFF + i] = i * 7 + (i >> 8);
+	}
+}
+
+static const uint8_t *test_flash_at(size_t offset)
+{
+	return test_flash + TEST_FLASH_AREA_OFF + offset;
+}
+
+ZTEST(storage_test, test_flash_path)
+{
+	zassert_equal(xrun_get_file_size("flash:1"), TEST_FLASH_AREA_SIZE,
+		      "Region should span the whole area");
+	zassert_equal(xrun_get_file_size("flash:1:0x100"),
+		      TEST_FLASH_AREA_SIZE - 0x100,
+		      "Region should span till the end of the area");
+	zassert_equal(xrun_get_file_size("flash:1:0x100:0x200"), 0x200,
+		      "Wrong region size");
+
+	zassert_equal(xrun_get_file_size("flash:1:0x3f00:0x200"), -EINVAL,
+		      "Region out of the area was opened");
+	zassert_equal(xrun_get_file_size("flash:1:0x4000"), -EINVAL,
+		      "Empty region was opened");
+	zassert_equal(xrun_get_file_size("flash:x"), -EINVAL,
+		      "Invalid path was opened");
+	zassert_equal(xrun_get_file_size("flash:1:0x100:0x200:3"), -EINVAL,
+		      "Invalid path was opened");
+	zassert_equal(xrun_get_file_size("flash:2"), -ENOENT,
+		      "Unknown area was opened");
+}
+
+ZTEST(storage_test, test_flash_read)
+{
+	ssize_t rc;
+
+	test_fill_flash();
+	memset(test_buf, 0, sizeof(test_buf));
+	test_flash_dst = NULL;
+
+	/* Read is clamped to the region */
+	rc = xrun_read_file("flash:1:0x100:0x200", (char *)test_buf,
+			    sizeof(test_buf), 0x10);
+	zassert_equal(rc, 0x1f0, "Wrong read size %zd", rc);
+	zassert_mem_equal(test_buf, test_flash_at(0x110), rc,
+			  "Wrong data read from flash");
+
+	/* Flash driver may use DMA, so it shouldn't write to the caller */
+	zassert_not_null(test_flash_dst, "Flash driver wasn't called");
+	zassert_true((const uint8_t *)test_flash_dst < test_buf ||
+		     (const uint8_t *)test_flash_dst >=
+		     test_buf + sizeof(test_buf),
+		     "Flash driver read to the caller buffer");
+
+	rc = xrun_read_file("flash:1:0x100:0x200", (char *)test_buf,
+			    sizeof(test_buf), 0x200);
+	zassert_equal(rc, 0, "Read after the region end returned %zd", rc);
+}
+
+ZTEST(storage_test, test_flash_stream)
+{
+	struct xrun_stream_stats stats;
+	struct xrun_stream *stream;
+	ssize_t rc;
+
+	test_fill_flash();
+	memset(test_buf, 0, sizeof(test_buf));
+
+	rc = xrun_stream_open("flash:1:0x800", &stream);
+	zassert_equal(rc, 0, "Error opening flash stream (%zd)", rc);
+	zassert_equal(xrun_stream_size(stream), TEST_FLASH_AREA_SIZE - 0x800,
+		      "Wrong stream size");
+
+	test_flash_reads = 0;
+	rc = xrun_stream_read(stream, test_buf, sizeof(test_buf), 0x1000);
+	zassert_equal(rc, sizeof(test_buf), "Wrong read size %zd", rc);
+	zassert_mem_equal(test_buf, test_flash_at(0x1800), sizeof(test_buf),
+			  "Wrong data read from flash stream");
+	zassert_true(test_flash_reads > 1,
+		     "Large read wasn't split by the debounce buffer");
+
+	/* Read is clamped to the end of the area */
+	rc = xrun_stream_read(stream, test_buf, sizeof(test_buf), 0x3000);
+	zassert_equal(rc, TEST_FLASH_AREA_SIZE - 0x3800,
+		      "Wrong read size %zd at the end", rc);
+	zassert_mem_equal(test_buf, test_flash_at(0x3800), rc,
+			  "Wrong data read at the end of flash stream");
+
+	xrun_stream_get_stats(stream, &stats);
+	zassert_equal(stats.requests, 2, "Wrong number of requests");
+	zassert_equal(stats.bytes, sizeof(test_buf) + rc,
+		      "Wrong number of bytes");
+
+	zassert_equal(xrun_stream_close(stream), 0, "Error closing stream");
+}
+
+static uint8_t test_data[3][0x800];
+
+static void test_add_files(void)
+{
+	static const char *const paths[] = { "/lfs/a", "/lfs/b", "/lfs/c" };
+	int i, j;
+
+	for (i = 0; i < ARRAY_SIZE(paths); i++) {
+		for (j = 0; j < sizeof(test_data[i]); j++) {
+			test_data[i][j] = i + j * 3;
+		}
+
+		test_files[i].path = paths[i];
+		test_files[i].data = test_data[i];
+		test_files[i].size = sizeof(test_data[i]);
+		test_files[i].capacity = sizeof(test_data[i]);
+	}
+
+	xrun_storage_invalidate(NULL);
+}
+
+ZTEST(storage_test, test_file_cache)
+{
+	struct xrun_storage_cache_stats before, after;
+	int opens, stats;
+	ssize_t rc;
+
+	test_add_files();
+	xrun_storage_get_cache_stats(&before);
+	opens = test_fs_opens;
+	stats = test_fs_stats;
+
+	zassert_equal(xrun_get_file_size("/lfs/a"), sizeof(test_data[0]),
+		      "Wrong file size");
+	zassert_equal(xrun_get_file_size("/lfs/a"), sizeof(test_data[0]),
+		      "Wrong cached file size");
+	zassert_equal(test_fs_stats - stats, 1, "Size wasn't cached");
+
+	/* Sequential reads reuse the opened handle */
+	rc = xrun_read_file("/lfs/a", (char *)test_buf, 0x100, 0);
+	zassert_equal(rc, 0x100, "Wrong read size %zd", rc);
+	rc = xrun_read_file("/lfs/a", (char *)test_buf + 0x100, 0x100, 0x100);
+	zassert_equal(rc, 0x100, "Wrong read size %zd", rc);
+	rc = xrun_read_file("/lfs/a", (char *)test_buf + 0x200, 0x100, 0x10);
+	zassert_equal(rc, 0x100, "Wrong read size %zd", rc);
+	zassert_equal(test_fs_opens - opens, 1, "Handle wasn't cached");
+	zassert_mem_equal(test_buf, test_data[0], 0x200,
+			  "Wrong data read through cached handle");
+	zassert_mem_equal(test_buf + 0x200, test_data[0] + 0x10, 0x100,
+			  "Wrong data read after seek");
+
+	xrun_storage_get_cache_stats(&after);
+	zassert_equal(after.hits - before.hits, 3, "Wrong number of hits");
+	zassert_equal(after.misses - before.misses, 2,
+		      "Wrong number of misses");
+
+	/* Least recently used file is evicted */
+	zassert_equal(xrun_read_file("/lfs/b", (char *)test_buf, 0x10, 0), 0x10,
+		      "Error reading second file");
+	zassert_equal(xrun_read_file("/lfs/c", (char *)test_buf, 0x10, 0), 0x10,
+		      "Error reading third file");
+	xrun_storage_get_cache_stats(&after);
+	zassert_equal(after.evictions - before.evictions, 1,
+		      "File wasn't evicted");
+}
+
+ZTEST(storage_test, test_file_cache_invalidate)
+{
+	struct xrun_stream *stream;
+	int opens, stats;
+	ssize_t rc;
+
+	test_add_files();
+
+	zassert_equal(xrun_get_file_size("/lfs/a"), sizeof(test_data[0]),
+		      "Wrong file size");
+
+	/* File is changed behind the cache */
+	test_files[0].size = 0x400;
+
+	/* Streams use the size of the opened file, not the cached one */
+	rc = xrun_stream_open("/lfs/a", &stream);
+	zassert_equal(rc, 0, "Error opening stream (%zd)", rc);
+	zassert_equal(xrun_stream_size(stream), 0x400,
+		      "Stream uses stale file size");
+	rc = xrun_stream_read(stream, test_buf, sizeof(test_buf), 0);
+	zassert_equal(rc, 0x400, "Stream read past the end of file");
+	zassert_equal(xrun_stream_close(stream), 0, "Error closing stream");
+
+	/* Cached size is valid until the file is invalidated */
+	zassert_equal(xrun_get_file_size("/lfs/a"), sizeof(test_data[0]),
+		      "Cached size was dropped without invalidation");
+
+	opens = test_fs_opens;
+	stats = test_fs_stats;
+	xrun_storage_invalidate("/lfs/a");
+	zassert_equal(xrun_get_file_size("/lfs/a"), 0x400,
+		      "Stale size after invalidation");
+	zassert_equal(xrun_read_file("/lfs/a", (char *)test_buf, 0x10, 0), 0x10,
+		      "Error reading invalidated file");
+	zassert_equal(test_fs_stats - stats, 1, "File wasn't stat again");
+	zassert_equal(test_fs_opens - opens, 1, "File wasn't opened again");
+
+	/* Files rewritten by xrun are invalidated automatically */
+	rc = xrun_stream_create("/lfs/a", &stream);
+	zassert_equal(rc, 0, "Error creating stream (%zd)", rc);
+	rc = xrun_stream_write(stream, test_data[1], 0x100);
+	zassert_equal(rc, 0x100, "Error writing stream (%zd)", rc);
+	zassert_equal(xrun_stream_close(stream), 0, "Error closing stream");
+
+	zassert_equal(xrun_get_file_size("/lfs/a"), 0x100,
+		      "Stale size of the rewritten file");
+	rc = xrun_read_file("/lfs/a", (char *)test_buf, 0x100, 0);
+	zassert_equal(rc, 0x100, "Error reading rewritten file");
+	zassert_mem_equal(test_buf, test_data[1], 0x100,
+			  "Stale data of the rewritten file");
+}
+
+static uint32_t test_stream_reads(struct xrun_stream *stream)
+{
+	struct xrun_stream_stats stats;
+
+	xrun_stream_get_stats(stream, &stats);
+	return stats.reads;
+}
+
+ZTEST(storage_test, test_stream_read_ahead)
+{
+	struct xrun_stream *streams[3];
+	uint8_t buf[0x100];
+	size_t off;
+	ssize_t rc;
+	int i;
+
+	test_add_files();
+	for (i = 0; i < ARRAY_SIZE(streams); i++) {
+		rc = xrun_stream_open(test_files[i].path, &streams[i]);
+		zassert_equal(rc, 0, "Error opening stream %d (%zd)", i, rc);
+	}
+
+	/* Interleaved small reads keep the read-ahead of both streams */
+	for (off = 0; off < sizeof(test_data[0]); off += sizeof(buf)) {
+		for (i = 0; i < 2; i++) {
+			rc = xrun_stream_read(streams[i], buf, sizeof(buf),
+					      off);
+			zassert_equal(rc, sizeof(buf), "Error reading (%zd)",
+				      rc);
+			zassert_mem_equal(buf, test_data[i] + off, sizeof(buf),
+					  "Wrong data of stream %d at %zu", i,
+					  off);
+		}
+	}
+
+	zassert_equal(test_stream_reads(streams[0]), 1,
+		      "Read-ahead of the first stream was evicted");
+	zassert_equal(test_stream_reads(streams[1]), 1,
+		      "Read-ahead of the second stream was evicted");
+
+	/* Third stream takes over the least recently used buffer */
+	rc = xrun_stream_read(streams[2], buf, sizeof(buf), 0);
+	zassert_equal(rc, sizeof(buf), "Error reading (%zd)", rc);
+	zassert_mem_equal(buf, test_data[2], sizeof(buf), "Wrong data");
+
+	rc = xrun_stream_read(streams[1], buf, sizeof(buf), 0);
+	zassert_equal(rc, sizeof(buf), "Error reading (%zd)", rc);
+	zassert_equal(test_stream_reads(streams[1]), 1,
+		      "Recently used read-ahead was evicted");
+
+	rc = xrun_stream_read(streams[0], buf, sizeof(buf), 0);
+	zassert_equal(rc, sizeof(buf), "Error reading (%zd)", rc);
+	zassert_mem_equal(buf, test_data[0], sizeof(buf), "Wrong data");
+	zassert_equal(test_stream_reads(streams[0]), 2,
+		      "Evicted read-ahead wasn't refilled");
+
+	for (i = 0; i < ARRAY_SIZE(streams); i++) {
+		zassert_equal(xrun_stream_close(streams[i]), 0,
+			      "Error closing stream %d", i);
+	}
+}
+
+static uint8_t test_archive[XRUN_ARCHIVE_ALIGN + 0x100];
+
+ZTEST(storage_test, test_archive_digest)
+{
+	struct xrun_archive_header *hdr =
+		(struct xrun_archive_header *)test_archive;
+	struct xrun_archive *archive;
+	char buf[0x100];
+	ssize_t rc;
+
+	memset(test_archive, 0, sizeof(test_archive));
+	hdr->magic = XRUN_ARCHIVE_MAGIC;
+	hdr->version = XRUN_ARCHIVE_VERSION;
+	hdr->nr_entries = 1;
+	strcpy(hdr->entries[0].name, "config.json");
+	hdr->entries[0].offset = XRUN_ARCHIVE_ALIGN;
+	hdr->entries[0].size = sizeof(buf);
+	memset(test_archive + XRUN_ARCHIVE_ALIGN, 'x', sizeof(buf));
+
+	test_files[3].path = "/lfs/test.xrar";
+	test_files[3].data = test_archive;
+	test_files[3].size = sizeof(test_archive);
+	test_files[3].capacity = sizeof(test_archive);
+
+	rc = xrun_archive_open("/lfs/test.xrar", &archive);
+	zassert_equal(rc, 0, "Error opening archive (%zd)", rc);
+	rc = xrun_archive_read_file(archive, "config.json", buf, sizeof(buf),
+				    0);
+	zassert_equal(rc, sizeof(buf), "Error reading entry (%zd)", rc);
+	zassert_mem_equal(buf, test_archive + XRUN_ARCHIVE_ALIGN, sizeof(buf),
+			  "Wrong entry data");
+	zassert_equal(xrun_archive_close(archive), 0, "Error closing archive");
+
+	/* Digest can't be verified without CONFIG_XRUN_ARCHIVE_VERIFY */
+	hdr->entries[0].digest[0] = 1;
+	rc = xrun_archive_open("/lfs/test.xrar", &archive);
+	zassert_equal(rc, -ENOTSUP, "Archive with digest was opened (%zd)",
+		      rc);
+
+	test_files[3].path = NULL;
+}
+
+static K_SEM_DEFINE(test_io_gate, 0, 1);
+static struct xrun_io_req *test_io_order[4];
+static int test_io_done;
+
+static void test_io_block(struct xrun_io_req *req, ssize_t result)
+{
+	/* Keep the worker busy until the rest of requests are queued */
+	k_sem_take(&test_io_gate, K_FOREVER);
+}
+
+static void test_io_record(struct xrun_io_req *req, ssize_t result)
+{
+	test_io_order[test_io_done++] = req;
+}
+
+ZTEST(storage_test, test_io_scheduler)
+{
+	static uint8_t bufs[4][0x100];
+	struct xrun_io_req reqs[4] = {
+		{ .fpath = "/lfs/c", .skip = 0, .cb = test_io_block },
+		{ .fpath = "/lfs/b", .skip = 0x400, .cb = test_io_record },
+		{ .fpath = "/lfs/a", .skip = 0x100, .cb = test_io_record },
+		{ .fpath = "/lfs/b", .skip = 0, .cb = test_io_record },
+	};
+	struct xrun_storage_cache_stats before, after;
+	int i, file;
+	ssize_t rc;
+
+	test_add_files();
+	test_io_done = 0;
+
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		reqs[i].buf = bufs[i];
+		reqs[i].size = sizeof(bufs[i]);
+	}
+
+	zassert_equal(xrun_io_submit(&reqs[0], 1), 0, "Error submitting");
+	/* Let the worker pick the first request up */
+	k_msleep(10);
+	zassert_equal(xrun_io_submit(&reqs[1], 3), 0, "Error submitting");
+	k_sem_give(&test_io_gate);
+
+	for (i = 0; i < ARRAY_SIZE(reqs); i++) {
+		rc = xrun_io_wait(&reqs[i], K_SECONDS(1));
+		zassert_equal(rc, sizeof(bufs[i]), "Request %d failed (%zd)",
+			      i, rc);
+		file = reqs[i].fpath[5] - 'a';
+		zassert_mem_equal(bufs[i], test_data[file] + reqs[i].skip,
+				  sizeof(bufs[i]), "Wrong data of request %d",
+				  i);
+	}
+
+	/* Queued requests are served by file, then by offset */
+	zassert_equal(test_io_done, 3, "Wrong number of completions");
+	zassert_equal(test_io_order[0], &reqs[2], "/lfs/a wasn't first");
+	zassert_equal(test_io_order[1], &reqs[3], "/lfs/b:0 wasn't second");
+	zassert_equal(test_io_order[2], &reqs[1], "/lfs/b:0x400 wasn't last");
+
+	/* Scheduler reads share the handle cache with xrun_read_file */
+	xrun_storage_get_cache_stats(&before);
+	rc = xrun_read_file("/lfs/a", (char *)test_buf, 0x100, 0x200);
+	zassert_equal(rc, 0x100, "Error reading file (%zd)", rc);
+	xrun_storage_get_cache_stats(&after);
+	zassert_equal(after.hits - before.hits, 1,
+		      "Handle opened by the scheduler wasn't reused");
+}
+
+ZTEST(storage_test, test_io_budget_bytes)
+{
+	static uint8_t buf[0x1000];
+	struct xrun_io_req req = {
+		.fpath = "/lfs/a",
+		.buf = buf,
+		.size = sizeof(buf),
+	};
+	struct xrun_io_budget budget = { 0 };
+	struct xrun_io_budget_stats stats;
+	ssize_t rc;
+
+	test_add_files();
+	xrun_io_budget_init(&budget, 0, 0);
+	req.budget = &budget;
+
+	/* Buffer is bigger than the file, only the read bytes are charged */
+	zassert_equal(xrun_io_submit(&req, 1), 0, "Error submitting");
+	rc = xrun_io_wait(&req, K_SECONDS(1));
+	zassert_equal(rc, sizeof(test_data[0]), "Request failed (%zd)", rc);
+
+	xrun_io_budget_get_stats(&budget, &stats);
+	zassert_equal(stats.bytes, sizeof(test_data[0]),
+		      "Budget charged %llu bytes", stats.bytes);
+}
+
+ZTEST(storage_test, test_stream_budget_spread)
+{
+	struct xrun_io_budget budget = { 0 };
+	struct xrun_io_budget_stats stats;
+	struct xrun_stream *stream;
+	uint8_t buf[0x200];
+	int64_t start, first;
+	size_t off;
+	ssize_t rc;
+
+	test_add_files();
+	rc = xrun_stream_open("/lfs/a", &stream);
+	zassert_equal(rc, 0, "Error opening stream (%zd)", rc);
+
+	/* 16 KB/s with a single chunk of burst, 0x200 bytes take ~31 ms */
+	xrun_io_budget_init(&budget, KB(16), sizeof(buf));
+	xrun_stream_set_budget(stream, &budget);
+
+	start = k_uptime_get();
+	first = start;
+	for (off = 0; off < sizeof(test_data[0]); off += sizeof(buf)) {
+		rc = xrun_stream_read(stream, buf, sizeof(buf), off);
+		zassert_equal(rc, sizeof(buf), "Error reading (%zd)", rc);
+		if (!off) {
+			first = k_uptime_get();
+		}
+	}
+
+	/* Only the chunks past the burst wait, each for its own bytes */
+	zassert_true(first - start < 20, "First chunk waited %lld ms",
+		     first - start);
+	zassert_true(k_uptime_get() - start >= 80,
+		     "Reads weren't spread over time (%lld ms)",
+		     k_uptime_get() - start);
+
+	xrun_io_budget_get_stats(&budget, &stats);
+	zassert_equal(stats.bytes, sizeof(test_data[0]),
+		      "Budget charged %llu bytes", stats.bytes);
+	zassert_true(stats.throttled_us > 0, "Reads weren't throttled");
+
+	zassert_equal(xrun_stream_close(stream), 0, "Error closing stream");
+}
+
+ZTEST_SUITE(storage_test, NULL, NULL, NULL, NULL, NULL);
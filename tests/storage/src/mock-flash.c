@@ -0,0 +1,54 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/storage/flash_map.h>
+
+#include "mock.h"
+
+#define TEST_FLASH_AREA 1
+#define TEST_FLASH_AREA_OFF 0x1000
+#define TEST_FLASH_AREA_SIZE 0x4000
+
+uint8_t test_flash[TEST_FLASH_AREA_OFF + TEST_FLASH_AREA_SIZE];
+/* Destination of the last flash driver read */
+const void *test_flash_dst;
+int test_flash_reads;
+
+static const struct flash_area test_area = {
+	.fa_id = TEST_FLASH_AREA,
+	.fa_off = TEST_FLASH_AREA_OFF,
+	.fa_size = TEST_FLASH_AREA_SIZE,
+};
+
+int flash_area_open(uint8_t id, const struct flash_area **fa)
+{
+	if (id != TEST_FLASH_AREA) {
+		return -ENOENT;
+	}
+
+	*fa = &test_area;
+	return 0;
+}
+
+void flash_area_close(const struct flash_area *fa)
+{
+}
+
+int flash_area_read(const struct flash_area *fa, off_t off, void *dst,
+		    size_t len)
+{
+	if (off < 0 || off + len > fa->fa_size) {
+		return -EINVAL;
+	}
+
+	test_flash_dst = dst;
+	test_flash_reads++;
+	memcpy(dst, test_flash + fa->fa_off + off, len);
+	return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <string.h>
+
+#include <zephyr/fs/fs.h>
+#include <zephyr/kernel.h>
+
+#include "mock.h"
+
+/* In-memory files, handle keeps the position of the opened file */
+struct test_handle {
+	struct test_file *file;
+	off_t pos;
+};
+
+struct test_file test_files[TEST_FILES_MAX];
+int test_fs_opens;
+int test_fs_stats;
+int test_fs_reads;
+
+static struct test_file *find_file(const char *path)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(test_files); i++) {
+		if (test_files[i].path && !strcmp(test_files[i].path, path)) {
+			return &test_files[i];
+		}
+	}
+
+	return NULL;
+}
+
+int fs_open(struct fs_file_t *zfp, const char *file_name, fs_mode_t flags)
+{
+	struct test_file *file = find_file(file_name);
+	struct test_handle *handle;
+
+	if (!file) {
+		return -ENOENT;
+	}
+
+	handle = k_malloc(sizeof(*handle));
+	if (!handle) {
+		return -ENOMEM;
+	}
+
+	handle->file = file;
+	handle->pos = 0;
+	zfp->filep = handle;
+	test_fs_opens++;
+	return 0;
+}
+
+int fs_close(struct fs_file_t *zfp)
+{
+	k_free((void *)zfp->filep);
+	zfp->filep = NULL;
+	return 0;
+}
+
+ssize_t fs_read(struct fs_file_t *zfp, void *ptr, size_t size)
+{
+	struct test_handle *handle = (struct test_handle *)zfp->filep;
+	struct test_file *file = handle->file;
+
+	test_fs_reads++;
+	if (handle->pos >= file->size) {
+		return 0;
+	}
+
+	size = MIN(size, file->size - handle->pos);
+	memcpy(ptr, file->data + handle->pos, size);
+	handle->pos += size;
+	return size;
+}
+
+ssize_t fs_write(struct fs_file_t *zfp, const void *ptr, size_t size)
+{
+	struct test_handle *handle = (struct test_handle *)zfp->filep;
+	struct test_file *file = handle->file;
+
+	if (handle->pos + size > file->capacity) {
+		return -ENOSPC;
+	}
+
+	memcpy(file->data + handle->pos, ptr, size);
+	handle->pos += size;
+	file->size = MAX(file->size, handle->pos);
+	return size;
+}
+
+int fs_seek(struct fs_file_t *zfp, off_t offset, int whence)
+{
+	struct test_handle *handle = (struct test_handle *)zfp->filep;
+
+	switch (whence) {
+	case FS_SEEK_SET:
+		handle->pos = offset;
+		break;
+	case FS_SEEK_CUR:
+		handle->pos += offset;
+		break;
+	case FS_SEEK_END:
+		handle->pos = handle->file->size + offset;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+off_t fs_tell(struct fs_file_t *zfp)
+{
+	return ((struct test_handle *)zfp->filep)->pos;
+}
+
+int fs_truncate(struct fs_file_t *zfp, off_t length)
+{
+	struct test_handle *handle = (struct test_handle *)zfp->filep;
+
+	handle->file->size = length;
+	return 0;
+}
+
+int fs_stat(const char *path, struct fs_dirent *entry)
+{
+	struct test_file *file = find_file(path);
+
+	test_fs_stats++;
+	if (!file) {
+		return -ENOENT;
+	}
+
+	entry->type = FS_DIR_ENTRY_FILE;
+	entry->size = file->size;
+	return 0;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#ifndef XENLIB_TEST_STORAGE_MOCK_H
+#define XENLIB_TEST_STORAGE_MOCK_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TEST_FILES_MAX 4
+
+struct test_file {
+	const char *path;
+	uint8_t *data;
+	size_t size;
+	size_t capacity;
+};
+
+extern struct test_file test_files[TEST_FILES_MAX];
+extern int test_fs_opens;
+extern int test_fs_stats;
+extern int test_fs_reads;
+
+extern uint8_t test_flash[];
+extern const void *test_flash_dst;
+extern int test_flash_reads;
+
+#endif /* XENLIB_TEST_STORAGE_MOCK_H */
@@ -11,12 +11,56 @@
 #include <stdbool.h>
 #include <zephyr/ztest.h>
 #include <zephyr/data/json.h>
+#include <zephyr/sys/byteorder.h>
 
+#include <hypervisor.h>
+#include <storage.h>
 #include <xrun.h>
+#include <xrun_spec.h>
 char *test_json_contents;
 char *test_dtb_contents;
 char *test_image_name;
 char *test_dtb_name;
+int test_parser_calls;
+uint64_t test_checkpoint_mem_kb;
+int test_archive_reads;
+int test_config_reads;
+struct xrun_io_budget *test_stream_budget;
+struct xrun_io_budget *test_charged_budget;
+ssize_t test_image_size = -EINVAL;
+struct xrun_stream_stats test_stream_stats;
+uint8_t test_image[KB(4)];
+int test_stream_reads;
+int test_stream_charges;
+extern const int *test_load_chunks;
+extern size_t test_load_nr_chunks;
+extern uint8_t test_loaded_image[];
+int32_t test_create_delay_ms;
+uint64_t test_max_mem_kb;
+uint64_t test_mem_target_kb;
+/* Memory of the domain reported by the hypervisor */
+uint64_t test_cur_mem_kb;
+uint32_t test_vcpu_affinity[4];
+uint32_t test_sched_weight;
+uint32_t test_sched_cap;
+int test_sched_err;
+int test_sched_calls;
+int test_wait_destroyed;
+int test_wait_destroyed_err;
+extern int test_destroyed_domains;
+enum xrun_hyp_exit test_dom_exit;
+void (*test_dom_exc_cb)(void *priv);
+uint64_t test_free_mem_kb = 1024 * 1024;
+uint32_t test_nr_cpus = 4;
+int test_shutdown_requests;
+char *(*test_json_select)(const char *fpath);
+struct k_sem *test_create_hold;
+struct k_sem test_create_entered;
+struct k_sem *test_create_done;
+struct k_sem *test_exit_checked;
+struct k_sem *test_shutdown_requested;
+extern uint32_t test_create_order[];
+extern int test_create_count;
 struct xen_domain_cfg g_cfg;
 
 ZTEST(lib_xrun_test, test_json_spec_def)
@@ -664,4 +708,1582 @@ ZTEST(lib_xrun_test, test_json_no_dtdevs_iomems)
 	zassert_equal(ret, 0, "Error calling xrun_run");
 }
 
+ZTEST(lib_xrun_test, test_cmdline_backends)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : [ \"disk=['vdev=xvda']\", "
+		"\"vif =['bridge=xenbr0']\", \"diskless\" ]"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_parser_calls = 0;
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	zassert_equal(test_parser_calls, 2,
+		      "Backend records weren't classified correctly");
+	zassert_true(!strcmp(g_cfg.cmdline,
+			     "disk=['vdev=xvda'] vif =['bridge=xenbr0'] diskless"),
+		     "Cmdline wasn't generated correctly");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_checkpoint_restore)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"memKB\": 8192 "
+		"} "
+		"} "
+		"}";
+	char balloon_json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"memKB\": 8192, "
+		"\"maxMemKB\": 16384 "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+	enum container_status state;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_checkpoint_mem_kb = 0;
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	ret = xrun_checkpoint("test", "/lfs/test.ckpt");
+	zassert_equal(ret, 0, "Error calling xrun_checkpoint");
+	zassert_equal(test_checkpoint_mem_kb, 8192,
+		      "Checkpoint saved with wrong memory size");
+
+	ret = xrun_state("test", &state);
+	zassert_equal(ret, 0, "Error calling xrun_state");
+	zassert_equal(state, RUNNING, "Container wasn't resumed");
+
+	ret = xrun_restore("/test", "/lfs/test.ckpt", 0, "restored");
+	zassert_equal(ret, 0, "Error calling xrun_restore");
+
+	ret = xrun_kill("restored");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	/* Checkpoint doesn't match the domain memory size */
+	test_checkpoint_mem_kb = 4096;
+	ret = xrun_restore("/test", "/lfs/test.ckpt", 0, "restored");
+	zassert_not_equal(ret, 0, "Restore of mismatched checkpoint passed");
+	zassert_not_equal(xrun_state("restored", &state), 0,
+			  "Failed container wasn't unregistered");
+
+	/* Memory above memKB isn't saved, so balloon can't be restored */
+	test_checkpoint_mem_kb = 8192;
+	test_json_contents = balloon_json;
+	ret = xrun_restore("/test", "/lfs/test.ckpt", 0, "restored");
+	zassert_equal(ret, -ENOTSUP, "Restore of ballooned domain passed");
+	zassert_not_equal(xrun_state("restored", &state), 0,
+			  "Failed container wasn't unregistered");
+
+	ret = xrun_run("/test", 0, "balloon");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_checkpoint("balloon", "/lfs/test.ckpt");
+	zassert_equal(ret, -ENOTSUP, "Checkpoint of ballooned domain passed");
+	ret = xrun_kill("balloon");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_bundle_archive)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_archive_reads = 0;
+
+	ret = xrun_run("/lfs/test.xrar", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* config.json, device-tree and kernel are taken from the archive */
+	zassert_equal(test_archive_reads, 3,
+		      "Bundle files weren't read from archive");
+	zassert_true(!strcmp(g_cfg.dtb_start, test_dtb_contents),
+		     "Dtb file not decoded correctly");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_start_priority)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"}, "
+		"\"priority\": 10 "
+		"} "
+		"}";
+
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_checkpoint_mem_kb = 8192;
+
+	ret = xrun_run("/test", 0, "prio1");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Failed start must release the start gate */
+	ret = xrun_restore("/test", "/lfs/test.ckpt", 0, "prio2");
+	zassert_not_equal(ret, 0, "Restore of mismatched checkpoint passed");
+
+	ret = xrun_run("/test", 0, "prio2");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	ret = xrun_kill("prio1");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+	ret = xrun_kill("prio2");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+#define TEST_PRIO_JSON(prio) "{" \
+	"\"ociVersion\" : \"1.0.1\", " \
+	"\"vm\" : { " \
+	"\"hypervisor\": { " \
+	"\"path\": \"xen\", " \
+	"\"parameters\": [\"pvcalls=true\"] " \
+	"}, " \
+	"\"kernel\": { " \
+	"\"path\" : \"/lfs/unikernel.bin\", " \
+	"\"parameters\" : []" \
+	"}, " \
+	"\"hwConfig\": { " \
+	"\"deviceTree\": \"/lfs/uni.dtb\" " \
+	"}, " \
+	"\"priority\": " #prio " " \
+	"} " \
+	"}"
+
+static char prio_json_hold[] = TEST_PRIO_JSON(0);
+static char prio_json_low[] = TEST_PRIO_JSON(1);
+static char prio_json_high[] = TEST_PRIO_JSON(20);
+
+static char *prio_json_select(const char *fpath)
+{
+	if (strstr(fpath, "/high/")) {
+		return prio_json_high;
+	}
+
+	if (strstr(fpath, "/low/")) {
+		return prio_json_low;
+	}
+
+	return prio_json_hold;
+}
+
+static void xrun_prio_starter(void *p1, void *p2, void *p3)
+{
+	const char *container_id = p1;
+	char bundle[16];
+	int ret;
+
+	snprintf(bundle, sizeof(bundle), "/%s", container_id);
+	ret = xrun_run(bundle, 0, container_id);
+	zassert_equal(ret, 0, "Error calling xrun_run for %s", container_id);
+}
+
+ZTEST(lib_xrun_test, test_start_priority_order)
+{
+	static const char * const ids[] = { "hold", "low", "high" };
+	struct k_sem hold;
+	uint64_t domid[ARRAY_SIZE(ids)];
+	int i, ret;
+
+	test_json_select = prio_json_select;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	k_sem_init(&hold, 0, 1);
+	k_sem_init(&test_create_entered, 0, 1);
+	test_create_hold = &hold;
+	test_create_count = 0;
+
+	/*
+	 * Cooperative starters run until they block: the first one keeps
+	 * the start gate inside of domain_create(), others wait for the gate.
+	 */
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		tinfo[i].tid = k_thread_create(&tthread[i], tstack[i],
+					       STACK_SIZE, xrun_prio_starter,
+					       (void *)ids[i], NULL, NULL,
+					       K_PRIO_COOP(1), K_INHERIT_PERMS,
+					       K_NO_WAIT);
+		if (!i) {
+			ret = k_sem_take(&test_create_entered, K_SECONDS(1));
+			zassert_equal(ret, 0, "First start didn't take the gate");
+		}
+	}
+
+	zassert_equal(test_create_count, 1,
+		      "Domain was created while the gate is busy");
+	k_sem_give(&hold);
+
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		k_thread_join(tinfo[i].tid, K_FOREVER);
+		ret = xrun_get_domid(ids[i], &domid[i]);
+		zassert_equal(ret, 0, "Error calling xrun_get_domid");
+	}
+
+	zassert_equal(test_create_count, 3, "Not all domains were created");
+	zassert_equal(test_create_order[0], domid[0], "Wrong first domain");
+	zassert_equal(test_create_order[1], domid[2],
+		      "Higher priority start wasn't admitted first");
+	zassert_equal(test_create_order[2], domid[1],
+		      "Lower priority start wasn't admitted last");
+
+	test_json_select = NULL;
+	for (i = 0; i < ARRAY_SIZE(ids); i++) {
+		ret = xrun_kill(ids[i]);
+		zassert_equal(ret, 0, "Error calling xrun_kill");
+	}
+}
+
+ZTEST(lib_xrun_test, test_io_rate)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"}, "
+		"\"ioRateKBps\": 512 "
+		"} "
+		"}";
+
+	static const int chunks[] = { 0, 1, 2, 3 };
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_stream_budget = NULL;
+	test_charged_budget = NULL;
+	test_stream_charges = 0;
+	test_image_size = sizeof(test_image);
+	test_load_chunks = chunks;
+	test_load_nr_chunks = ARRAY_SIZE(chunks);
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Image is charged to the container budget chunk by chunk */
+	zassert_not_null(test_charged_budget, "Bundle reads weren't charged");
+	zassert_equal(test_stream_budget, test_charged_budget,
+		      "Image stream isn't paced by the container budget");
+	zassert_equal(test_stream_charges, ARRAY_SIZE(chunks),
+		      "Image wasn't charged per chunk");
+	zassert_equal(test_charged_budget->rate, 512 * 1024,
+		      "Wrong container rate");
+	zassert_equal(test_charged_budget->stats.bytes,
+		      strlen(json) + strlen(test_dtb_contents) +
+		      sizeof(test_image),
+		      "config.json, device-tree or image weren't charged");
+
+	test_load_chunks = NULL;
+	test_image_size = -EINVAL;
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_io_rate_archive)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"uni.dtb\" "
+		"}, "
+		"\"ioRateKBps\": 512 "
+		"} "
+		"}";
+
+	static const int chunks[] = { 0, 1, 2, 3 };
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_charged_budget = NULL;
+	test_image_size = sizeof(test_image);
+	test_load_chunks = chunks;
+	test_load_nr_chunks = ARRAY_SIZE(chunks);
+
+	ret = xrun_run("/lfs/test.xrar", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Device-tree from archive is not prefetched, but still charged */
+	zassert_not_null(test_charged_budget, "Bundle reads weren't charged");
+	zassert_equal(test_charged_budget->stats.bytes,
+		      strlen(json) + strlen(test_dtb_contents) +
+		      sizeof(test_image),
+		      "config.json, device-tree or image weren't charged");
+
+	test_load_chunks = NULL;
+	test_image_size = -EINVAL;
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_image_cache)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+	/* First chunk is reread and second one is skipped */
+	static const int gap_chunks[] = { 0, 0, 2, 3 };
+	static const int all_chunks[] = { 0, 1, 2, 3 };
+	int ret, i;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_image_size = sizeof(test_image);
+	for (i = 0; i < sizeof(test_image); i++) {
+		test_image[i] = i * 7 + 1;
+	}
+
+	test_load_chunks = gap_chunks;
+	test_load_nr_chunks = ARRAY_SIZE(gap_chunks);
+	ret = xrun_run("/test", 0, "cache");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Image with a gap is not cached, so it is read again */
+	test_load_chunks = all_chunks;
+	test_load_nr_chunks = ARRAY_SIZE(all_chunks);
+	test_stream_reads = 0;
+	ret = xrun_restart("cache");
+	zassert_equal(ret, 0, "Error calling xrun_restart");
+	zassert_equal(test_stream_reads, ARRAY_SIZE(all_chunks),
+		      "Partially loaded image was cached");
+
+	/* Completely loaded image is taken from the cache */
+	test_stream_reads = 0;
+	memset(test_loaded_image, 0, sizeof(test_image));
+	ret = xrun_restart("cache");
+	zassert_equal(ret, 0, "Error calling xrun_restart");
+	zassert_equal(test_stream_reads, 0, "Cached image was read again");
+	zassert_mem_equal(test_loaded_image, test_image, sizeof(test_image),
+			  "Wrong image loaded from the cache");
+
+	test_load_chunks = NULL;
+	test_image_size = -EINVAL;
+	ret = xrun_kill("cache");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_set_memory)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"memKB\": 8192, "
+		"\"minMemKB\": 4096, "
+		"\"maxMemKB\": 16384 "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+	uint64_t cur_kb, target_kb;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_max_mem_kb = 0;
+	test_mem_target_kb = 0;
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	zassert_equal(test_max_mem_kb, 16384, "Max memory wasn't set");
+
+	ret = xrun_set_memory("test", 4096);
+	zassert_equal(ret, 0, "Error calling xrun_set_memory");
+	zassert_equal(test_mem_target_kb, 4096,
+		      "Memory target wasn't passed to hypervisor");
+
+	/* Balloon driver hasn't reached the target yet */
+	test_cur_mem_kb = 8192;
+	ret = xrun_get_memory("test", &cur_kb, &target_kb);
+	zassert_equal(ret, 0, "Error calling xrun_get_memory");
+	zassert_equal(cur_kb, 8192, "Wrong current memory");
+	zassert_equal(target_kb, 4096, "Wrong memory target");
+
+	ret = xrun_set_memory("test", 2048);
+	zassert_equal(ret, -ERANGE, "Memory below minimum was set");
+	ret = xrun_set_memory("test", 32768);
+	zassert_equal(ret, -ERANGE, "Memory above maximum was set");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+ZTEST(lib_xrun_test, test_vcpu_affinity)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"vcpus\": 3, "
+		"\"cpuAffinity\": 240, "
+		"\"vcpuPinning\": [ 16, 32 ] "
+		"} "
+		"} "
+		"}";
+	char json_vcpus[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"vcpus\": 64 "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	memset(test_vcpu_affinity, 0, sizeof(test_vcpu_affinity));
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	zassert_equal(test_vcpu_affinity[0], 16, "vcpu0 wasn't pinned");
+	zassert_equal(test_vcpu_affinity[1], 32, "vcpu1 wasn't pinned");
+	zassert_equal(test_vcpu_affinity[2], 240, "cpuAffinity wasn't applied");
+
+	ret = xrun_set_affinity("test", -1, 15);
+	zassert_equal(ret, 0, "Error calling xrun_set_affinity");
+	zassert_equal(test_vcpu_affinity[0], 15, "vcpu0 wasn't repinned");
+	zassert_equal(test_vcpu_affinity[2], 15, "vcpu2 wasn't repinned");
+
+	ret = xrun_set_affinity("test", 3, 15);
+	zassert_not_equal(ret, 0, "Nonexistent vcpu was pinned");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	test_json_contents = json_vcpus;
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, -EINVAL, "vcpus over the limit weren't rejected");
+}
+
+ZTEST(lib_xrun_test, test_sched_params)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"schedWeight\": 512, "
+		"\"schedCap\": 50 "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+	ssize_t total;
+	struct xrun_container_info info;
+	enum container_status state;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	zassert_equal(test_sched_weight, 512, "Weight wasn't applied");
+	zassert_equal(test_sched_cap, 50, "Cap wasn't applied");
+
+	ret = xrun_set_sched("test", 0, 0);
+	zassert_equal(ret, -EINVAL, "Zero weight was accepted");
+	ret = xrun_set_sched("test", 1024, 200);
+	zassert_equal(ret, -EINVAL, "Cap above vcpus limit was accepted");
+
+	ret = xrun_set_sched("test", 1024, 80);
+	zassert_equal(ret, 0, "Error calling xrun_set_sched");
+
+	total = xrun_list(&info, 1);
+	zassert_equal(total, 1, "Unexpected containers count %d", total);
+	zassert_equal(info.sched_weight, 1024, "Wrong weight reported");
+	zassert_equal(info.sched_cap, 80, "Wrong cap reported");
+
+	/* Domain started without its scheduler parameters is destroyed */
+	test_sched_err = -EIO;
+	test_destroyed_domains = 0;
+	ret = xrun_restart("test");
+	zassert_equal(ret, -EIO, "Restart without scheduler params passed");
+	zassert_equal(test_destroyed_domains, 2,
+		      "Restarted domain wasn't destroyed");
+	ret = xrun_state("test", &state);
+	zassert_equal(ret, 0, "Error calling xrun_state");
+	zassert_equal(state, DESTROYED, "Container is left running");
+
+	/* Domain destroyed by the failed start is not destroyed again */
+	test_destroyed_domains = 0;
+	ret = xrun_run("/test", 0, "test2");
+	zassert_equal(ret, -EIO, "Start without scheduler params passed");
+	ret = xrun_state("test2", &state);
+	zassert_not_equal(ret, 0, "Failed container is registered");
+	zassert_equal(test_destroyed_domains, 1,
+		      "Domain of the failed start wasn't destroyed once");
+	test_sched_err = 0;
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+	zassert_equal(test_destroyed_domains, 1,
+		      "Domain of the failed restart was destroyed again");
+}
+
+ZTEST(lib_xrun_test, test_sched_unsupported)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+	char sched_json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"schedWeight\": 512 "
+		"} "
+		"} "
+		"}";
+	int ret;
+
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	/* Neither credit2 nor credit runs the domain, e.g. null scheduler */
+	test_sched_err = -ENOTSUP;
+	test_sched_calls = 0;
+
+	/* Default parameters are not applied, so start doesn't fail */
+	test_json_contents = json;
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Start with default parameters failed");
+	zassert_equal(test_sched_calls, 0, "Default parameters were applied");
+
+	ret = xrun_restart("test");
+	zassert_equal(ret, 0, "Restart with default parameters failed");
+	zassert_equal(test_sched_calls, 0, "Default parameters were applied");
+
+	ret = xrun_set_sched("test", 512, 0);
+	zassert_equal(ret, -ENOTSUP, "Unsupported parameters were set");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	/* Explicit parameters are required to be applied */
+	test_json_contents = sched_json;
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, -ENOTSUP, "Start with unsupported weight passed");
+	zassert_equal(test_sched_calls, 2, "Weight wasn't applied");
+
+	test_sched_err = 0;
+}
+
+ZTEST(lib_xrun_test, test_restart)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"unikernel.bin\", "
+		"\"parameters\" : [\"loglevel=7\"]"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	struct xrun_container_info info[1];
+	int ret, creates;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_archive_reads = 0;
+
+	ret = xrun_run("/lfs/test.xrar", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	zassert_equal(test_archive_reads, 3, "Bundle wasn't read from archive");
+
+	memset(&g_cfg, 0, sizeof(g_cfg));
+	test_wait_destroyed = 0;
+	ret = xrun_restart("test");
+	zassert_equal(ret, 0, "Error calling xrun_restart");
+	zassert_equal(test_wait_destroyed, 1,
+		      "Domain id was reused without waiting for the old domain");
+
+	/* Only kernel image is reopened, spec and dtb are reused */
+	zassert_equal(test_archive_reads, 4, "Bundle was parsed on restart");
+	zassert_true(!strcmp(g_cfg.cmdline, "loglevel=7"),
+		     "Command line wasn't preserved");
+	zassert_true(!strcmp(g_cfg.dtb_start, test_dtb_contents),
+		     "Dtb wasn't preserved");
+
+	ret = xrun_list(info, ARRAY_SIZE(info));
+	zassert_equal(ret, 1, "Wrong number of containers");
+	zassert_equal(info[0].restarts, 1, "Restart wasn't counted");
+	zassert_equal(info[0].status, RUNNING, "Container isn't running");
+
+	ret = xrun_restart("unknown");
+	zassert_not_equal(ret, 0, "Unknown container was restarted");
+
+	/* Domain is not created while the old one is still dying */
+	test_wait_destroyed_err = -ETIMEDOUT;
+	test_destroyed_domains = 0;
+	creates = test_create_count;
+	ret = xrun_restart("test");
+	test_wait_destroyed_err = 0;
+	zassert_equal(ret, -ETIMEDOUT, "Restart over dying domain passed");
+	zassert_equal(test_create_count, creates,
+		      "Domain was created over the dying one");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+	zassert_equal(test_destroyed_domains, 1,
+		      "Destroyed domain was destroyed again");
+}
+
+ZTEST(lib_xrun_test, test_supervisor)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"}, "
+		"\"restartPolicy\": { "
+		"\"name\": \"on-failure\", "
+		"\"maxRetries\": 2 "
+		"} "
+		"} "
+		"}";
+
+	struct xrun_container_info info;
+	struct k_sem created, checked;
+	int ret, i;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	zassert_not_null(test_dom_exc_cb, "VIRQ_DOM_EXC is not bound");
+
+	k_sem_init(&created, 0, K_SEM_MAX_LIMIT);
+	k_sem_init(&checked, 0, K_SEM_MAX_LIMIT);
+	test_create_done = &created;
+	test_exit_checked = &checked;
+
+	/*
+	 * Crash loop is stopped after maxRetries restarts. Scan and restart
+	 * share the supervisor queue, so the next scan sees the restarted
+	 * domain and the registry is locked until the last scan is over.
+	 */
+	test_dom_exit = XRUN_HYP_EXIT_CRASH;
+	for (i = 0; i < 3; i++) {
+		test_dom_exc_cb(NULL);
+		ret = k_sem_take(&checked, K_SECONDS(1));
+		zassert_equal(ret, 0, "Domain exit wasn't checked");
+		if (i < 2) {
+			ret = k_sem_take(&created, K_SECONDS(1));
+			zassert_equal(ret, 0, "Domain wasn't restarted");
+		}
+	}
+	test_dom_exit = XRUN_HYP_EXIT_NONE;
+	test_create_done = NULL;
+	test_exit_checked = NULL;
+
+	ret = xrun_list(&info, 1);
+	zassert_equal(ret, 1, "Unexpected containers count %d", ret);
+	zassert_equal(info.crashes, 3, "Wrong crash count %u", info.crashes);
+	zassert_equal(info.restarts, 2, "Wrong restart count %u",
+		      info.restarts);
+	zassert_equal(info.status, DESTROYED, "Crash loop wasn't stopped");
+	zassert_equal(k_sem_count_get(&created), 0, "Domain was restarted");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+static const uint8_t static_dtb[] = "static dtb";
+
+XRUN_CONTAINER_DEFINE_IMAGES(static_uni, NULL, 0, static_dtb,
+			     sizeof(static_dtb),
+	.ociVersion = "1.0.1",
+	.vm.hypervisor.path = "xen",
+	.vm.kernel.path = "/lfs/unikernel.bin",
+	.vm.kernel.parameters = { "port=8124" },
+	.vm.kernel.params_len = 1);
+
+ZTEST(lib_xrun_test, test_run_static)
+{
+	int ret;
+
+	test_image_name = "unikernel.bin";
+	test_config_reads = 0;
+
+	ret = xrun_run_static("static_uni", 0);
+	zassert_equal(ret, 0, "Error calling xrun_run_static");
+
+	zassert_true(!strcmp(g_cfg.dtb_start, "static dtb"),
+		     "Embedded dtb wasn't used");
+	zassert_true(!strcmp(g_cfg.cmdline, "port=8124"),
+		     "Command line wasn't generated from static spec");
+	zassert_equal(test_config_reads, 0, "Bundle config was read");
+
+	ret = xrun_run_static("static_uni", 0);
+	zassert_equal(ret, -EEXIST, "Static container was started twice");
+
+	ret = xrun_run_static("unknown", 0);
+	zassert_equal(ret, -ENOENT, "Unknown static container was started");
+
+	ret = xrun_kill("static_uni");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+}
+
+#define TEST_FDT_BEGIN_NODE 0x1
+#define TEST_FDT_END_NODE 0x2
+#define TEST_FDT_PROP 0x3
+#define TEST_FDT_NOP 0x4
+#define TEST_FDT_END 0x9
+
+/*
+ * Walks the struct block of the flat device-tree. Without prop returns
+ * the number of nodes with the given path, e.g. "/passthrough", root path
+ * is "". Otherwise returns 1 and the property value if the node has it.
+ */
+static int test_fdt_find(const uint8_t *fdt, const char *node,
+			 const char *prop, const uint8_t **val, uint32_t *len)
+{
+	const uint8_t *ptr = fdt + sys_get_be32(fdt + 8);
+	const char *strings = (const char *)fdt + sys_get_be32(fdt + 12);
+	const uint8_t *end = fdt + sys_get_be32(fdt + 4);
+	size_t parents[8], name_len;
+	char path[128] = "";
+	uint32_t plen;
+	int depth = 0, found = 0;
+
+	while (ptr + sizeof(uint32_t) <= end) {
+		switch (sys_get_be32(ptr)) {
+		case TEST_FDT_BEGIN_NODE:
+			ptr += sizeof(uint32_t);
+			name_len = strlen((const char *)ptr);
+			zassert_true(depth < ARRAY_SIZE(parents),
+				     "Device-tree is too deep");
+			parents[depth++] = strlen(path);
+			if (name_len) {
+				zassert_true(strlen(path) + name_len + 1 <
+					     sizeof(path), "Path is too long");
+				strcat(path, "/");
+				strcat(path, (const char *)ptr);
+			}
+			if (!prop && !strcmp(path, node)) {
+				found++;
+			}
+			ptr += ROUND_UP(name_len + 1, sizeof(uint32_t));
+			break;
+		case TEST_FDT_END_NODE:
+			ptr += sizeof(uint32_t);
+			zassert_true(depth > 0, "Unbalanced node end");
+			path[parents[--depth]] = '\0';
+			break;
+		case TEST_FDT_PROP:
+			plen = sys_get_be32(ptr + 4);
+			if (prop && !strcmp(path, node) &&
+			    !strcmp(strings + sys_get_be32(ptr + 8), prop)) {
+				*val = ptr + 12;
+				*len = plen;
+				return 1;
+			}
+			ptr += 12 + ROUND_UP(plen, sizeof(uint32_t));
+			break;
+		case TEST_FDT_NOP:
+			ptr += sizeof(uint32_t);
+			break;
+		case TEST_FDT_END:
+			zassert_equal(depth, 0, "Unterminated node");
+			return found;
+		default:
+			zassert_unreachable("Unknown token at %zu",
+					    (size_t)(ptr - fdt));
+		}
+	}
+
+	zassert_unreachable("No end token");
+	return 0;
+}
+
+static void test_fdt_string(const uint8_t *fdt, const char *node,
+			    const char *prop, const char *expected)
+{
+	const uint8_t *val;
+	uint32_t len;
+
+	zassert_equal(test_fdt_find(fdt, node, prop, &val, &len), 1,
+		      "%s has no %s", node, prop);
+	zassert_equal(len, strlen(expected) + 1, "Wrong length of %s %s",
+		      node, prop);
+	zassert_mem_equal(val, expected, len, "Wrong %s of %s", prop, node);
+}
+
+static void test_fdt_cells(const uint8_t *fdt, const char *node,
+			   const char *prop, const uint32_t *expected,
+			   size_t count)
+{
+	const uint8_t *val;
+	uint32_t len;
+	size_t i;
+
+	zassert_equal(test_fdt_find(fdt, node, prop, &val, &len), 1,
+		      "%s has no %s", node, prop);
+	zassert_equal(len, count * sizeof(uint32_t), "Wrong length of %s %s",
+		      node, prop);
+	for (i = 0; i < count; i++) {
+		zassert_equal(sys_get_be32(val + i * sizeof(uint32_t)),
+			      expected[i], "Wrong cell %zu of %s %s", i, node,
+			      prop);
+	}
+}
+
+ZTEST(lib_xrun_test, test_dt_generate)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"dtdevs\": [ \"/soc/serial@e6e88000\", \"/soc/i2c\" ], "
+		"\"iomems\": [ "
+		"{ \"firstGFN\": 59016, "
+		"\"firstMFN\": 59016, "
+		"\"nrMFNs\": 1 } "
+		"], "
+		"\"irqs\": [ 196 ], "
+		"\"dtNodes\": [ { "
+		"\"name\": \"serial@e6e88000\", "
+		"\"compatible\": \"renesas,scif\", "
+		"\"path\": \"/soc/serial@e6e88000\", "
+		"\"reg\": [ 0 ], "
+		"\"interrupts\": [ 196 ], "
+		"\"props\": [ \"status=okay\", \"dma-coherent\" ] "
+		"} ] "
+		"} "
+		"} "
+		"}";
+	/* Big-endian FDT magic */
+	const uint8_t magic[] = { 0xd0, 0x0d, 0xfe, 0xed };
+	/* Page 59016 mapped at its GFN, GIC SPI 164 level-high */
+	const uint32_t reg[] = { 0, 59016 * XRUN_PAGE_SIZE, 0, XRUN_PAGE_SIZE };
+	const uint32_t interrupts[] = { 0, 196 - 32, 4 };
+	const char *serial = "/passthrough/serial@e6e88000";
+	const uint8_t *fdt, *val;
+	uint32_t len;
+	int ret;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_image_name = "unikernel.bin";
+
+	ret = xrun_run("/test", 0, "test");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	zassert_not_null(g_cfg.dtb_start, "Device-tree wasn't generated");
+	zassert_mem_equal(g_cfg.dtb_start, magic, sizeof(magic),
+			  "Generated device-tree has no FDT header");
+	zassert_true(g_cfg.dtb_end > g_cfg.dtb_start + sizeof(magic),
+		     "Generated device-tree is empty");
+
+	fdt = (const uint8_t *)g_cfg.dtb_start;
+	zassert_equal(sys_get_be32(fdt + 4), g_cfg.dtb_end - g_cfg.dtb_start,
+		      "Wrong device-tree size");
+	zassert_equal(test_fdt_find(fdt, "", NULL, NULL, NULL), 1,
+		      "No root node");
+	zassert_equal(test_fdt_find(fdt, "/passthrough", NULL, NULL, NULL), 1,
+		      "No passthrough node");
+	test_fdt_string(fdt, "/passthrough", "compatible", "simple-bus");
+
+	/* Described device has one node built from the spec */
+	zassert_equal(test_fdt_find(fdt, serial, NULL, NULL, NULL), 1,
+		      "Wrong number of %s nodes", serial);
+	test_fdt_string(fdt, serial, "compatible", "renesas,scif");
+	test_fdt_cells(fdt, serial, "reg", reg, ARRAY_SIZE(reg));
+	test_fdt_cells(fdt, serial, "interrupts", interrupts,
+		       ARRAY_SIZE(interrupts));
+	test_fdt_string(fdt, serial, "xen,path", "/soc/serial@e6e88000");
+	test_fdt_string(fdt, serial, "status", "okay");
+	zassert_equal(test_fdt_find(fdt, serial, "dma-coherent", &val, &len),
+		      1, "No dma-coherent property");
+	zassert_equal(len, 0, "dma-coherent isn't empty");
+
+	/* Device without description gets a bare node */
+	zassert_equal(test_fdt_find(fdt, "/passthrough/i2c", NULL, NULL, NULL),
+		      1, "No i2c node");
+	test_fdt_string(fdt, "/passthrough/i2c", "xen,path", "/soc/i2c");
+	zassert_equal(test_fdt_find(fdt, "/passthrough/i2c", "compatible",
+				    &val, &len), 0, "Bare node has compatible");
+
+	ret = xrun_kill("test");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	/* Node reg should refer to the spec iomems */
+	strstr(json, "[ 0 ]")[2] = '1';
+	ret = xrun_run("/test", 0, "test");
+	zassert_not_equal(ret, 0, "Node with unknown reg was generated");
+}
+
+ZTEST(lib_xrun_test, test_admission)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\", "
+		"\"memKB\": 4096, "
+		"\"maxMemKB\": 8192, "
+		"\"vcpus\": 2 "
+		"}, "
+		"\"group\": \"apps\" "
+		"} "
+		"}";
+
+	int ret;
+	struct xrun_admission_info info;
+	struct xrun_container_info cinfo;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	ret = xrun_set_group_limit("apps", 12288, 4);
+	zassert_equal(ret, 0, "Error calling xrun_set_group_limit");
+
+	ret = xrun_run("/test", 0, "adm1");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	ret = xrun_get_admission("apps", &info);
+	zassert_equal(ret, 0, "Error calling xrun_get_admission");
+	zassert_equal(info.reserved_mem_kb, 8192, "Wrong reserved memory");
+	zassert_equal(info.reserved_vcpus, 2, "Wrong reserved vcpus");
+	zassert_equal(info.mem_limit_kb, 12288, "Wrong group memory limit");
+
+	zassert_equal(xrun_list(&cinfo, 1), 1, "Unexpected containers count");
+	zassert_equal(cinfo.reserved_mem_kb, 8192, "Wrong container reservation");
+
+	/* Second maxMemKB doesn't fit the group limit */
+	ret = xrun_run("/test", 0, "adm2");
+	zassert_equal(ret, -ENOSPC, "Group limit wasn't applied");
+
+	ret = xrun_set_group_limit("apps", 0, 0);
+	zassert_equal(ret, 0, "Error calling xrun_set_group_limit");
+
+	/* 4 vCPUs of 4 pCPUs with ratio 2 are left after adm2 */
+	ret = xrun_run("/test", 0, "adm2");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_run("/test", 0, "adm3");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_run("/test", 0, "adm4");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_run("/test", 0, "adm5");
+	zassert_equal(ret, -ENOMEM, "Host vCPUs limit wasn't applied");
+
+	ret = xrun_kill("adm4");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+	ret = xrun_kill("adm3");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	test_free_mem_kb = 4096;
+	ret = xrun_run("/test", 0, "adm3");
+	zassert_equal(ret, -ENOMEM, "Host memory limit wasn't applied");
+	test_free_mem_kb = 1024 * 1024;
+
+	ret = xrun_kill("adm2");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+	ret = xrun_kill("adm1");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	ret = xrun_get_admission(NULL, &info);
+	zassert_equal(ret, 0, "Error calling xrun_get_admission");
+	zassert_equal(info.reserved_mem_kb, 0, "Reservation wasn't released");
+	zassert_equal(info.reserved_vcpus, 0, "Reservation wasn't released");
+
+	/* Group without limits and containers is released */
+	ret = xrun_get_admission("apps", &info);
+	zassert_equal(ret, -ENOENT, "Unused group wasn't released");
+}
+
+ZTEST(lib_xrun_test, test_kill_all)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	int ret, i;
+	ssize_t total;
+	struct xrun_kill_result results[3];
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_shutdown_requests = 0;
+
+	ret = xrun_run("/test", 0, "kill1");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_run("/test", 0, "kill2");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_run("/test", 0, "kill3");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Domains power off on request */
+	test_dom_exit = XRUN_HYP_EXIT_POWEROFF;
+	total = xrun_kill_all(1000, results, 2);
+	test_dom_exit = XRUN_HYP_EXIT_NONE;
+	zassert_equal(total, 3, "Unexpected killed count %d", total);
+	zassert_equal(test_shutdown_requests, 3, "Shutdown wasn't requested");
+	for (i = 0; i < 2; i++) {
+		zassert_equal(results[i].result, 0, "Kill failed");
+		zassert_false(results[i].forced, "Domain was destroyed");
+	}
+	zassert_equal(xrun_list(NULL, 0), 0, "Containers were left");
+
+	ret = xrun_run("/test", 0, "kill1");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Domain ignores the request and is destroyed at the deadline */
+	total = xrun_kill_all(20, results, ARRAY_SIZE(results));
+	zassert_equal(total, 1, "Unexpected killed count %d", total);
+	zassert_equal(strcmp(results[0].container_id, "kill1"), 0,
+		      "Wrong container id");
+	zassert_true(results[0].forced, "Domain wasn't destroyed");
+	zassert_true(results[0].time_ms >= 20, "Deadline wasn't waited");
+}
+
+ZTEST(lib_xrun_test, test_stop)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	int ret;
+	enum container_status state;
+	struct xrun_stop_stats before, after;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+	test_shutdown_requests = 0;
+
+	ret = xrun_get_stop_stats(&before);
+	zassert_equal(ret, 0, "Error calling xrun_get_stop_stats");
+
+	ret = xrun_run("/test", 0, "stop");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Domain powers off on request */
+	test_dom_exit = XRUN_HYP_EXIT_POWEROFF;
+	ret = xrun_stop("stop", 1000);
+	test_dom_exit = XRUN_HYP_EXIT_NONE;
+	zassert_equal(ret, 0, "Error calling xrun_stop");
+	zassert_equal(test_shutdown_requests, 1, "Shutdown wasn't requested");
+	ret = xrun_state("stop", &state);
+	zassert_equal(ret, -EINVAL, "Stopped container wasn't removed");
+
+	ret = xrun_get_stop_stats(&after);
+	zassert_equal(ret, 0, "Error calling xrun_get_stop_stats");
+	zassert_equal(after.stops, before.stops + 1, "Stop wasn't counted");
+	zassert_equal(after.forced, before.forced, "Stop was forced");
+
+	ret = xrun_run("/test", 0, "stop");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	/* Domain ignores the request and is destroyed at the timeout */
+	ret = xrun_stop("stop", 20);
+	zassert_equal(ret, 0, "Error calling xrun_stop");
+
+	ret = xrun_get_stop_stats(&after);
+	zassert_equal(ret, 0, "Error calling xrun_get_stop_stats");
+	zassert_equal(after.stops, before.stops + 2, "Stop wasn't counted");
+	zassert_equal(after.forced, before.forced + 1, "Stop wasn't forced");
+	zassert_true(after.last_ms >= 20, "Timeout wasn't waited");
+
+	ret = xrun_stop("stop", 20);
+	zassert_equal(ret, -EINVAL, "Unknown container was stopped");
+}
+
+static void test_stop_worker(void *p1, void *p2, void *p3)
+{
+	*(int *)p1 = xrun_stop("stop", 10000);
+}
+
+ZTEST(lib_xrun_test, test_kill_stopping)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	struct k_sem requested;
+	enum container_status state;
+	int ret, stop_ret = -1, destroyed;
+	k_tid_t tid;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	ret = xrun_run("/test", 0, "stop");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	k_sem_init(&requested, 0, 1);
+	test_shutdown_requested = &requested;
+	tid = k_thread_create(&tthread[0], tstack[0], STACK_SIZE,
+			      test_stop_worker, &stop_ret, NULL, NULL,
+			      K_PRIO_PREEMPT(5), K_INHERIT_PERMS, K_NO_WAIT);
+
+	/* Stop waits for the domain, which ignores the request for now */
+	ret = k_sem_take(&requested, K_SECONDS(1));
+	test_shutdown_requested = NULL;
+	zassert_equal(ret, 0, "Shutdown wasn't requested");
+	ret = xrun_state("stop", &state);
+	zassert_equal(ret, 0, "Stopping container wasn't found");
+	zassert_equal(state, STOPPING, "Container isn't stopping");
+
+	/* Kill removes the container, stop still holds it */
+	destroyed = test_destroyed_domains;
+	ret = xrun_kill("stop");
+	zassert_equal(ret, 0, "Error killing stopping container");
+	ret = xrun_state("stop", &state);
+	zassert_equal(ret, -EINVAL, "Killed container wasn't removed");
+	ret = xrun_kill("stop");
+	zassert_equal(ret, -EINVAL, "Killed container was killed again");
+	zassert_equal(test_destroyed_domains, destroyed,
+		      "Domain was destroyed under the stop");
+
+	/* Domain is destroyed once, when the stop is over */
+	test_dom_exit = XRUN_HYP_EXIT_POWEROFF;
+	test_dom_exc_cb(NULL);
+	ret = k_thread_join(tid, K_SECONDS(1));
+	test_dom_exit = XRUN_HYP_EXIT_NONE;
+	zassert_equal(ret, 0, "Stop wasn't finished");
+	zassert_equal(stop_ret, 0, "Error stopping killed container (%d)",
+		      stop_ret);
+	zassert_equal(test_destroyed_domains, destroyed + 1,
+		      "Domain wasn't destroyed once");
+	zassert_equal(xrun_list(NULL, 0), 0, "Containers were left");
+}
+
+static void test_start_worker(void *p1, void *p2, void *p3)
+{
+	*(int *)p1 = xrun_run("/test", 0, "starting");
+}
+
+ZTEST(lib_xrun_test, test_kill_starting)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	enum container_status state;
+	int ret, run_ret = -1, destroyed;
+	struct k_sem hold;
+	k_tid_t tid;
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	/* Start is held inside of domain_create() */
+	k_sem_init(&hold, 0, 1);
+	k_sem_init(&test_create_entered, 0, 1);
+	test_create_hold = &hold;
+	tid = k_thread_create(&tthread[0], tstack[0], STACK_SIZE,
+			      test_start_worker, &run_ret, NULL, NULL,
+			      K_PRIO_PREEMPT(5), K_INHERIT_PERMS, K_NO_WAIT);
+	ret = k_sem_take(&test_create_entered, K_SECONDS(1));
+	zassert_equal(ret, 0, "Domain creation wasn't started");
+
+	/* Starting container is used by the start and can't be removed */
+	destroyed = test_destroyed_domains;
+	ret = xrun_kill("starting");
+	zassert_equal(ret, -EBUSY, "Starting container was killed");
+	ret = xrun_stop("starting", 0);
+	zassert_equal(ret, -EBUSY, "Starting container was stopped");
+	ret = xrun_kill_all(0, NULL, 0);
+	zassert_equal(ret, 0, "Starting container was killed by kill all");
+	ret = xrun_state("starting", &state);
+	zassert_equal(ret, 0, "Starting container was removed");
+	zassert_equal(test_destroyed_domains, destroyed,
+		      "Domain was destroyed under the start");
+
+	k_sem_give(&hold);
+	ret = k_thread_join(tid, K_SECONDS(1));
+	zassert_equal(ret, 0, "Start wasn't finished");
+	zassert_equal(run_ret, 0, "Error starting container (%d)", run_ret);
+	ret = xrun_state("starting", &state);
+	zassert_equal(ret, 0, "Started container wasn't found");
+	zassert_equal(state, RUNNING, "Container isn't running");
+
+	/* Started container is killed as usual */
+	ret = xrun_kill("starting");
+	zassert_equal(ret, 0, "Error killing started container");
+	zassert_equal(test_destroyed_domains, destroyed + 1,
+		      "Domain wasn't destroyed once");
+	zassert_equal(xrun_list(NULL, 0), 0, "Containers were left");
+}
+
+ZTEST(lib_xrun_test, test_list)
+{
+	char json[] = "{"
+		"\"ociVersion\" : \"1.0.1\", "
+		"\"vm\" : { "
+		"\"hypervisor\": { "
+		"\"path\": \"xen\", "
+		"\"parameters\": [\"pvcalls=true\"] "
+		"}, "
+		"\"kernel\": { "
+		"\"path\" : \"/lfs/unikernel.bin\", "
+		"\"parameters\" : []"
+		"}, "
+		"\"hwConfig\": { "
+		"\"deviceTree\": \"/lfs/uni.dtb\" "
+		"} "
+		"} "
+		"}";
+
+	int ret, i;
+	ssize_t total;
+	struct xrun_container_info info[3];
+
+	test_json_contents = json;
+	test_dtb_contents = "dtb";
+	test_dtb_name = "uni.dtb";
+	test_image_name = "unikernel.bin";
+
+	/* 1 MB image loaded in 500 ms */
+	test_stream_stats.bytes = MB(1);
+	test_stream_stats.active_us = 500 * USEC_PER_MSEC;
+	test_create_delay_ms = 20;
+
+	total = xrun_list(NULL, 0);
+	zassert_equal(total, 0, "Unexpected containers count %d", total);
+
+	ret = xrun_run("/test", 0, "list1");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+	ret = xrun_run("/test", 0, "list2");
+	zassert_equal(ret, 0, "Error calling xrun_run");
+
+	ret = xrun_pause("list2");
+	zassert_equal(ret, 0, "Error calling xrun_pause");
+
+	total = xrun_list(info, 1);
+	zassert_equal(total, 2, "Unexpected containers count %d", total);
+
+	total = xrun_list(info, ARRAY_SIZE(info));
+	zassert_equal(total, 2, "Unexpected containers count %d", total);
+
+	for (i = 0; i < total; i++) {
+		if (!strcmp(info[i].container_id, "list1")) {
+			zassert_equal(info[i].status, RUNNING,
+				      "Wrong state for list1");
+		} else if (!strcmp(info[i].container_id, "list2")) {
+			zassert_equal(info[i].status, PAUSED,
+				      "Wrong state for list2");
+		} else {
+			zassert_unreachable("Unexpected container %s",
+					    info[i].container_id);
+		}
+		zassert_true(info[i].uptime_ms >= 0, "Wrong uptime");
+		zassert_equal(info[i].mem_kb, 4096, "Wrong memory size");
+		zassert_equal(info[i].vcpus, 1, "Wrong vcpus count");
+		zassert_equal(info[i].image_size, MB(1), "Wrong image size");
+		zassert_true(info[i].load_time_ms >= test_create_delay_ms,
+			     "Wrong load time %u", info[i].load_time_ms);
+		zassert_equal(info[i].load_rate, 2048, "Wrong load rate %u",
+			      info[i].load_rate);
+	}
+
+	memset(&test_stream_stats, 0, sizeof(test_stream_stats));
+	test_create_delay_ms = 0;
+
+	ret = xrun_kill("list1");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+	ret = xrun_kill("list2");
+	zassert_equal(ret, 0, "Error calling xrun_kill");
+
+	total = xrun_list(info, ARRAY_SIZE(info));
+	zassert_equal(total, 0, "Unexpected containers count %d", total);
+}
+
 ZTEST_SUITE(lib_xrun_test, NULL, NULL, NULL, NULL, NULL);
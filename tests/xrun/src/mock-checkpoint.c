@@ -0,0 +1,23 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <checkpoint.h>
+
+extern uint64_t test_checkpoint_mem_kb;
+
+int xrun_checkpoint_save(uint32_t domid, uint64_t mem_kb, uint32_t nr_vcpus,
+			 const char *fpath)
+{
+	test_checkpoint_mem_kb = mem_kb;
+	return 0;
+}
+
+int xrun_checkpoint_load(uint32_t domid, uint64_t mem_kb, uint32_t nr_vcpus,
+			 const char *fpath)
+{
+	return (mem_kb == test_checkpoint_mem_kb) ? 0 : -EINVAL;
+}
@@ -0,0 +1,101 @@
+/*
+ * Copyright (C) 2024 EPAM Systems, Inc.
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <errno.h>
+#include <hypervisor.h>
+#include <zephyr/kernel.h>
+
+extern uint64_t test_max_mem_kb;
+extern uint64_t test_mem_target_kb;
+extern uint64_t test_cur_mem_kb;
+extern uint32_t test_vcpu_affinity[];
+extern uint32_t test_sched_weight;
+extern uint32_t test_sched_cap;
+extern int test_sched_err;
+extern int test_sched_calls;
+extern int test_wait_destroyed;
+extern int test_wait_destroyed_err;
+extern enum xrun_hyp_exit test_dom_exit;
+extern void (*test_dom_exc_cb)(void *priv);
+extern uint64_t test_free_mem_kb;
+extern uint32_t test_nr_cpus;
+extern int test_shutdown_requests;
+extern struct k_sem *test_exit_checked;
+extern struct k_sem *test_shutdown_requested;
+
+int xrun_hyp_set_max_mem(uint32_t domid, uint64_t max_kb)
+{
+	test_max_mem_kb = max_kb;
+	return 0;
+}
+
+int xrun_hyp_set_mem_target(uint32_t domid, uint64_t target_kb)
+{
+	test_mem_target_kb = target_kb;
+	return 0;
+}
+
+int xrun_hyp_get_mem(uint32_t domid, uint64_t *mem_kb)
+{
+	*mem_kb = test_cur_mem_kb;
+	return 0;
+}
+
+int xrun_hyp_set_vcpu_affinity(uint32_t domid, uint32_t vcpu,
+			       uint32_t cpumask)
+{
+	test_vcpu_affinity[vcpu] = cpumask;
+	return 0;
+}
+
+int xrun_hyp_set_sched(uint32_t domid, uint32_t weight, uint32_t cap)
+{
+	test_sched_calls++;
+	if (test_sched_err) {
+		return test_sched_err;
+	}
+
+	test_sched_weight = weight;
+	test_sched_cap = cap;
+	return 0;
+}
+
+int xrun_hyp_wait_destroyed(uint32_t domid, uint32_t timeout_ms)
+{
+	test_wait_destroyed++;
+	return test_wait_destroyed_err;
+}
+
+int xrun_hyp_get_exit(uint32_t domid, enum xrun_hyp_exit *exit)
+{
+	*exit = test_dom_exit;
+	if (test_exit_checked) {
+		k_sem_give(test_exit_checked);
+	}
+	return 0;
+}
+
+int xrun_hyp_bind_dom_exc(void (*cb)(void *priv), void *priv)
+{
+	test_dom_exc_cb = cb;
+	return 0;
+}
+
+int xrun_hyp_get_physinfo(uint64_t *free_kb, uint32_t *nr_cpus)
+{
+	*free_kb = test_free_mem_kb;
+	*nr_cpus = test_nr_cpus;
+	return 0;
+}
+
+int xrun_hyp_request_shutdown(uint32_t domid)
+{
+	test_shutdown_requests++;
+	if (test_shutdown_requested) {
+		k_sem_give(test_shutdown_requested);
+	}
+	return 0;
+}
@@ -6,7 +6,10 @@
 
 #include <xl_parser.h>
 
+extern int test_parser_calls;
+
 int parse_one_record_and_fill_cfg(const char *str, struct backend_configuration *cfg)
 {
+	test_parser_calls++;
 	return 0;
 }
@@ -9,16 +9,27 @@
 #include <storage.h>
 #include <string.h>
 
+#include <zephyr/kernel.h>
+
 extern char *test_json_contents;
 extern char *test_dtb_contents;
+extern char *(*test_json_select)(const char *fpath);
+extern int test_config_reads;
+
+static char *test_json(const char *fpath)
+{
+	return test_json_select ? test_json_select(fpath) : test_json_contents;
+}
 
 ssize_t xrun_read_file(const char *fpath, char *buf,
 		       size_t size, int skip)
 {
 	if (strstr(fpath, "config.json")) {
-		memcpy(buf, test_json_contents, strlen(test_json_contents));
-		return strlen(test_json_contents) > size ?
-			size : strlen(test_json_contents);
+		char *json = test_json(fpath);
+
+		test_config_reads++;
+		memcpy(buf, json, strlen(json));
+		return strlen(json) > size ? size : strlen(json);
 	}
 
 	if (strstr(fpath, ".dtb")) {
@@ -34,7 +45,8 @@ ssize_t xrun_get_file_size(const char *fpath)
 {
 
 	if (strstr(fpath, "config.json")) {
-		return strlen(test_json_contents);
+		test_config_reads++;
+		return strlen(test_json(fpath));
 	}
 
 	if (strstr(fpath, ".dtb")) {
@@ -43,3 +55,169 @@ ssize_t xrun_get_file_size(const char *fpath)
 
 	return -EINVAL;
 }
+
+struct xrun_stream {
+	const char *fpath;
+	struct xrun_io_budget *budget;
+};
+
+int xrun_stream_open(const char *fpath, struct xrun_stream **stream)
+{
+	*stream = k_malloc(sizeof(**stream));
+	if (!*stream) {
+		return -ENOMEM;
+	}
+
+	(*stream)->fpath = fpath;
+	(*stream)->budget = NULL;
+	return 0;
+}
+
+extern uint8_t test_image[];
+extern ssize_t test_image_size;
+extern int test_stream_reads;
+extern int test_stream_charges;
+
+ssize_t xrun_stream_read(struct xrun_stream *stream, uint8_t *buf,
+			 size_t size, uint64_t offset)
+{
+	if (test_image_size <= 0 || offset >= test_image_size) {
+		return -EINVAL;
+	}
+
+	size = MIN(size, test_image_size - offset);
+	/* Every read is charged, as by the storage layer */
+	if (stream->budget) {
+		xrun_io_budget_charge(stream->budget, size);
+		test_stream_charges++;
+	}
+	memcpy(buf, test_image + offset, size);
+	test_stream_reads++;
+	return size;
+}
+
+ssize_t xrun_stream_size(struct xrun_stream *stream)
+{
+	return test_image_size;
+}
+
+extern struct xrun_stream_stats test_stream_stats;
+
+void xrun_stream_get_stats(struct xrun_stream *stream,
+			   struct xrun_stream_stats *stats)
+{
+	*stats = test_stream_stats;
+}
+
+void xrun_io_budget_init(struct xrun_io_budget *budget, uint32_t rate,
+			 uint32_t burst)
+{
+	memset(budget, 0, sizeof(*budget));
+	budget->rate = rate;
+	budget->burst = burst;
+}
+
+extern struct xrun_io_budget *test_charged_budget;
+
+void xrun_io_budget_charge(struct xrun_io_budget *budget, size_t size)
+{
+	if (budget) {
+		budget->stats.bytes += size;
+		test_charged_budget = budget;
+	}
+}
+
+void xrun_io_budget_get_stats(struct xrun_io_budget *budget,
+			      struct xrun_io_budget_stats *stats)
+{
+	*stats = budget->stats;
+}
+
+extern struct xrun_io_budget *test_stream_budget;
+
+void xrun_stream_set_budget(struct xrun_stream *stream,
+			    struct xrun_io_budget *budget)
+{
+	stream->budget = budget;
+	test_stream_budget = budget;
+}
+
+int xrun_stream_close(struct xrun_stream *stream)
+{
+	k_free(stream);
+	return 0;
+}
+
+struct xrun_archive {
+	int dummy;
+};
+
+extern int test_archive_reads;
+
+int xrun_archive_open(const char *fpath, struct xrun_archive **archive)
+{
+	*archive = k_malloc(sizeof(**archive));
+	if (!*archive) {
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+ssize_t xrun_archive_read_file(struct xrun_archive *archive, const char *name,
+			       char *buf, size_t size, int skip)
+{
+	test_archive_reads++;
+	return xrun_read_file(name, buf, size, skip);
+}
+
+ssize_t xrun_archive_get_file_size(struct xrun_archive *archive,
+				   const char *name)
+{
+	return xrun_get_file_size(name);
+}
+
+int xrun_archive_stream_open(struct xrun_archive *archive, const char *name,
+			     struct xrun_stream **stream)
+{
+	test_archive_reads++;
+	return xrun_stream_open(name, stream);
+}
+
+int xrun_archive_close(struct xrun_archive *archive)
+{
+	k_free(archive);
+	return 0;
+}
+
+int xrun_io_submit(struct xrun_io_req *reqs, size_t count)
+{
+	size_t i;
+
+	for (i = 0; i < count; i++) {
+		k_sem_init(&reqs[i].done, 0, 1);
+		reqs[i].result = xrun_read_file(reqs[i].fpath, reqs[i].buf,
+						reqs[i].size, reqs[i].skip);
+		if (reqs[i].result > 0) {
+			xrun_io_budget_charge(reqs[i].budget, reqs[i].result);
+		}
+		if (reqs[i].cb) {
+			reqs[i].cb(&reqs[i], reqs[i].result);
+		}
+		k_sem_give(&reqs[i].done);
+	}
+
+	return 0;
+}
+
+ssize_t xrun_io_wait(struct xrun_io_req *req, k_timeout_t timeout)
+{
+	int rc = k_sem_take(&req->done, timeout);
+
+	if (rc) {
+		return rc;
+	}
+
+	k_sem_give(&req->done);
+	return req->result;
+}
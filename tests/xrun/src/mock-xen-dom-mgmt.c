@@ -5,6 +5,7 @@
  */
 
 #include <domain.h>
+#include <errno.h>
 #include <string.h>
 
 #include <zephyr/tc_util.h>
@@ -12,15 +13,90 @@
 
 #include <xen_dom_mgmt.h>
 extern struct xen_domain_cfg g_cfg;
+extern struct k_sem *test_create_hold;
+extern struct k_sem test_create_entered;
+extern int32_t test_create_delay_ms;
+extern struct k_sem *test_create_done;
+
+/* Domains in the order of creation, wraps around */
+uint32_t test_create_order[4];
+int test_create_count;
+
+#define TEST_LOAD_CHUNK 1024
+
+/* Image chunks loaded by domain_create, image isn't loaded if NULL */
+const int *test_load_chunks;
+size_t test_load_nr_chunks;
+uint8_t test_loaded_image[4 * TEST_LOAD_CHUNK];
+
+/* Loads image chunks in the given order, as xenlib does */
+static int test_load_image(struct xen_domain_cfg *domcfg)
+{
+	uint64_t size, offset;
+	size_t i;
+	int rc;
+
+	rc = domcfg->get_image_size(domcfg->image_info, &size);
+	if (rc) {
+		return rc;
+	}
+
+	if (size > sizeof(test_loaded_image)) {
+		return -E2BIG;
+	}
+
+	for (i = 0; i < test_load_nr_chunks; i++) {
+		offset = test_load_chunks[i] * TEST_LOAD_CHUNK;
+		rc = domcfg->load_image_bytes(test_loaded_image + offset,
+					      MIN(TEST_LOAD_CHUNK, size - offset),
+					      offset, domcfg->image_info);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return 0;
+}
 
 int domain_create(struct xen_domain_cfg *domcfg, uint32_t domid)
 {
+	struct k_sem *hold = test_create_hold;
+
 	memcpy(&g_cfg, domcfg, sizeof(*domcfg));
+	if (test_create_delay_ms) {
+		k_msleep(test_create_delay_ms);
+	}
+
+	test_create_order[test_create_count++ % ARRAY_SIZE(test_create_order)] =
+		domid;
+
+	if (test_load_chunks) {
+		int rc = test_load_image(domcfg);
+
+		if (rc) {
+			return rc;
+		}
+	}
+
+	/* Keep the start gate busy until the test releases the domain */
+	if (hold) {
+		test_create_hold = NULL;
+		k_sem_give(&test_create_entered);
+		k_sem_take(hold, K_FOREVER);
+	}
+
+	if (test_create_done) {
+		k_sem_give(test_create_done);
+	}
+
 	return 0;
 }
 
+int test_destroyed_domains;
+
 int domain_destroy(uint32_t domid)
 {
+	test_destroyed_domains++;
 	return 0;
 }
 